@@ -0,0 +1,293 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <string.h>
+
+/**
+ * The buffer size for the results, which has to hold the longest paths of the
+ * corpora.
+ */
+#define CWK_BENCH_BUFFER_SIZE 16384
+
+static thread_local char buffer[CWK_BENCH_BUFFER_SIZE];
+
+/**
+ * Calls a function for every path of every corpus. The second path is the next
+ * one of the same corpus, for the functions which need two of them. Only the
+ * first path counts towards the processed bytes, and the latencies are grouped
+ * by corpus.
+ */
+template <typename T_FN> static void each_path(struct cwk_bench_run *run,
+  T_FN fn)
+{
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (const cwk_bench_corpus &corpus : cwk_bench_corpora()) {
+      const cwk cwk_path(corpus.style);
+      for (j = 0; j < corpus.paths.size(); ++j) {
+        cwk_bench_call(run, corpus.name, [&]() {
+          fn(cwk_path, corpus.paths[j].c_str(),
+            corpus.paths[(j + 1) % corpus.paths.size()].c_str());
+        });
+        run->bytes += corpus.paths[j].size();
+        ++run->operations;
+      }
+    }
+  }
+}
+
+void api_get_absolute(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.get_absolute(a, b, buffer, sizeof(buffer));
+  });
+}
+
+void api_get_relative(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.get_relative(a, b, buffer, sizeof(buffer));
+  });
+}
+
+void api_join(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.join(a, b, buffer, sizeof(buffer));
+  });
+}
+
+void api_join_multiple(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    const char *paths[] = {a, b, a, NULL};
+    run->checksum += cwk_path.join_multiple(paths, buffer, sizeof(buffer));
+  });
+}
+
+void api_get_root(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    size_t length;
+    cwk_path.get_root(a, &length);
+    run->checksum += length;
+  });
+}
+
+void api_change_root(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.change_root(a, "/mnt/", buffer, sizeof(buffer));
+  });
+}
+
+void api_is_absolute(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.is_absolute(a);
+  });
+}
+
+void api_is_relative(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.is_relative(a);
+  });
+}
+
+void api_get_basename(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    const char *basename;
+    size_t length;
+    cwk_path.get_basename(a, &basename, &length);
+    run->checksum += length;
+  });
+}
+
+void api_change_basename(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.change_basename(a, "file.txt", buffer,
+      sizeof(buffer));
+  });
+}
+
+void api_get_dirname(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    size_t length;
+    cwk_path.get_dirname(a, &length);
+    run->checksum += length;
+  });
+}
+
+void api_get_extension(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    const char *extension;
+    size_t length;
+    if (cwk_path.get_extension(a, &extension, &length)) {
+      run->checksum += length;
+    }
+  });
+}
+
+void api_has_extension(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.has_extension(a);
+  });
+}
+
+void api_change_extension(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.change_extension(a, "o", buffer, sizeof(buffer));
+  });
+}
+
+void api_normalize(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.normalize(a, buffer, sizeof(buffer));
+  });
+}
+
+void api_get_intersection(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.get_intersection(a, b);
+  });
+}
+
+void api_next_segment(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    struct cwk_segment segment;
+    if (cwk_path.get_first_segment(a, &segment)) {
+      do {
+        run->checksum += cwk_path.get_segment_type(&segment);
+      } while (cwk_path.get_next_segment(&segment));
+    }
+  });
+}
+
+void api_previous_segment(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    struct cwk_segment segment;
+    if (cwk_path.get_last_segment(a, &segment)) {
+      do {
+        run->checksum += segment.size;
+      } while (cwk_path.get_previous_segment(&segment));
+    }
+  });
+}
+
+void api_change_segment(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    struct cwk_segment segment;
+    if (cwk_path.get_first_segment(a, &segment)) {
+      run->checksum += cwk_path.change_segment(&segment, "other", buffer,
+        sizeof(buffer));
+    }
+  });
+}
+
+void api_segment_index(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    struct cwk_segment_index_entry entries[64];
+    struct cwk_segment_index index;
+    struct cwk_segment segment;
+    index.entries = entries;
+    index.capacity = 64;
+    run->checksum += cwk_path.get_segment_index(a, &index);
+    if (cwk_path.get_indexed_segment(&index, index.count / 2, &segment)) {
+      run->checksum += segment.size;
+    }
+  });
+}
+
+void api_segments(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    for (auto segment : cwk_path.segments(a)) {
+      run->checksum += segment.size();
+    }
+  });
+}
+
+void api_joined_segments(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    const char *paths[] = {a, b, NULL};
+    for (auto segment : cwk_path.joined_segments(paths)) {
+      run->checksum += segment.size();
+    }
+  });
+}
+
+void api_visible_segments(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    for (auto segment : cwk_path.visible_segments(a)) {
+      run->checksum += segment.size();
+    }
+  });
+}
+
+void api_normalized_view(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    for (auto segment : cwk_path.normalized_view(a, b)) {
+      run->checksum += segment.size();
+    }
+  });
+}
+
+void api_expression(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.expression(a, b)
+                       .with_basename("file")
+                       .with_extension("o")
+                       .write(buffer, sizeof(buffer));
+  });
+}
+
+void api_absolute_expression(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    run->checksum += cwk_path.absolute_expression(a, b).write(buffer,
+      sizeof(buffer));
+  });
+}
+
+void api_builder(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *b) {
+    auto builder = cwk_path.builder(a);
+    run->checksum += builder.push(b);
+    builder.pop();
+    run->checksum += builder.length();
+  });
+}
+
+void api_is_separator(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    for (; *a; ++a) {
+      run->checksum += cwk_path.is_separator(a);
+    }
+  });
+}
+
+void api_guess_style(struct cwk_bench_run *run)
+{
+  each_path(run, [run](const cwk &cwk_path, const char *a, const char *) {
+    run->checksum += cwk_path.guess_style(a) + cwk_path.get_style();
+  });
+}
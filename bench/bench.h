@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cwalk.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * The amount of buckets for every power of two in a latency histogram. The
+ * recorded values are accurate to about 1.6% with 64 of them, like an
+ * HdrHistogram with two significant digits.
+ */
+#define CWK_BENCH_HISTOGRAM_BUCKETS 64
+
+/**
+ * A latency histogram of single calls in nanoseconds. The maximum is kept
+ * exactly, all other values are only kept in their bucket.
+ */
+struct cwk_bench_histogram
+{
+  uint64_t counts[64 * CWK_BENCH_HISTOGRAM_BUCKETS];
+  uint64_t total;
+  uint64_t max;
+};
+
+/**
+ * The latencies of the calls of a benchmark, grouped by the class of their
+ * input. The benchmark decides what the class is, like the corpus of the path
+ * or the operation of a trace.
+ */
+struct cwk_bench_latency
+{
+  std::vector<std::pair<std::string, cwk_bench_histogram>> classes;
+};
+
+/**
+ * A benchmark run is handed to every benchmark function. The benchmark must
+ * repeat its workload the requested amount of iterations and report how many
+ * operations it executed. The checksum should depend on the results, so the
+ * compiler can not remove the work. The latency is only set if the latencies
+ * of the single calls are recorded, see cwk_bench_call.
+ *
+ * Benchmarks of engines which run in parallel on their own use the given
+ * amount of threads, or one per core if it is zero, and set parallel. All
+ * other benchmarks are run by that many threads at the same time when the
+ * scaling is measured, so they must keep their buffers per thread.
+ */
+struct cwk_bench_run
+{
+  size_t iterations;
+  size_t operations;
+  size_t bytes;
+  size_t checksum;
+  struct cwk_bench_latency *latency;
+  size_t threads;
+  bool parallel;
+};
+
+/**
+ * Records the latency of a single call for an input class. The time it takes
+ * to read the clock is subtracted.
+ */
+void cwk_bench_latency_record(struct cwk_bench_latency *latency,
+  const char *input_class, uint64_t nanoseconds);
+
+/**
+ * Returns the latency below which the given fraction of the calls were, like
+ * 0.99 for the 99th percentile.
+ */
+uint64_t cwk_bench_histogram_percentile(
+  const struct cwk_bench_histogram *histogram, double fraction);
+
+/**
+ * Executes a single call of a benchmark. The call is timed on its own if the
+ * latencies are recorded for this run.
+ */
+template <typename T_FN>
+inline void cwk_bench_call(
+  struct cwk_bench_run *run, const char *input_class, T_FN fn)
+{
+  std::chrono::steady_clock::time_point start, end;
+
+  if (run->latency == NULL) {
+    fn();
+    return;
+  }
+
+  start = std::chrono::steady_clock::now();
+  fn();
+  end = std::chrono::steady_clock::now();
+  cwk_bench_latency_record(run->latency, input_class,
+    (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start)
+      .count());
+}
+
+/**
+ * Returns the root of a generated directory tree for benchmarks which need
+ * real files. This is only available on linux.
+ */
+const std::string &cwk_bench_tree();
+
+/**
+ * A corpus is a generated list of paths of a single kind, like deep paths or
+ * UNC paths, together with the style they are written in. The paths are the
+ * same on every run, so the results can be compared between builds.
+ */
+struct cwk_bench_corpus
+{
+  const char *name;
+  cwk_path_style style;
+  std::vector<std::string> paths;
+};
+
+/**
+ * Returns all corpora, or only the selected one if a corpus was selected.
+ */
+const std::vector<cwk_bench_corpus> &cwk_bench_corpora();
+
+/**
+ * Restricts the corpora to the one with the given name. Returns false if there
+ * is no corpus with that name.
+ */
+bool cwk_bench_select_corpus(const char *name);
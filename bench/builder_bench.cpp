@@ -0,0 +1,38 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <stdio.h>
+#include <string.h>
+
+static const cwk_unix cwk_path;
+
+static const char *names[] = {"main.cpp", "include", "README.md", "build",
+  "CMakeLists.txt", "test", "a_rather_long_file_name_for_a_source.cpp"};
+
+void builder_join(struct cwk_bench_run *run)
+{
+  char buffer[FILENAME_MAX];
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      // This is how walkers create the path of every child of a directory.
+      run->checksum += cwk_path.join("/home/user/projects/cwalk/src", names[j],
+        buffer, sizeof(buffer));
+      ++run->operations;
+    }
+  }
+}
+
+void builder_push_pop(struct cwk_bench_run *run)
+{
+  size_t i, j;
+
+  auto builder = cwk_path.builder("/home/user/projects/cwalk/src");
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      run->checksum += builder.push(names[j]);
+      builder.pop();
+      ++run->operations;
+    }
+  }
+}
@@ -0,0 +1,161 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <iterator>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/**
+ * The amount of repetitions in the crafted inputs. The inputs are a few ten
+ * kilobytes long, so code which is quadratic in their length stands out.
+ */
+#define COMPLEXITY_SIZE 4096
+
+static const cwk_unix cwk_path;
+static thread_local char buffer[1 << 20];
+
+static std::string repeat(const char *part, size_t count)
+{
+  std::string result;
+
+  while (count-- > 0) {
+    result += part;
+  }
+
+  return result;
+}
+
+static void normalize_each(
+  struct cwk_bench_run *run, const std::string &input)
+{
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    cwk_bench_call(run, "crafted", [&]() {
+      run->checksum += cwk_path.normalize(input.c_str(), buffer,
+        sizeof(buffer));
+    });
+    run->bytes += input.size();
+    ++run->operations;
+  }
+}
+
+void complexity_pairs(struct cwk_bench_run *run)
+{
+  normalize_each(run, "/" + repeat("a/../", COMPLEXITY_SIZE));
+}
+
+void complexity_backs(struct cwk_bench_run *run)
+{
+  normalize_each(run, repeat("../", COMPLEXITY_SIZE) + "a");
+}
+
+void complexity_nested(struct cwk_bench_run *run)
+{
+  normalize_each(run,
+    "/" + repeat("a/", COMPLEXITY_SIZE) + repeat("../", COMPLEXITY_SIZE));
+}
+
+void complexity_segment(struct cwk_bench_run *run)
+{
+  normalize_each(run, "/" + std::string(65536, 'a'));
+}
+
+void complexity_join(struct cwk_bench_run *run)
+{
+  static const char *fragments[] = {"a/", "b/../", "../", "./c", ""};
+  std::vector<const char *> paths;
+  size_t i, length;
+
+  // Hundreds of short fragments, which move back and forth between them.
+  paths.push_back("/");
+  length = 1;
+  for (i = 0; i < COMPLEXITY_SIZE / 8; ++i) {
+    paths.push_back(fragments[i % 5]);
+    length += strlen(fragments[i % 5]);
+  }
+
+  paths.push_back(NULL);
+  for (i = 0; i < run->iterations; ++i) {
+    cwk_bench_call(run, "crafted", [&]() {
+      run->checksum += cwk_path.join_multiple(
+        paths.data(), buffer, sizeof(buffer));
+    });
+    run->bytes += length;
+    ++run->operations;
+  }
+}
+
+void complexity_relative(struct cwk_bench_run *run)
+{
+  std::string base, path;
+  size_t i;
+
+  // Both paths keep almost all of their segments, but have a back segment at
+  // their very end.
+  base = "/" + repeat("a/", COMPLEXITY_SIZE) + "b/..";
+  path = "/" + repeat("a/", COMPLEXITY_SIZE / 2) + "c/..";
+  for (i = 0; i < run->iterations; ++i) {
+    cwk_bench_call(run, "crafted", [&]() {
+      run->checksum += cwk_path.get_relative(
+        base.c_str(), path.c_str(), buffer, sizeof(buffer));
+    });
+    run->bytes += base.size() + path.size();
+    ++run->operations;
+  }
+}
+
+void complexity_visible(struct cwk_bench_run *run)
+{
+  std::string input;
+  size_t i;
+
+  input = repeat("../", COMPLEXITY_SIZE) + repeat("a/", COMPLEXITY_SIZE) +
+          repeat("../", COMPLEXITY_SIZE / 2);
+  for (i = 0; i < run->iterations; ++i) {
+    cwk_bench_call(run, "crafted", [&]() {
+      auto range = cwk_path.visible_segments(input.c_str());
+      auto begin = range.begin();
+      auto it = std::ranges::next(begin, range.end());
+
+      // The visible segments are walked backwards as well, which looks at the
+      // segments in front of every back segment.
+      while (it != begin) {
+        --it;
+        run->checksum += (*it).size();
+      }
+    });
+
+    run->bytes += input.size();
+    ++run->operations;
+  }
+}
+
+void complexity_interleaved(struct cwk_bench_run *run)
+{
+  std::string base, path;
+  size_t i;
+
+  // The segments which are kept and removed alternate all over both paths.
+  base = "/" + repeat("a/b/../", COMPLEXITY_SIZE);
+  path = "/" + repeat("a/b/c/../../", COMPLEXITY_SIZE);
+  for (i = 0; i < run->iterations; ++i) {
+    cwk_bench_call(run, "crafted", [&]() {
+      run->checksum += cwk_path.get_relative(
+        base.c_str(), path.c_str(), buffer, sizeof(buffer));
+      run->checksum += cwk_path.get_intersection(base.c_str(), path.c_str());
+
+      auto range = cwk_path.visible_segments(path.c_str());
+      auto begin = range.begin();
+      auto it = std::ranges::next(begin, range.end());
+
+      while (it != begin) {
+        --it;
+        run->checksum += (*it).size();
+      }
+    });
+
+    run->bytes += base.size() + path.size();
+    ++run->operations;
+  }
+}
@@ -0,0 +1,197 @@
+#include "bench.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The amount of paths in every corpus, which can be changed with
+ * CWK_BENCH_CORPUS_PATHS.
+ */
+#define CWK_BENCH_CORPUS_PATHS 256
+
+static std::vector<cwk_bench_corpus> selected;
+
+static uint64_t next_random(uint64_t *state)
+{
+  // This is xorshift64, which is good enough to make up names and the same on
+  // every platform.
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static std::string make_name(uint64_t *state, size_t min, size_t max,
+  bool mixed_case)
+{
+  std::string name;
+  size_t i, length;
+  char c;
+
+  length = min + next_random(state) % (max - min + 1);
+  for (i = 0; i < length; ++i) {
+    c = (char)('a' + next_random(state) % 26);
+    if (mixed_case && next_random(state) % 2) {
+      c = (char)(c - 'a' + 'A');
+    }
+
+    name += c;
+  }
+
+  return name;
+}
+
+static std::string make_path(uint64_t *state, const char *root, size_t min,
+  size_t max, const char *separator, size_t name_min, size_t name_max,
+  bool mixed_case)
+{
+  std::string path;
+  size_t i, count;
+
+  path = root;
+  count = min + next_random(state) % (max - min + 1);
+  for (i = 0; i < count; ++i) {
+    if (i > 0) {
+      path += separator;
+    }
+
+    path += make_name(state, name_min, name_max, mixed_case);
+  }
+
+  return path;
+}
+
+static std::string make_shallow(uint64_t *state)
+{
+  return make_path(state, next_random(state) % 2 ? "/" : "", 1, 3, "/", 1, 12,
+    false);
+}
+
+static std::string make_deep(uint64_t *state)
+{
+  return make_path(state, "/", 20, 60, "/", 1, 12, false);
+}
+
+static std::string make_dotdot(uint64_t *state)
+{
+  std::string path;
+  size_t i, count;
+
+  // Back segments are mixed with normal ones, and some of them go beyond the
+  // beginning of the path.
+  path = next_random(state) % 2 ? "/" : "";
+  count = 8 + next_random(state) % 24;
+  for (i = 0; i < count; ++i) {
+    switch (next_random(state) % 4) {
+    case 0:
+      path += "../";
+      break;
+    case 1:
+      path += "./";
+      break;
+    default:
+      path += make_name(state, 1, 8, false) + "/";
+      break;
+    }
+  }
+
+  return path + make_name(state, 1, 8, false);
+}
+
+static std::string make_trailing(uint64_t *state)
+{
+  std::string path;
+
+  path = make_path(state, "/", 1, 8, next_random(state) % 2 ? "/" : "//", 1,
+    12, false);
+  path.append(1 + next_random(state) % 4, '/');
+  return path;
+}
+
+static std::string make_long(uint64_t *state)
+{
+  return make_path(state, "/", 1, 4, "/", 200, 2000, false);
+}
+
+static std::string make_unc(uint64_t *state)
+{
+  std::string root;
+
+  root = next_random(state) % 2 ? "\\\\" : "\\\\?\\UNC\\";
+  root += make_name(state, 3, 10, false) + "\\" +
+          make_name(state, 3, 10, false) + "\\";
+  return make_path(state, root.c_str(), 1, 8, "\\", 1, 12, false);
+}
+
+static std::string make_device(uint64_t *state)
+{
+  static const char *roots[] = {"\\\\.\\", "\\\\?\\C:\\", "C:\\", "C:", "\\",
+    "\\\\.\\PhysicalDrive0\\"};
+
+  return make_path(state,
+    roots[next_random(state) % (sizeof(roots) / sizeof(roots[0]))], 1, 8, "\\",
+    1, 12, false);
+}
+
+static std::string make_mixed_case(uint64_t *state)
+{
+  std::string path;
+
+  path = make_path(state, "C:\\", 1, 8, next_random(state) % 2 ? "\\" : "/", 1,
+    12, true);
+  return path + "." + make_name(state, 1, 4, true);
+}
+
+static const std::vector<cwk_bench_corpus> &get_all()
+{
+  static std::vector<cwk_bench_corpus> corpora;
+  static const struct
+  {
+    const char *name;
+    cwk_path_style style;
+    std::string (*make)(uint64_t *state);
+  } kinds[] = {{"shallow", CWK_STYLE_UNIX, make_shallow},
+    {"deep", CWK_STYLE_UNIX, make_deep},
+    {"dotdot", CWK_STYLE_UNIX, make_dotdot},
+    {"trailing", CWK_STYLE_UNIX, make_trailing},
+    {"long", CWK_STYLE_UNIX, make_long},
+    {"unc", CWK_STYLE_WINDOWS, make_unc},
+    {"device", CWK_STYLE_WINDOWS, make_device},
+    {"mixed_case", CWK_STYLE_WINDOWS, make_mixed_case}};
+  const char *env;
+  uint64_t state;
+  size_t count, i;
+
+  if (!corpora.empty()) {
+    return corpora;
+  }
+
+  env = getenv("CWK_BENCH_CORPUS_PATHS");
+  count = env ? strtoul(env, NULL, 10) : CWK_BENCH_CORPUS_PATHS;
+  for (const auto &kind : kinds) {
+    corpora.push_back({kind.name, kind.style, {}});
+    state = 0x9e3779b97f4a7c15;
+    for (i = 0; i < count; ++i) {
+      corpora.back().paths.push_back(kind.make(&state));
+    }
+  }
+
+  return corpora;
+}
+
+const std::vector<cwk_bench_corpus> &cwk_bench_corpora()
+{
+  return selected.empty() ? get_all() : selected;
+}
+
+bool cwk_bench_select_corpus(const char *name)
+{
+  for (const cwk_bench_corpus &corpus : get_all()) {
+    if (strcmp(corpus.name, name) == 0) {
+      selected.assign(1, corpus);
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,153 @@
+#include "counters.h"
+#include <errno.h>
+#include <string.h>
+
+#if defined(__linux__)
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct
+{
+  uint32_t type;
+  uint64_t config;
+} events[CWK_BENCH_EVENTS] = {
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+  {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+bool cwk_bench_counters_open(struct cwk_bench_counters *counters)
+{
+  struct perf_event_attr attr;
+  int i, error;
+  bool available;
+
+  // Only the user space part of the benchmark is counted. This is allowed
+  // with the default perf_event_paranoid setting, while kernel events are
+  // not.
+  available = false;
+  error = 0;
+  for (i = 0; i < CWK_BENCH_EVENTS; ++i) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+      PERF_FLAG_FD_CLOEXEC);
+    counters->values[i] = 0;
+    if (counters->fds[i] >= 0) {
+      available = true;
+    } else if (error == 0) {
+      error = errno;
+    }
+  }
+
+  errno = error;
+  return available;
+}
+
+void cwk_bench_counters_start(struct cwk_bench_counters *counters)
+{
+  int i;
+
+  for (i = 0; i < CWK_BENCH_EVENTS; ++i) {
+    if (counters->fds[i] >= 0) {
+      ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void cwk_bench_counters_stop(struct cwk_bench_counters *counters)
+{
+  uint64_t data[3];
+  int i;
+
+  for (i = 0; i < CWK_BENCH_EVENTS; ++i) {
+    if (counters->fds[i] < 0) {
+      continue;
+    }
+
+    ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    // The value is followed by the time the event was enabled and the time
+    // it actually was on the hardware. Those differ if there are more events
+    // than hardware counters, and the value is extrapolated.
+    if (read(counters->fds[i], data, sizeof(data)) != sizeof(data) ||
+        data[2] == 0) {
+      counters->values[i] = 0;
+    } else if (data[2] < data[1]) {
+      counters->values[i] =
+        (uint64_t)((double)data[0] * (double)data[1] / (double)data[2]);
+    } else {
+      counters->values[i] = data[0];
+    }
+  }
+}
+
+bool cwk_bench_counters_has(
+  const struct cwk_bench_counters *counters, enum cwk_bench_event event)
+{
+  return counters->fds[event] >= 0;
+}
+
+void cwk_bench_counters_close(struct cwk_bench_counters *counters)
+{
+  int i;
+
+  for (i = 0; i < CWK_BENCH_EVENTS; ++i) {
+    if (counters->fds[i] >= 0) {
+      close(counters->fds[i]);
+      counters->fds[i] = -1;
+    }
+  }
+}
+
+#else
+
+bool cwk_bench_counters_open(struct cwk_bench_counters *counters)
+{
+  int i;
+
+  for (i = 0; i < CWK_BENCH_EVENTS; ++i) {
+    counters->fds[i] = -1;
+    counters->values[i] = 0;
+  }
+
+  errno = ENOSYS;
+  return false;
+}
+
+void cwk_bench_counters_start(struct cwk_bench_counters *)
+{
+}
+
+void cwk_bench_counters_stop(struct cwk_bench_counters *)
+{
+}
+
+bool cwk_bench_counters_has(
+  const struct cwk_bench_counters *counters, enum cwk_bench_event event)
+{
+  return counters->fds[event] >= 0;
+}
+
+void cwk_bench_counters_close(struct cwk_bench_counters *)
+{
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * The hardware events which are counted for every sample.
+ */
+enum cwk_bench_event
+{
+  CWK_BENCH_CYCLES,
+  CWK_BENCH_INSTRUCTIONS,
+  CWK_BENCH_BRANCH_MISSES,
+  CWK_BENCH_L1_MISSES,
+  CWK_BENCH_LLC_MISSES,
+  CWK_BENCH_EVENTS
+};
+
+/**
+ * The hardware counters of the benchmark process. Every event has its own
+ * descriptor, so the events which are not supported by the machine are just
+ * missing instead of disabling all of them. Events which could not be opened
+ * have a descriptor of -1.
+ */
+struct cwk_bench_counters
+{
+  int fds[CWK_BENCH_EVENTS];
+  uint64_t values[CWK_BENCH_EVENTS];
+};
+
+/**
+ * Opens the counters, and returns false if none of them is available. The
+ * error of the first event is left in errno in that case. This is only
+ * supported on linux.
+ */
+bool cwk_bench_counters_open(struct cwk_bench_counters *counters);
+
+/**
+ * Resets and starts all available counters.
+ */
+void cwk_bench_counters_start(struct cwk_bench_counters *counters);
+
+/**
+ * Stops all counters and reads their values. The values are scaled up if the
+ * kernel had to share the hardware counters with other events.
+ */
+void cwk_bench_counters_stop(struct cwk_bench_counters *counters);
+
+/**
+ * Returns whether the event could be opened.
+ */
+bool cwk_bench_counters_has(
+  const struct cwk_bench_counters *counters, enum cwk_bench_event event);
+
+/**
+ * Closes all counters.
+ */
+void cwk_bench_counters_close(struct cwk_bench_counters *counters);
@@ -0,0 +1,45 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <stdio.h>
+#include <string.h>
+
+static const cwk_unix cwk_path;
+
+static const char *sources[] = {"src/cwalk/path.cpp", "../shared/util.cpp",
+  "deep/nested/module/with/many/levels/impl.cpp", "main.cpp"};
+
+void expression_chained(struct cwk_bench_run *run)
+{
+  char buffer[FILENAME_MAX];
+  size_t i, j, length;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(sources) / sizeof(sources[0]); ++j) {
+      // This is the typical artifact naming: join with the output directory,
+      // prefix the basename and replace the extension.
+      cwk_path.join("/build/output/objects", sources[j], buffer,
+        sizeof(buffer));
+      cwk_path.change_root(buffer, "/mnt/", buffer, sizeof(buffer));
+      length = cwk_path.change_extension(buffer, "o", buffer, sizeof(buffer));
+      run->checksum += length;
+      ++run->operations;
+    }
+  }
+}
+
+void expression_fused(struct cwk_bench_run *run)
+{
+  char buffer[FILENAME_MAX];
+  size_t i, j, length;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(sources) / sizeof(sources[0]); ++j) {
+      length = cwk_path.expression("/build/output/objects", sources[j])
+                 .with_root("/mnt/")
+                 .with_extension("o")
+                 .write(buffer, sizeof(buffer));
+      run->checksum += length;
+      ++run->operations;
+    }
+  }
+}
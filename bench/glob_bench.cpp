@@ -0,0 +1,80 @@
+#include "bench.h"
+#include <cwalk_glob.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const cwk_unix cwk_path;
+
+static const char *paths[] = {"src/module17/impl/detail/file.cpp",
+  "include/module4/api.h", "docs/reference/module99/index.md",
+  "build/output/objects/main.o", "node_modules/pkg/lib/index.js"};
+
+static std::vector<std::string> create_patterns()
+{
+  std::vector<std::string> patterns;
+  size_t i;
+
+  // These resemble routing rules, which mostly differ in a directory name
+  // and share the same structure.
+  for (i = 0; i < 1000; ++i) {
+    patterns.push_back("src/module" + std::to_string(i) + "/**/*.cpp");
+    patterns.push_back("include/module" + std::to_string(i) + "/*.h");
+  }
+
+  patterns.push_back("**/node_modules/**");
+  patterns.push_back("docs/**/*.{md,txt}");
+  return patterns;
+}
+
+void glob_individual(struct cwk_bench_run *run)
+{
+  static const std::vector<std::string> patterns = create_patterns();
+  static thread_local std::vector<cwk_glob> globs;
+  size_t i, j, k;
+
+  if (globs.empty()) {
+    for (const std::string &pattern : patterns) {
+      // The individual globs don't support braces, so those are written out.
+      if (pattern == "docs/**/*.{md,txt}") {
+        globs.push_back(cwk_glob(cwk_path, "docs/**/*.md"));
+        globs.push_back(cwk_glob(cwk_path, "docs/**/*.txt"));
+      } else {
+        globs.push_back(cwk_glob(cwk_path, pattern.c_str()));
+      }
+    }
+  }
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      for (k = 0; k < globs.size(); ++k) {
+        run->checksum += globs[k].match(paths[j]);
+      }
+
+      run->bytes += strlen(paths[j]);
+      ++run->operations;
+    }
+  }
+}
+
+void glob_set(struct cwk_bench_run *run)
+{
+  static const std::vector<std::string> patterns = create_patterns();
+  static thread_local cwk_glob_set set(cwk_path);
+  std::vector<size_t> matches;
+  size_t i, j;
+
+  if (set.size() == 0) {
+    for (const std::string &pattern : patterns) {
+      set.add(pattern.c_str());
+    }
+  }
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      run->checksum += set.match(paths[j], &matches);
+      run->bytes += strlen(paths[j]);
+      ++run->operations;
+    }
+  }
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+#include <bit>
+#include <math.h>
+
+/**
+ * Values below this are counted exactly. Above it, every power of two is split
+ * into CWK_BENCH_HISTOGRAM_BUCKETS buckets of equal width.
+ */
+#define EXACT_VALUES (2 * CWK_BENCH_HISTOGRAM_BUCKETS)
+
+static size_t get_bucket(uint64_t value)
+{
+  size_t shift;
+
+  if (value < EXACT_VALUES) {
+    return (size_t)value;
+  }
+
+  // The shift is the width of the buckets in the range of the value, which
+  // keeps the top bits of the value as the position within the range.
+  shift = (size_t)std::bit_width(value) - std::bit_width(
+                                            (uint64_t)EXACT_VALUES - 1);
+  return EXACT_VALUES + (shift - 1) * CWK_BENCH_HISTOGRAM_BUCKETS +
+         (size_t)(value >> shift) - CWK_BENCH_HISTOGRAM_BUCKETS;
+}
+
+static uint64_t get_bucket_end(size_t bucket)
+{
+  size_t shift;
+  uint64_t position;
+
+  if (bucket < EXACT_VALUES) {
+    return bucket;
+  }
+
+  shift = (bucket - EXACT_VALUES) / CWK_BENCH_HISTOGRAM_BUCKETS + 1;
+  position = (bucket - EXACT_VALUES) % CWK_BENCH_HISTOGRAM_BUCKETS +
+             CWK_BENCH_HISTOGRAM_BUCKETS;
+  return ((position + 1) << shift) - 1;
+}
+
+static uint64_t get_clock_overhead()
+{
+  std::chrono::steady_clock::time_point start, end;
+  uint64_t best, elapsed;
+  size_t i;
+
+  // The clock is read twice for every call, so the shortest time between two
+  // reads is part of every recorded latency.
+  best = UINT64_MAX;
+  for (i = 0; i < 1000; ++i) {
+    start = std::chrono::steady_clock::now();
+    end = std::chrono::steady_clock::now();
+    elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start)
+                .count();
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return best;
+}
+
+void cwk_bench_latency_record(struct cwk_bench_latency *latency,
+  const char *input_class, uint64_t nanoseconds)
+{
+  static const uint64_t overhead = get_clock_overhead();
+  cwk_bench_histogram *histogram;
+
+  histogram = NULL;
+  for (auto &entry : latency->classes) {
+    if (entry.first == input_class) {
+      histogram = &entry.second;
+      break;
+    }
+  }
+
+  if (histogram == NULL) {
+    latency->classes.emplace_back(input_class, cwk_bench_histogram{});
+    histogram = &latency->classes.back().second;
+  }
+
+  nanoseconds = nanoseconds > overhead ? nanoseconds - overhead : 0;
+  ++histogram->counts[get_bucket(nanoseconds)];
+  ++histogram->total;
+  if (nanoseconds > histogram->max) {
+    histogram->max = nanoseconds;
+  }
+}
+
+uint64_t cwk_bench_histogram_percentile(
+  const struct cwk_bench_histogram *histogram, double fraction)
+{
+  uint64_t rank, seen, end;
+  size_t i;
+
+  // The percentile is the end of the bucket which contains the call at that
+  // rank, but never more than the actual maximum.
+  rank = (uint64_t)ceil(fraction * (double)histogram->total);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  seen = 0;
+  for (i = 0; i < sizeof(histogram->counts) / sizeof(histogram->counts[0]);
+       ++i) {
+    seen += histogram->counts[i];
+    if (seen >= rank) {
+      end = get_bucket_end(i);
+      return end < histogram->max ? end : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
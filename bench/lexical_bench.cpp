@@ -0,0 +1,196 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+/**
+ * The buffer size for the results, which has to hold the longest paths of the
+ * corpora.
+ */
+#define LEXICAL_BUFFER_SIZE 16384
+
+/**
+ * std::filesystem always uses the path style of the operating system, so only
+ * the corpora in that style are compared. That is the default style of cwk.
+ */
+static const cwk cwk_path;
+static thread_local char buffer[LEXICAL_BUFFER_SIZE];
+
+/**
+ * A pair of consecutive paths of a corpus. The suffix is the second path
+ * without its root, so it can be appended to the first one. The std paths are
+ * constructed up front, since code which uses std::filesystem keeps them
+ * around as well.
+ */
+struct lexical_pair
+{
+  const char *corpus;
+  std::string base;
+  std::string path;
+  std::string suffix;
+  std::filesystem::path std_base;
+  std::filesystem::path std_path;
+  std::filesystem::path std_suffix;
+};
+
+static bool is_equivalent(const char *result, std::filesystem::path expected)
+{
+  std::string native;
+
+  // std::filesystem keeps a trailing separator as an empty last element, while
+  // cwalk always removes it. Apart from that, both results must be the same.
+  native = expected.string();
+  if (expected.has_relative_path() && !native.empty() &&
+      native.back() == std::filesystem::path::preferred_separator) {
+    native.pop_back();
+  }
+
+  return native == result;
+}
+
+static void check_equivalent(const char *operation, const lexical_pair &pair,
+  const char *result, const std::filesystem::path &expected)
+{
+  if (!is_equivalent(result, expected)) {
+    fprintf(stderr,
+      "\n%s of '%s' and '%s' differs: cwalk '%s', std::filesystem '%s'\n",
+      operation, pair.base.c_str(), pair.path.c_str(), result,
+      expected.string().c_str());
+    exit(EXIT_FAILURE);
+  }
+}
+
+static const std::vector<lexical_pair> &lexical_pairs()
+{
+  static std::vector<lexical_pair> pairs;
+  static bool prepared;
+  size_t i, length;
+
+  if (prepared) {
+    return pairs;
+  }
+
+  prepared = true;
+  for (const cwk_bench_corpus &corpus : cwk_bench_corpora()) {
+    if (corpus.style != cwk_path.get_style()) {
+      continue;
+    }
+
+    for (i = 0; i < corpus.paths.size(); ++i) {
+      lexical_pair pair;
+      pair.corpus = corpus.name;
+      pair.base = corpus.paths[i];
+      pair.path = corpus.paths[(i + 1) % corpus.paths.size()];
+      cwk_path.get_root(pair.path.c_str(), &length);
+      pair.suffix = pair.path.substr(length);
+      pair.std_base = pair.base;
+      pair.std_path = pair.path;
+      pair.std_suffix = pair.suffix;
+      pairs.push_back(pair);
+    }
+  }
+
+  // The results are compared once before anything is measured, so a change
+  // of the header which breaks the equivalence can't go unnoticed. The
+  // operations are chosen so the semantics agree, see the benchmarks below.
+  for (const lexical_pair &pair : pairs) {
+    cwk_path.normalize(pair.base.c_str(), buffer, sizeof(buffer));
+    check_equivalent(
+      "normalize", pair, buffer, pair.std_base.lexically_normal());
+
+    // A base which still starts with a back segment after normalizing leaves
+    // the path it is relative to. Neither of them can know the names of the
+    // directories it left, so they make up different results for it.
+    if (*pair.std_base.lexically_normal().begin() != "..") {
+      cwk_path.get_relative(pair.base.c_str(), pair.path.c_str(), buffer,
+        sizeof(buffer));
+      check_equivalent("get_relative", pair, buffer,
+        pair.std_path.lexically_normal().lexically_relative(
+          pair.std_base.lexically_normal()));
+    }
+
+    cwk_path.join(pair.base.c_str(), pair.suffix.c_str(), buffer,
+      sizeof(buffer));
+    check_equivalent("join", pair, buffer,
+      (pair.std_base / pair.std_suffix).lexically_normal());
+  }
+
+  return pairs;
+}
+
+template <typename T_FN> static void each_pair(struct cwk_bench_run *run,
+  T_FN fn)
+{
+  const std::vector<lexical_pair> &pairs = lexical_pairs();
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (const lexical_pair &pair : pairs) {
+      cwk_bench_call(run, pair.corpus, [&]() { fn(pair); });
+      run->bytes += pair.base.size();
+      ++run->operations;
+    }
+  }
+}
+
+void lexical_normalize_cwalk(struct cwk_bench_run *run)
+{
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += cwk_path.normalize(pair.base.c_str(), buffer,
+      sizeof(buffer));
+  });
+}
+
+void lexical_normalize_std(struct cwk_bench_run *run)
+{
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += pair.std_base.lexically_normal().native().size();
+  });
+}
+
+void lexical_relative_cwalk(struct cwk_bench_run *run)
+{
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += cwk_path.get_relative(pair.base.c_str(),
+      pair.path.c_str(), buffer, sizeof(buffer));
+  });
+}
+
+void lexical_relative_std(struct cwk_bench_run *run)
+{
+  // lexically_relative does not resolve dot segments, while get_relative
+  // does. Both paths are normalized first to get the same result.
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += pair.std_path.lexically_normal()
+                       .lexically_relative(pair.std_base.lexically_normal())
+                       .native()
+                       .size();
+  });
+}
+
+void lexical_join_cwalk(struct cwk_bench_run *run)
+{
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += cwk_path.join(pair.base.c_str(), pair.suffix.c_str(),
+      buffer, sizeof(buffer));
+  });
+}
+
+void lexical_join_std(struct cwk_bench_run *run)
+{
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum += (pair.std_base / pair.std_suffix).native().size();
+  });
+}
+
+void lexical_join_normal_std(struct cwk_bench_run *run)
+{
+  // The join of cwalk normalizes the result, which operator/ does not.
+  each_pair(run, [run](const lexical_pair &pair) {
+    run->checksum +=
+      (pair.std_base / pair.std_suffix).lexically_normal().native().size();
+  });
+}
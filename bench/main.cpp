@@ -0,0 +1,524 @@
+#include "bench.h"
+#include "benchmarks.h"
+#include "counters.h"
+#include "report.h"
+#include <barrier>
+#include <chrono>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+/**
+ * This is just a small macro which calculates the size of an array.
+ */
+#define CWK_ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+/**
+ * The amount of samples which are taken for every benchmark, and the minimum
+ * time a single sample should take. The iterations are scaled until a sample
+ * takes at least that long.
+ */
+#define CWK_BENCH_SAMPLES 5
+#define CWK_BENCH_MIN_SAMPLE_NS 20000000.0
+
+struct cwk_bench
+{
+  const char *unit_name;
+  const char *bench_name;
+  const char *full_name;
+  void (*fn)(struct cwk_bench_run *);
+};
+
+#define XX(u, b) extern void u##_##b(struct cwk_bench_run *run);
+BENCHMARKS(XX)
+#undef XX
+
+static struct cwk_bench benches[] = {
+#define XX(u, b)                                                               \
+  {.unit_name = #u, .bench_name = #b, .full_name = #u "/" #b, .fn = u##_##b},
+  BENCHMARKS(XX)
+#undef XX
+};
+
+/**
+ * The hardware counters, which are only read if CWK_BENCH_COUNTERS is set.
+ */
+static struct cwk_bench_counters counters;
+static bool use_counters;
+
+/**
+ * Whether the latencies of single calls are recorded, which is enabled with
+ * CWK_BENCH_LATENCY.
+ */
+static bool use_latency;
+
+/**
+ * The highest amount of threads when the scaling is measured, which is enabled
+ * with CWK_BENCH_SCALING. It is zero if the scaling is not measured.
+ */
+static size_t max_threads;
+
+/**
+ * A thread which runs a benchmark while the scaling is measured. Every worker
+ * has cache lines of its own, so the runs of different threads don't share
+ * any and the results show the contention within the library only.
+ */
+struct alignas(64) cwk_bench_worker
+{
+  struct cwk_bench_run run;
+  std::thread thread;
+};
+
+static double run_sample(struct cwk_bench *bench, struct cwk_bench_run *run)
+{
+  std::chrono::steady_clock::time_point start, end;
+
+  run->operations = 0;
+  run->bytes = 0;
+  if (use_counters) {
+    cwk_bench_counters_start(&counters);
+  }
+
+  start = std::chrono::steady_clock::now();
+  bench->fn(run);
+  end = std::chrono::steady_clock::now();
+  if (use_counters) {
+    cwk_bench_counters_stop(&counters);
+  }
+
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    end - start)
+    .count();
+}
+
+static void print_per(const struct cwk_bench_counters *values,
+  enum cwk_bench_event event, double amount, const char *unit)
+{
+  if (!cwk_bench_counters_has(values, event) || amount == 0) {
+    printf(" %10s %s", "n/a", unit);
+  } else {
+    printf(" %10.4f %s", (double)values->values[event] / amount, unit);
+  }
+}
+
+static void print_counters(
+  const struct cwk_bench_counters *values, const struct cwk_bench_run *run)
+{
+  double operations;
+
+  // The counters are printed in a line of their own below the timings. The
+  // branch misses are related to the bytes if the benchmark reports them,
+  // since most of the work of the library is spent in byte loops.
+  printf("%47s", "");
+  if (cwk_bench_counters_has(values, CWK_BENCH_CYCLES) &&
+      cwk_bench_counters_has(values, CWK_BENCH_INSTRUCTIONS) &&
+      values->values[CWK_BENCH_CYCLES] > 0) {
+    printf(" %10.2f IPC", (double)values->values[CWK_BENCH_INSTRUCTIONS] /
+                            (double)values->values[CWK_BENCH_CYCLES]);
+  } else {
+    printf(" %10s IPC", "n/a");
+  }
+
+  operations = (double)run->operations;
+  if (run->bytes > 0) {
+    print_per(values, CWK_BENCH_BRANCH_MISSES, (double)run->bytes,
+      "branch misses/byte");
+  } else {
+    print_per(values, CWK_BENCH_BRANCH_MISSES, operations, "branch misses/op");
+  }
+
+  print_per(values, CWK_BENCH_L1_MISSES, operations, "L1 misses/op");
+  print_per(values, CWK_BENCH_LLC_MISSES, operations, "LLC misses/op");
+  printf("\n");
+}
+
+#ifdef CWK_STATS
+
+static void print_stats(const cwk_stats *stats, double operations)
+{
+  // The operation counters are the same for every sample, so they are just
+  // divided by all operations of all samples. Work which a benchmark does in
+  // other threads is not counted.
+  printf("%47s %10.2f segments/op %10.2f scanned/op %10.2f written/op", "",
+    (double)stats->segments / operations,
+    (double)stats->bytes_scanned / operations,
+    (double)stats->bytes_written / operations);
+  printf(" %8.4f truncations/op %8.4f rescans/op %8.4f roots/op\n",
+    (double)stats->truncations / operations,
+    (double)stats->removal_scans / operations,
+    (double)stats->root_parses / operations);
+}
+
+#endif
+
+static void format_latency(char *buffer, size_t size, uint64_t nanoseconds)
+{
+  if (nanoseconds < 10000) {
+    snprintf(buffer, size, "%llu ns", (unsigned long long)nanoseconds);
+  } else if (nanoseconds < 10000000) {
+    snprintf(buffer, size, "%.1f us", (double)nanoseconds / 1000.0);
+  } else {
+    snprintf(buffer, size, "%.1f ms", (double)nanoseconds / 1000000.0);
+  }
+}
+
+static void print_latency(
+  const struct cwk_bench_latency *latency, struct cwk_bench_result *result)
+{
+  static const double fractions[] = {0.5, 0.99, 0.999};
+  static const char *names[] = {"p50", "p99", "p99.9"};
+  char value[32];
+  size_t i;
+
+  // Every input class gets a line of its own below the timings. Benchmarks
+  // which don't time their calls on their own just don't have any.
+  for (const auto &entry : latency->classes) {
+    printf("%47s %-12s", "", entry.first.c_str());
+    for (i = 0; i < CWK_ARRAY_SIZE(fractions); ++i) {
+      format_latency(value, sizeof(value),
+        cwk_bench_histogram_percentile(&entry.second, fractions[i]));
+      printf(" %s %10s", names[i], value);
+    }
+
+    format_latency(value, sizeof(value), entry.second.max);
+    printf(" max %10s (%llu calls)\n", value,
+      (unsigned long long)entry.second.total);
+    result->classes.push_back({entry.first, entry.second.total,
+      cwk_bench_histogram_percentile(&entry.second, fractions[0]),
+      cwk_bench_histogram_percentile(&entry.second, fractions[1]),
+      cwk_bench_histogram_percentile(&entry.second, fractions[2]),
+      entry.second.max});
+  }
+}
+
+static void call_bench(
+  struct cwk_bench *bench, struct cwk_bench_result *result)
+{
+  struct cwk_bench_counters best_counters;
+  double samples[CWK_BENCH_SAMPLES];
+  double best, mean, variance;
+  struct cwk_bench_run run;
+  size_t i;
+
+  printf(" Running '%s' ", bench->full_name);
+  for (i = strlen(bench->full_name); i < 45; ++i) {
+    fputs(".", stdout);
+  }
+  fflush(stdout);
+
+  // We first find out how many iterations we need for a single sample to take
+  // long enough, so the timer resolution does not matter.
+  memset(&run, 0, sizeof(run));
+  run.iterations = 1;
+  while (run_sample(bench, &run) < CWK_BENCH_MIN_SAMPLE_NS &&
+         run.iterations < ((size_t)1 << 40)) {
+    run.iterations *= 2;
+  }
+
+  // Now we take the actual samples and report the best one, which is the one
+  // with the least noise of other processes. The deviation of the samples
+  // tells how much that noise was, so large ones mean the result is unstable.
+  best = mean = 0;
+#ifdef CWK_STATS
+  cwk_stats_reset();
+#endif
+  for (i = 0; i < CWK_BENCH_SAMPLES; ++i) {
+    samples[i] = run_sample(bench, &run);
+    if (i == 0 || samples[i] < best) {
+      best = samples[i];
+      best_counters = counters;
+    }
+
+    mean += samples[i] / CWK_BENCH_SAMPLES;
+  }
+
+  variance = 0;
+  for (i = 0; i < CWK_BENCH_SAMPLES; ++i) {
+    variance += (samples[i] - mean) * (samples[i] - mean) / CWK_BENCH_SAMPLES;
+  }
+
+  result->name = bench->full_name;
+  result->ns_per_op = run.operations ? best / (double)run.operations : 0.0;
+  result->mb_per_s = run.bytes > 0 ? (double)run.bytes * 1000.0 / best : 0.0;
+  result->deviation = mean > 0 ? sqrt(variance) / mean * 100 : 0.0;
+  printf(" %10.2f ns/op", result->ns_per_op);
+  if (run.bytes > 0) {
+    printf(" %10.2f MB/s", result->mb_per_s);
+  } else {
+    printf(" %15s", "");
+  }
+
+  printf(" +-%5.2f%% (checksum %zu)\n", result->deviation,
+    run.checksum % 1000);
+
+  // The counters belong to the best sample, just like the time.
+  if (use_counters) {
+    print_counters(&best_counters, &run);
+  }
+
+#ifdef CWK_STATS
+  const cwk_stats stats = cwk_stats_snapshot();
+  if (run.operations > 0) {
+    print_stats(&stats, (double)run.operations * CWK_BENCH_SAMPLES);
+  }
+#endif
+
+  // The latencies are recorded in a sample of their own, since reading the
+  // clock for every call slows down the short ones quite a bit.
+  if (use_latency) {
+    struct cwk_bench_latency latency;
+    run.latency = &latency;
+    run_sample(bench, &run);
+    run.latency = NULL;
+    print_latency(&latency, result);
+  }
+}
+
+static void run_workers(struct cwk_bench *bench, size_t iterations,
+  size_t threads, double *samples, struct cwk_bench_run *total)
+{
+  std::chrono::steady_clock::time_point start, end;
+  std::vector<cwk_bench_worker> workers(threads);
+  std::barrier<> barrier((ptrdiff_t)threads + 1);
+  size_t i;
+
+  // The workers stay around for all samples, so the buffers and engines they
+  // keep per thread are only set up in the first one, which is not counted.
+  // Every sample starts and ends at a barrier with all of them.
+  for (cwk_bench_worker &worker : workers) {
+    worker.run.iterations = iterations;
+    worker.run.threads = 1;
+    worker.thread = std::thread([bench, &worker, &barrier]() {
+      size_t j;
+
+      for (j = 0; j <= CWK_BENCH_SAMPLES; ++j) {
+        barrier.arrive_and_wait();
+        worker.run.operations = 0;
+        worker.run.bytes = 0;
+        bench->fn(&worker.run);
+        barrier.arrive_and_wait();
+      }
+    });
+  }
+
+  for (i = 0; i <= CWK_BENCH_SAMPLES; ++i) {
+    start = std::chrono::steady_clock::now();
+    barrier.arrive_and_wait();
+    barrier.arrive_and_wait();
+    end = std::chrono::steady_clock::now();
+    if (i > 0) {
+      samples[i - 1] =
+        (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+          end - start)
+          .count();
+    }
+  }
+
+  for (cwk_bench_worker &worker : workers) {
+    worker.thread.join();
+    // The operations and bytes are the ones of the last sample, which are the
+    // same in every sample.
+    total->operations += worker.run.operations;
+    total->bytes += worker.run.bytes;
+    total->checksum += worker.run.checksum;
+  }
+}
+
+static void scale_bench(
+  struct cwk_bench *bench, struct cwk_bench_report *report)
+{
+  double samples[CWK_BENCH_SAMPLES];
+  double best, mean, variance, throughput, base;
+  struct cwk_bench_run run, total;
+  size_t i, threads;
+
+  printf(" Scaling '%s'\n", bench->full_name);
+  fflush(stdout);
+
+  // The iterations are found with a single thread, and every thread runs
+  // that many of them. So the time of a sample stays the same as long as the
+  // benchmark scales linearly. This also prepares the inputs of the benchmark
+  // before any other thread uses them.
+  memset(&run, 0, sizeof(run));
+  run.iterations = 1;
+  run.threads = 1;
+  while (run_sample(bench, &run) < CWK_BENCH_MIN_SAMPLE_NS &&
+         run.iterations < ((size_t)1 << 40)) {
+    run.iterations *= 2;
+  }
+
+  base = 0;
+  threads = 1;
+  while (true) {
+    // Engines which are parallel on their own get the threads instead of
+    // being run by all of them.
+    memset(&total, 0, sizeof(total));
+    if (run.parallel) {
+      run.threads = threads;
+      for (i = 0; i < CWK_BENCH_SAMPLES; ++i) {
+        samples[i] = run_sample(bench, &run);
+      }
+
+      total = run;
+    } else {
+      run_workers(bench, run.iterations, threads, samples, &total);
+    }
+
+    best = mean = 0;
+    for (i = 0; i < CWK_BENCH_SAMPLES; ++i) {
+      if (i == 0 || samples[i] < best) {
+        best = samples[i];
+      }
+
+      mean += samples[i] / CWK_BENCH_SAMPLES;
+    }
+
+    variance = 0;
+    for (i = 0; i < CWK_BENCH_SAMPLES; ++i) {
+      variance +=
+        (samples[i] - mean) * (samples[i] - mean) / CWK_BENCH_SAMPLES;
+    }
+
+    // The efficiency is the throughput compared to the one of a single thread
+    // times the amount of threads, so a linear scaling is 100%.
+    throughput = best > 0 ? (double)total.operations * 1000.0 / best : 0.0;
+    if (threads == 1) {
+      base = throughput;
+    }
+
+    cwk_bench_result &result = report->results.emplace_back();
+    result.name = std::string(bench->full_name) + "@" + std::to_string(threads);
+    result.ns_per_op = total.operations ? best / (double)total.operations : 0.0;
+    result.mb_per_s =
+      total.bytes > 0 ? (double)total.bytes * 1000.0 / best : 0.0;
+    result.deviation = mean > 0 ? sqrt(variance) / mean * 100 : 0.0;
+    printf("%47s %4zu threads %10.2f Mops/s", "", threads, throughput);
+    if (total.bytes > 0) {
+      printf(" %10.2f MB/s", result.mb_per_s);
+    } else {
+      printf(" %15s", "");
+    }
+
+    printf(" %6.1f%% efficiency +-%5.2f%% (checksum %zu)\n",
+      base > 0 ? throughput / (base * (double)threads) * 100.0 : 0.0,
+      result.deviation, total.checksum % 1000);
+    fflush(stdout);
+
+    if (threads >= max_threads) {
+      break;
+    }
+
+    threads = threads * 2 < max_threads ? threads * 2 : max_threads;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  size_t i, count;
+  struct cwk_bench *bench;
+  struct cwk_bench_report report, baseline;
+  const char *env, *json, *baseline_file;
+  double tolerance;
+
+  // The third argument restricts the benchmarks which use the generated
+  // corpora to a single one of them.
+  if (argc > 3 && !cwk_bench_select_corpus(argv[3])) {
+    printf("No corpus named '%s'.\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+
+  // Hardware counters are opt-in, since reading them costs a few system calls
+  // per sample. If the machine or the container does not provide them, the
+  // benchmarks just run without.
+  env = getenv("CWK_BENCH_COUNTERS");
+  if (env != NULL && *env != '\0' && strcmp(env, "0") != 0) {
+    use_counters = cwk_bench_counters_open(&counters);
+    if (!use_counters) {
+      printf("Hardware counters are not available: %s\n", strerror(errno));
+    }
+  }
+
+  env = getenv("CWK_BENCH_LATENCY");
+  use_latency = env != NULL && *env != '\0' && strcmp(env, "0") != 0;
+
+  // The scaling goes up to the amount of cores, unless a higher amount of
+  // threads is given. It replaces the regular samples.
+  env = getenv("CWK_BENCH_SCALING");
+  if (env != NULL && *env != '\0') {
+    max_threads = strtoul(env, NULL, 10);
+    if (max_threads == 1 || (max_threads == 0 && strcmp(env, "0") != 0)) {
+      max_threads = std::thread::hardware_concurrency();
+      max_threads = max_threads > 0 ? max_threads : 1;
+    }
+  }
+
+  // The baseline is read before anything runs, so a typo in its name doesn't
+  // waste a whole run. It has to be recorded with the same corpus, since the
+  // results of different corpora can't be compared.
+  report.corpus = argc > 3 ? argv[3] : "";
+  baseline_file = getenv("CWK_BENCH_BASELINE");
+  if (baseline_file != NULL && *baseline_file != '\0') {
+    if (!cwk_bench_report_load(&baseline, baseline_file)) {
+      printf("Could not read the baseline '%s'.\n", baseline_file);
+      return EXIT_FAILURE;
+    }
+
+    if (baseline.corpus != report.corpus) {
+      printf("The baseline was recorded with %s%s%s.\n",
+        baseline.corpus.empty() ? "all corpora" : "the corpus '",
+        baseline.corpus.c_str(), baseline.corpus.empty() ? "" : "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  env = getenv("CWK_BENCH_TOLERANCE");
+  tolerance = env != NULL && *env != '\0' ? atof(env) / 100.0 : 0.05;
+
+  count = 0;
+  for (i = 0; i < CWK_ARRAY_SIZE(benches); ++i) {
+    bench = &benches[i];
+    if (argc > 1 && strcmp(bench->unit_name, argv[1]) != 0) {
+      continue;
+    }
+
+    if (argc > 2 && strcmp(bench->bench_name, argv[2]) != 0) {
+      continue;
+    }
+
+    ++count;
+    if (max_threads > 0) {
+      scale_bench(bench, &report);
+      continue;
+    }
+
+    report.results.emplace_back();
+    call_bench(bench, &report.results.back());
+  }
+
+  if (use_counters) {
+    cwk_bench_counters_close(&counters);
+  }
+
+  if (count == 0) {
+    printf("No benchmarks found.\n");
+    return EXIT_FAILURE;
+  }
+
+  json = getenv("CWK_BENCH_JSON");
+  if (json != NULL && *json != '\0' &&
+      !cwk_bench_report_save(&report, json)) {
+    printf("Could not write the results to '%s'.\n", json);
+    return EXIT_FAILURE;
+  }
+
+  if (baseline_file != NULL && *baseline_file != '\0' &&
+      !cwk_bench_report_compare(&baseline, &report, tolerance)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
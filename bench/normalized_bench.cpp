@@ -0,0 +1,50 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <stdio.h>
+#include <string.h>
+
+static const cwk_unix cwk_path;
+
+static const char *paths[][2] = {{"/usr/local/include", "../lib/cwalk.a"},
+  {"relative/path/with/", "../some/./special/segments/"},
+  {"/a/very/deep/path/which/has/quite/a/lot", "of/segments/in/it/to/iterate"},
+  {"single", "."}, {"//multiple///separators//", "between////segments/"}};
+
+void normalized_buffer(struct cwk_bench_run *run)
+{
+  char buffer[FILENAME_MAX];
+  struct cwk_segment segment;
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      // This is what the consumers currently do: normalize into a buffer and
+      // then iterate the segments of the result.
+      cwk_path.join(paths[j][0], paths[j][1], buffer, sizeof(buffer));
+      if (!cwk_path.get_first_segment(buffer, &segment)) {
+        continue;
+      }
+
+      do {
+        run->checksum += segment.size;
+      } while (cwk_path.get_next_segment(&segment));
+
+      ++run->operations;
+    }
+  }
+}
+
+void normalized_view(struct cwk_bench_run *run)
+{
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      for (auto segment : cwk_path.normalized_view(paths[j][0], paths[j][1])) {
+        run->checksum += segment.size();
+      }
+
+      ++run->operations;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#include "bench.h"
+#include <cwalk_open.h>
+#include <cwalk_walk.h>
+#include <string>
+#include <vector>
+
+static const cwk_unix cwk_path;
+
+static const std::vector<std::string> &get_paths()
+{
+  static std::vector<std::string> paths;
+
+  if (paths.empty()) {
+    cwk_walker(cwk_path, {1}).walk(cwk_bench_tree().c_str(),
+      [](const cwk_walk_entry &entry) {
+        if (entry.type == DT_REG) {
+          paths.push_back(entry.path);
+        }
+        return true;
+      });
+  }
+
+  return paths;
+}
+
+void open_absolute(struct cwk_bench_run *run)
+{
+  const std::vector<std::string> &paths = get_paths();
+  size_t i, j;
+  int fd;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < paths.size(); ++j) {
+      fd = open(paths[j].c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd >= 0) {
+        run->checksum += 1;
+        close(fd);
+      }
+
+      ++run->operations;
+    }
+  }
+}
+
+void open_cached(struct cwk_bench_run *run)
+{
+  const std::vector<std::string> &paths = get_paths();
+  static thread_local cwk_opener opener(cwk_path);
+  size_t i, j;
+  int fd;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < paths.size(); ++j) {
+      fd = opener.open(paths[j].c_str(), O_RDONLY);
+      if (fd >= 0) {
+        run->checksum += 1;
+        close(fd);
+      }
+
+      ++run->operations;
+    }
+  }
+}
@@ -0,0 +1,426 @@
+#include "report.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+
+/**
+ * A parsed JSON value. This only has to read the reports which are written
+ * below, but it accepts any JSON, so reports which were edited by hand or by
+ * other tools can be read as well.
+ */
+struct json_value
+{
+  enum
+  {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+  } type;
+  double number;
+  std::string string;
+  std::vector<json_value> items;
+  std::vector<std::pair<std::string, json_value>> members;
+
+  const json_value *get(const char *key) const
+  {
+    for (const auto &member : members) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+
+    return NULL;
+  }
+};
+
+static void write_string(FILE *f, const std::string &value)
+{
+  fputc('"', f);
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if ((unsigned char)c < 0x20) {
+      fprintf(f, "\\u%04x", (unsigned)c);
+    } else {
+      fputc(c, f);
+    }
+  }
+
+  fputc('"', f);
+}
+
+bool cwk_bench_report_save(
+  const struct cwk_bench_report *report, const char *file)
+{
+  size_t i, j;
+  FILE *f;
+
+  f = fopen(file, "w");
+  if (f == NULL) {
+    return false;
+  }
+
+  fputs("{\n  \"corpus\": ", f);
+  write_string(f, report->corpus);
+  fputs(",\n  \"benchmarks\": [", f);
+  for (i = 0; i < report->results.size(); ++i) {
+    const cwk_bench_result &result = report->results[i];
+    fputs(i > 0 ? ",\n    {\"name\": " : "\n    {\"name\": ", f);
+    write_string(f, result.name);
+    fprintf(f,
+      ", \"ns_per_op\": %.3f, \"mb_per_s\": %.3f, \"deviation\": %.3f",
+      result.ns_per_op, result.mb_per_s, result.deviation);
+    fputs(", \"classes\": [", f);
+    for (j = 0; j < result.classes.size(); ++j) {
+      const cwk_bench_class_result &c = result.classes[j];
+      fputs(j > 0 ? ",\n      {\"name\": " : "\n      {\"name\": ", f);
+      write_string(f, c.name);
+      fprintf(f,
+        ", \"calls\": %llu, \"p50\": %llu, \"p99\": %llu, \"p99.9\": %llu"
+        ", \"max\": %llu}",
+        (unsigned long long)c.calls, (unsigned long long)c.p50,
+        (unsigned long long)c.p99, (unsigned long long)c.p999,
+        (unsigned long long)c.max);
+    }
+
+    fputs("]}", f);
+  }
+
+  fputs("\n  ]\n}\n", f);
+  return fclose(f) == 0;
+}
+
+static void skip_space(const std::string &text, size_t *pos)
+{
+  while (*pos < text.size() && isspace((unsigned char)text[*pos])) {
+    ++*pos;
+  }
+}
+
+static bool parse_string(
+  const std::string &text, size_t *pos, std::string *value)
+{
+  unsigned code;
+
+  if (text[*pos] != '"') {
+    return false;
+  }
+
+  // Escaped characters beyond ASCII are not needed for the names of
+  // benchmarks, they are just replaced.
+  value->clear();
+  for (++*pos; *pos < text.size() && text[*pos] != '"'; ++*pos) {
+    if (text[*pos] != '\\') {
+      value->push_back(text[*pos]);
+      continue;
+    }
+
+    if (++*pos >= text.size()) {
+      return false;
+    }
+
+    switch (text[*pos]) {
+    case 'n':
+      value->push_back('\n');
+      break;
+    case 't':
+      value->push_back('\t');
+      break;
+    case 'r':
+      value->push_back('\r');
+      break;
+    case 'b':
+      value->push_back('\b');
+      break;
+    case 'f':
+      value->push_back('\f');
+      break;
+    case 'u':
+      if (*pos + 4 >= text.size() ||
+          sscanf(text.c_str() + *pos + 1, "%4x", &code) != 1) {
+        return false;
+      }
+
+      value->push_back(code < 0x80 ? (char)code : '?');
+      *pos += 4;
+      break;
+    default:
+      value->push_back(text[*pos]);
+      break;
+    }
+  }
+
+  if (*pos >= text.size()) {
+    return false;
+  }
+
+  ++*pos;
+  return true;
+}
+
+static bool parse_value(
+  const std::string &text, size_t *pos, json_value *value, int depth)
+{
+  const char *begin;
+  char *end;
+
+  skip_space(text, pos);
+  if (*pos >= text.size() || depth > 32) {
+    return false;
+  }
+
+  value->members.clear();
+  value->items.clear();
+  switch (text[*pos]) {
+  case '{':
+    value->type = json_value::JSON_OBJECT;
+    ++*pos;
+    skip_space(text, pos);
+    if (*pos < text.size() && text[*pos] == '}') {
+      ++*pos;
+      return true;
+    }
+
+    do {
+      std::pair<std::string, json_value> member;
+      skip_space(text, pos);
+      if (*pos >= text.size() || !parse_string(text, pos, &member.first)) {
+        return false;
+      }
+
+      skip_space(text, pos);
+      if (*pos >= text.size() || text[(*pos)++] != ':' ||
+          !parse_value(text, pos, &member.second, depth + 1)) {
+        return false;
+      }
+
+      value->members.push_back(std::move(member));
+      skip_space(text, pos);
+    } while (*pos < text.size() && text[*pos] == ',' && ++*pos);
+
+    return *pos < text.size() && text[(*pos)++] == '}';
+  case '[':
+    value->type = json_value::JSON_ARRAY;
+    ++*pos;
+    skip_space(text, pos);
+    if (*pos < text.size() && text[*pos] == ']') {
+      ++*pos;
+      return true;
+    }
+
+    do {
+      value->items.emplace_back();
+      if (!parse_value(text, pos, &value->items.back(), depth + 1)) {
+        return false;
+      }
+
+      skip_space(text, pos);
+    } while (*pos < text.size() && text[*pos] == ',' && ++*pos);
+
+    return *pos < text.size() && text[(*pos)++] == ']';
+  case '"':
+    value->type = json_value::JSON_STRING;
+    return parse_string(text, pos, &value->string);
+  default:
+    break;
+  }
+
+  begin = text.c_str() + *pos;
+  if (strncmp(begin, "true", 4) == 0 || strncmp(begin, "null", 4) == 0) {
+    value->type =
+      *begin == 't' ? json_value::JSON_BOOL : json_value::JSON_NULL;
+    value->number = *begin == 't';
+    *pos += 4;
+    return true;
+  } else if (strncmp(begin, "false", 5) == 0) {
+    value->type = json_value::JSON_BOOL;
+    value->number = 0;
+    *pos += 5;
+    return true;
+  }
+
+  value->type = json_value::JSON_NUMBER;
+  value->number = strtod(begin, &end);
+  if (end == begin) {
+    return false;
+  }
+
+  *pos += (size_t)(end - begin);
+  return true;
+}
+
+static double get_number(const json_value &object, const char *key)
+{
+  const json_value *value;
+
+  value = object.get(key);
+  return value != NULL && value->type == json_value::JSON_NUMBER
+           ? value->number
+           : 0.0;
+}
+
+bool cwk_bench_report_load(struct cwk_bench_report *report, const char *file)
+{
+  const json_value *corpus, *benchmarks, *name, *classes;
+  std::string text;
+  json_value root;
+  char chunk[65536];
+  size_t length, pos;
+  FILE *f;
+
+  report->corpus.clear();
+  report->results.clear();
+  f = fopen(file, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  while ((length = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    text.append(chunk, length);
+  }
+
+  fclose(f);
+  pos = 0;
+  if (!parse_value(text, &pos, &root, 0) ||
+      root.type != json_value::JSON_OBJECT) {
+    return false;
+  }
+
+  corpus = root.get("corpus");
+  benchmarks = root.get("benchmarks");
+  if (benchmarks == NULL || benchmarks->type != json_value::JSON_ARRAY) {
+    return false;
+  }
+
+  if (corpus != NULL && corpus->type == json_value::JSON_STRING) {
+    report->corpus = corpus->string;
+  }
+
+  for (const json_value &item : benchmarks->items) {
+    cwk_bench_result result;
+    name = item.get("name");
+    if (name == NULL || name->type != json_value::JSON_STRING) {
+      return false;
+    }
+
+    result.name = name->string;
+    result.ns_per_op = get_number(item, "ns_per_op");
+    result.mb_per_s = get_number(item, "mb_per_s");
+    result.deviation = get_number(item, "deviation");
+    classes = item.get("classes");
+    if (classes != NULL && classes->type == json_value::JSON_ARRAY) {
+      for (const json_value &c : classes->items) {
+        name = c.get("name");
+        if (name == NULL || name->type != json_value::JSON_STRING) {
+          return false;
+        }
+
+        result.classes.push_back({name->string,
+          (uint64_t)get_number(c, "calls"), (uint64_t)get_number(c, "p50"),
+          (uint64_t)get_number(c, "p99"), (uint64_t)get_number(c, "p99.9"),
+          (uint64_t)get_number(c, "max")});
+      }
+    }
+
+    report->results.push_back(std::move(result));
+  }
+
+  return true;
+}
+
+/**
+ * Prints a row of the table and returns whether it is a regression.
+ */
+static bool print_row(const std::string &name, const char *unit,
+  double baseline, double current, double tolerance)
+{
+  const char *status;
+  double change;
+
+  change = baseline > 0 ? current / baseline - 1.0 : 0.0;
+  if (change > tolerance) {
+    status = "slower";
+  } else if (change < -tolerance) {
+    status = "faster";
+  } else {
+    status = "";
+  }
+
+  printf(" %-45s %12.2f %-5s %12.2f %-5s %+8.2f%% %s\n", name.c_str(),
+    baseline, unit, current, unit, change * 100.0, status);
+  return change > tolerance;
+}
+
+bool cwk_bench_report_compare(const struct cwk_bench_report *baseline,
+  const struct cwk_bench_report *current, double tolerance)
+{
+  size_t regressions, compared, missing;
+  bool found;
+
+  printf("\n %-45s %18s %18s %9s\n", "Compared to baseline", "Baseline",
+    "Current", "Change");
+
+  // The benchmarks are compared by their time per operation, and the input
+  // classes by the median latency, since the tails are too noisy to fail a
+  // check on.
+  regressions = compared = 0;
+  for (const cwk_bench_result &result : current->results) {
+    for (const cwk_bench_result &base : baseline->results) {
+      if (base.name != result.name) {
+        continue;
+      }
+
+      ++compared;
+      regressions += print_row(result.name, "ns/op", base.ns_per_op,
+        result.ns_per_op, tolerance);
+      for (const cwk_bench_class_result &c : result.classes) {
+        for (const cwk_bench_class_result &b : base.classes) {
+          if (b.name == c.name) {
+            regressions += print_row("  " + c.name + " p50", "ns",
+              (double)b.p50, (double)c.p50, tolerance);
+          }
+        }
+      }
+    }
+  }
+
+  // Benchmarks of the baseline which did not run are listed, since a renamed
+  // or removed benchmark would otherwise drop out of the comparison silently.
+  missing = 0;
+  for (const cwk_bench_result &base : baseline->results) {
+    found = false;
+    for (const cwk_bench_result &result : current->results) {
+      found = found || result.name == base.name;
+    }
+
+    if (!found) {
+      printf(" %-45s %12.2f %-5s %18s\n", base.name.c_str(), base.ns_per_op,
+        "ns/op", "missing");
+      ++missing;
+    }
+  }
+
+  if (compared == 0) {
+    printf("\n None of the benchmarks are part of the baseline.\n");
+    return false;
+  }
+
+  if (missing > 0) {
+    printf("\n %zu benchmarks of the baseline did not run.\n", missing);
+  }
+
+  if (regressions > 0) {
+    printf("\n %zu results are more than %.1f%% slower than the baseline.\n",
+      regressions, tolerance * 100.0);
+  } else {
+    printf("\n No result is more than %.1f%% slower than the baseline.\n",
+      tolerance * 100.0);
+  }
+
+  return regressions == 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * The latencies of a single input class of a benchmark, in nanoseconds.
+ */
+struct cwk_bench_class_result
+{
+  std::string name;
+  uint64_t calls;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t max;
+};
+
+/**
+ * The result of a single benchmark. The throughput is zero for benchmarks
+ * which don't process paths, and the classes are only there if the latencies
+ * were recorded.
+ */
+struct cwk_bench_result
+{
+  std::string name;
+  double ns_per_op;
+  double mb_per_s;
+  double deviation;
+  std::vector<cwk_bench_class_result> classes;
+};
+
+/**
+ * The results of a whole run of the benchmark program. The corpus is empty if
+ * all corpora were used.
+ */
+struct cwk_bench_report
+{
+  std::string corpus;
+  std::vector<cwk_bench_result> results;
+};
+
+/**
+ * Writes the report as JSON. Returns false if the file could not be written.
+ */
+bool cwk_bench_report_save(
+  const struct cwk_bench_report *report, const char *file);
+
+/**
+ * Reads a report which was written by cwk_bench_report_save. Returns false if
+ * the file could not be read or is not a valid report.
+ */
+bool cwk_bench_report_load(struct cwk_bench_report *report, const char *file);
+
+/**
+ * Compares the results against a baseline and prints a table of the
+ * benchmarks and input classes which moved by more than the tolerance, which
+ * is a fraction like 0.05. Benchmarks of the baseline which did not run are
+ * listed, benchmarks which are only part of the current results are ignored.
+ * Returns false if anything got slower by more than the tolerance, or if no
+ * benchmark is part of both reports.
+ */
+bool cwk_bench_report_compare(const struct cwk_bench_report *baseline,
+  const struct cwk_bench_report *current, double tolerance);
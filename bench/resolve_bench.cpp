@@ -0,0 +1,87 @@
+#include "bench.h"
+#include <cwalk_resolve.h>
+#include <cwalk_walk.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const cwk_unix cwk_path;
+
+/**
+ * Every top level directory of the tree gets a link next to it, and half of
+ * the paths go through those links.
+ */
+static const std::vector<std::string> &get_paths()
+{
+  static std::vector<std::string> paths;
+  const std::string &root = cwk_bench_tree();
+  std::string link, target;
+  size_t i;
+
+  if (!paths.empty()) {
+    return paths;
+  }
+
+  for (i = 0; i < 10; ++i) {
+    target = std::to_string(i);
+    link = root + "/link_" + target;
+    if (access(link.c_str(), F_OK) != 0 &&
+        symlink(target.c_str(), link.c_str()) != 0) {
+      fprintf(stderr, "Could not create %s\n", link.c_str());
+    }
+  }
+
+  i = 0;
+  cwk_walker(cwk_path, {1}).walk(root.c_str(), [&](const cwk_walk_entry &e) {
+    if (strncmp(e.name, "link_", 5) == 0) {
+      return false;
+    }
+
+    if (e.type == DT_REG && i++ % 2 == 0) {
+      paths.push_back(root + "/link_" + std::string(e.path + root.size() + 1));
+    } else if (e.type == DT_REG) {
+      paths.push_back(e.path);
+    }
+
+    return true;
+  });
+
+  return paths;
+}
+
+void resolve_realpath(struct cwk_bench_run *run)
+{
+  const std::vector<std::string> &paths = get_paths();
+  char buffer[PATH_MAX];
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < paths.size(); ++j) {
+      if (realpath(paths[j].c_str(), buffer)) {
+        run->checksum += strlen(buffer);
+      }
+
+      ++run->operations;
+    }
+  }
+}
+
+void resolve_cached(struct cwk_bench_run *run)
+{
+  const std::vector<std::string> &paths = get_paths();
+  // The resolver is shared by all threads on purpose, its cache is meant to be
+  // used by many of them at once.
+  static cwk_resolver resolver(cwk_path);
+  char buffer[PATH_MAX];
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < paths.size(); ++j) {
+      run->checksum +=
+        resolver.resolve_real(paths[j].c_str(), buffer, sizeof(buffer));
+      ++run->operations;
+    }
+  }
+}
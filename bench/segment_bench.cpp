@@ -0,0 +1,92 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <string.h>
+
+static const cwk_unix cwk_path;
+
+static const char *paths[] = {"/usr/local/include/cwalk.h",
+  "relative/path/with/../some/./special/segments/",
+  "/a/very/deep/path/which/has/quite/a/lot/of/segments/in/it/to/iterate",
+  "single", "//multiple///separators//between////segments/"};
+
+void segment_loop(struct cwk_bench_run *run)
+{
+  struct cwk_segment segment;
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      if (!cwk_path.get_first_segment(paths[j], &segment)) {
+        continue;
+      }
+
+      do {
+        run->checksum += segment.size;
+        ++run->operations;
+      } while (cwk_path.get_next_segment(&segment));
+    }
+  }
+}
+
+void segment_range(struct cwk_bench_run *run)
+{
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      for (std::string_view segment : cwk_path.segments(paths[j])) {
+        run->checksum += segment.size();
+        ++run->operations;
+      }
+    }
+  }
+}
+
+void segment_reverse_loop(struct cwk_bench_run *run)
+{
+  struct cwk_segment segment;
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      if (!cwk_path.get_last_segment(paths[j], &segment)) {
+        continue;
+      }
+
+      do {
+        run->checksum += segment.size;
+        ++run->operations;
+      } while (cwk_path.get_previous_segment(&segment));
+    }
+  }
+}
+
+void segment_reverse_range(struct cwk_bench_run *run)
+{
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      auto range = cwk_path.segments(paths[j]);
+      auto it = range.end_iterator();
+      while (it != range.begin()) {
+        run->checksum += (*--it).size();
+        ++run->operations;
+      }
+    }
+  }
+}
+
+void segment_visible_range(struct cwk_bench_run *run)
+{
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+      for (std::string_view segment : cwk_path.visible_segments(paths[j])) {
+        run->checksum += segment.size();
+        ++run->operations;
+      }
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#include "bench.h"
+#include <cwalk_stat.h>
+#include <cwalk_walk.h>
+#include <string>
+#include <vector>
+
+static const cwk_unix cwk_path;
+
+static const std::vector<const char *> &get_paths()
+{
+  static std::vector<std::string> storage;
+  static std::vector<const char *> paths;
+
+  if (!paths.empty()) {
+    return paths;
+  }
+
+  cwk_walker(cwk_path, {1}).walk(cwk_bench_tree().c_str(),
+    [](const cwk_walk_entry &entry) {
+      storage.push_back(entry.path);
+      return true;
+    });
+
+  for (const std::string &path : storage) {
+    paths.push_back(path.c_str());
+  }
+
+  return paths;
+}
+
+void stat_sync(struct cwk_bench_run *run)
+{
+  const std::vector<const char *> &paths = get_paths();
+  struct statx st;
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (j = 0; j < paths.size(); ++j) {
+      if (statx(AT_FDCWD, paths[j], AT_SYMLINK_NOFOLLOW, STATX_BASIC_STATS,
+            &st) == 0) {
+        run->checksum += st.stx_size;
+      }
+
+      ++run->operations;
+    }
+  }
+}
+
+void stat_batch(struct cwk_bench_run *run)
+{
+  const std::vector<const char *> &paths = get_paths();
+  static thread_local cwk_stat_batch batch;
+  cwk_stat_table table;
+  size_t i, j;
+
+  for (i = 0; i < run->iterations; ++i) {
+    batch.fetch(paths.data(), paths.size(), &table);
+    for (j = 0; j < table.count(); ++j) {
+      run->checksum += table.size[j];
+    }
+
+    run->operations += paths.size();
+  }
+}
@@ -0,0 +1,100 @@
+#include "bench.h"
+#include <cwalk.h>
+#include <cwalk_trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ * The buffer size for the results, which has to hold the longest paths of the
+ * corpora.
+ */
+#define TRACE_BUFFER_SIZE 16384
+
+static thread_local char buffer[TRACE_BUFFER_SIZE];
+
+/**
+ * The names of the operations, which are the input classes of the latencies.
+ */
+static const char *operation_names[CWK_TRACE_OPERATIONS] = {"get_absolute",
+  "get_relative", "join", "join_multiple", "get_root", "change_root",
+  "is_absolute", "is_relative", "get_basename", "change_basename",
+  "get_dirname", "get_extension", "has_extension", "change_extension",
+  "normalize", "get_intersection", "guess_style"};
+
+static void add_record(std::vector<cwk_trace_record> *records,
+  cwk_trace_operation operation, const cwk_bench_corpus &corpus,
+  std::vector<std::string> paths)
+{
+  records->push_back({operation, corpus.style, TRACE_BUFFER_SIZE, paths});
+}
+
+/**
+ * Makes up a call mix from the corpora, which is used if there is no captured
+ * trace. Every path is normalized, joined, related to the next one and taken
+ * apart, which is roughly what a program does with the paths it gets.
+ */
+static void make_records(std::vector<cwk_trace_record> *records)
+{
+  size_t i;
+
+  for (const cwk_bench_corpus &corpus : cwk_bench_corpora()) {
+    for (i = 0; i < corpus.paths.size(); ++i) {
+      const std::string &path = corpus.paths[i];
+      const std::string &next = corpus.paths[(i + 1) % corpus.paths.size()];
+      add_record(records, CWK_TRACE_IS_ABSOLUTE, corpus, {path});
+      add_record(records, CWK_TRACE_NORMALIZE, corpus, {path});
+      add_record(records, CWK_TRACE_JOIN, corpus, {path, "file.txt"});
+      add_record(records, CWK_TRACE_GET_RELATIVE, corpus, {path, next});
+      add_record(records, CWK_TRACE_GET_BASENAME, corpus, {path});
+      add_record(records, CWK_TRACE_GET_EXTENSION, corpus, {path});
+    }
+  }
+}
+
+static const std::vector<cwk_trace_record> &trace_records()
+{
+  static std::vector<cwk_trace_record> records;
+  static bool prepared;
+  const char *file;
+  cwk_trace trace;
+
+  if (prepared) {
+    return records;
+  }
+
+  // A captured trace replaces the made up calls entirely. It is replayed with
+  // the buffer sizes of the program which recorded it, as long as they are
+  // not larger than the buffer of the benchmark.
+  prepared = true;
+  file = getenv("CWK_BENCH_TRACE");
+  if (file == NULL || *file == '\0') {
+    make_records(&records);
+  } else if (trace.load(file)) {
+    records = trace.get_records();
+  } else {
+    fprintf(stderr, "\nCould not load the trace '%s'.\n", file);
+    exit(EXIT_FAILURE);
+  }
+
+  return records;
+}
+
+void trace_replay(struct cwk_bench_run *run)
+{
+  const std::vector<cwk_trace_record> &records = trace_records();
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (const cwk_trace_record &record : records) {
+      cwk_bench_call(run, operation_names[record.operation], [&]() {
+        run->checksum += cwk_trace::replay(record, buffer, sizeof(buffer));
+      });
+      for (const std::string &path : record.paths) {
+        run->bytes += path.size();
+      }
+
+      ++run->operations;
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#include "bench.h"
+#include <cwalk_tree.h>
+#include <cwalk_walk.h>
+
+static const cwk_unix cwk_path;
+
+void tree_poll(struct cwk_bench_run *run)
+{
+  cwk_walker walker(cwk_path, {1});
+  size_t i;
+
+  // This is the polling walk which the index replaces, every poll reads the
+  // whole tree again.
+  for (i = 0; i < run->iterations; ++i) {
+    walker.walk(cwk_bench_tree().c_str(), [&](const cwk_walk_entry &entry) {
+      run->checksum += entry.path_length;
+      return true;
+    });
+
+    ++run->operations;
+  }
+}
+
+void tree_query(struct cwk_bench_run *run)
+{
+  static thread_local cwk_tree_index<cwk_unix> index(cwk_path);
+  size_t i;
+
+  if (index.fd() < 0) {
+    index.open(cwk_bench_tree().c_str());
+  }
+
+  for (i = 0; i < run->iterations; ++i) {
+    index.update(0);
+    index.list(cwk_bench_tree().c_str(),
+      [&](std::string_view path, unsigned char) {
+        run->checksum += path.size();
+      });
+
+    ++run->operations;
+  }
+}
@@ -0,0 +1,124 @@
+#include "bench.h"
+#include <cwalk_walk.h>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const cwk_unix cwk_path;
+
+/**
+ * The tree is generated once and then reused by all benchmarks and all later
+ * runs. The amount of files can be changed with CWK_BENCH_WALK_FILES, they are
+ * distributed over three levels of ten directories each.
+ */
+const std::string &cwk_bench_tree()
+{
+  static std::string root;
+  std::string directory, path;
+  const char *env;
+  size_t i, files;
+  FILE *file;
+
+  if (!root.empty()) {
+    return root;
+  }
+
+  env = getenv("CWK_BENCH_WALK_FILES");
+  files = env ? strtoul(env, NULL, 10) : 20000;
+  env = getenv("TMPDIR");
+  root = std::string(env ? env : "/tmp") + "/cwalkbench_tree_" +
+         std::to_string(files);
+  if (access((root + "/done").c_str(), F_OK) == 0) {
+    return root;
+  }
+
+  fprintf(stderr, "Generating %zu files in %s\n", files, root.c_str());
+  for (i = 0; i < files; ++i) {
+    directory = root + "/" + std::to_string(i % 10) + "/" +
+                std::to_string(i / 10 % 10) + "/" +
+                std::to_string(i / 100 % 10);
+    if (i < 1000) {
+      std::filesystem::create_directories(directory);
+    }
+
+    path = directory + "/file_" + std::to_string(i) + ".txt";
+    file = fopen(path.c_str(), "w");
+    if (file) {
+      fclose(file);
+    }
+  }
+
+  file = fopen((root + "/done").c_str(), "w");
+  if (file) {
+    fclose(file);
+  }
+
+  return root;
+}
+
+void walk_std_filesystem(struct cwk_bench_run *run)
+{
+  const std::string &root = cwk_bench_tree();
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    for (const auto &entry :
+      std::filesystem::recursive_directory_iterator(root)) {
+      run->checksum += entry.path().native().size();
+      ++run->operations;
+    }
+  }
+}
+
+void walk_single_thread(struct cwk_bench_run *run)
+{
+  const std::string &root = cwk_bench_tree();
+  cwk_walk_result result;
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    result = cwk_walker(cwk_path, {1}).walk(
+      root.c_str(), [run](const cwk_walk_entry &entry) {
+        run->checksum += entry.path_length;
+        return true;
+      });
+    run->operations += result.entries;
+  }
+}
+
+void walk_parallel(struct cwk_bench_run *run)
+{
+  const std::string &root = cwk_bench_tree();
+  std::atomic<size_t> checksum;
+  cwk_walk_result result;
+  size_t i;
+
+  checksum = 0;
+  run->parallel = true;
+  for (i = 0; i < run->iterations; ++i) {
+    result = cwk_walker(cwk_path, {run->threads}).walk(
+      root.c_str(), [&checksum](const cwk_walk_entry &entry) {
+        checksum.fetch_add(entry.path_length, std::memory_order_relaxed);
+        return true;
+      });
+    run->operations += result.entries;
+  }
+
+  run->checksum += checksum;
+}
+
+void walk_lazy(struct cwk_bench_run *run)
+{
+  const std::string &root = cwk_bench_tree();
+  size_t i;
+
+  for (i = 0; i < run->iterations; ++i) {
+    auto walk = cwk_walker(cwk_path).lazy_walk(root.c_str());
+    for (const cwk_walk_entry &entry : walk) {
+      run->checksum += entry.path_length;
+      ++run->operations;
+    }
+  }
+}
@@ -13,3 +13,13 @@ function(create_test list_name unit_name test_name)
   set(TEST_LIST_CONTENT_${list_name} "${TEST_LIST_CONTENT_${list_name}}  XX(${unit_name},${test_name}) \\\n" PARENT_SCOPE)
   add_test(NAME "${unit_name}_${test_name}" COMMAND ${TEST_LIST_TARGET_${list_name}} ${unit_name} ${test_name})
 endfunction()
+
+function(write_bench_file list_name file)
+  file(WRITE ${file} "#define BENCHMARKS(XX) \\\n")
+  file(APPEND ${file} ${TEST_LIST_CONTENT_${list_name}})
+  file(APPEND ${file} "\n")
+endfunction()
+
+function(create_bench list_name unit_name bench_name)
+  set(TEST_LIST_CONTENT_${list_name} "${TEST_LIST_CONTENT_${list_name}}  XX(${unit_name},${bench_name}) \\\n" PARENT_SCOPE)
+endfunction()
@@ -1,10 +1,40 @@
 #pragma once
 
 #include <assert.h>
+#include <bit>
 #include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <iterator>
+#include <ranges>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * The segment index uses SSE2 to find separators if it is available. This is
+ * part of every x86-64 target, other targets will use the scalar fallback.
+ */
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CWK_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * The amount of segments whose visibility is determined in a single pass and
+ * kept inline, which has to be a multiple of 64. Every 64 segments take eight
+ * bytes. Beyond that, the visibility is determined for 64 segments at a time
+ * while walking over them, which takes another pass over the paths each time.
+ */
+#ifndef CWK_VISIBILITY_SEGMENTS
+#define CWK_VISIBILITY_SEGMENTS 4096
+#endif
 
 /**
  * A segment represents a single component of a path. For instance, on linux a
@@ -35,6 +65,37 @@ enum cwk_segment_type
   CWK_BACK
 };
 
+/**
+ * An index entry describes a single segment of an indexed path. The position
+ * is stored as an offset from the beginning of the path. The depth is the
+ * amount of normal segments which are visible after this segment has been
+ * processed, and the removed flag is set if normalization drops the segment.
+ */
+struct cwk_segment_index_entry
+{
+  size_t begin;
+  size_t size;
+  size_t depth;
+  enum cwk_segment_type type;
+  bool removed;
+};
+
+/**
+ * A segment index is a structural index of a path, similar to a list of
+ * segments which has already been iterated. The entries are provided by the
+ * caller, the library will never allocate memory for them.
+ */
+struct cwk_segment_index
+{
+  const char *path;
+  size_t length;
+  size_t root_length;
+  bool absolute;
+  struct cwk_segment_index_entry *entries;
+  size_t capacity;
+  size_t count;
+};
+
 /**
  * @brief Determines the style which is used for the path parsing and
  * generation.
@@ -70,6 +131,10 @@ struct cwk_dynamic
    * CWK_STYLE_WINDOWS: Use backslashes as a separator and volume for the root.
    * CWK_STYLE_UNIX: Use slashes as a separator and a slash for the root.
    *
+   * The style is stored in the instance, so it must not be changed while other
+   * threads use the same instance. Threads which need different styles should
+   * each have an instance of their own.
+   *
    * @param style The style which will be used from now on.
    */
   void set_style(cwk_path_style style) noexcept
@@ -86,6 +151,303 @@ template <cwk_path_style T_PATH_STYLE> struct cwk_static
   static inline constexpr cwk_path_style path_style{T_PATH_STYLE};
 };
 
+/**
+ * The operations which are recorded in a trace. The values are stored in the
+ * trace files, so new operations must be added at the end.
+ */
+enum cwk_trace_operation
+{
+  CWK_TRACE_GET_ABSOLUTE,
+  CWK_TRACE_GET_RELATIVE,
+  CWK_TRACE_JOIN,
+  CWK_TRACE_JOIN_MULTIPLE,
+  CWK_TRACE_GET_ROOT,
+  CWK_TRACE_CHANGE_ROOT,
+  CWK_TRACE_IS_ABSOLUTE,
+  CWK_TRACE_IS_RELATIVE,
+  CWK_TRACE_GET_BASENAME,
+  CWK_TRACE_CHANGE_BASENAME,
+  CWK_TRACE_GET_DIRNAME,
+  CWK_TRACE_GET_EXTENSION,
+  CWK_TRACE_HAS_EXTENSION,
+  CWK_TRACE_CHANGE_EXTENSION,
+  CWK_TRACE_NORMALIZE,
+  CWK_TRACE_GET_INTERSECTION,
+  CWK_TRACE_GUESS_STYLE,
+  CWK_TRACE_OPERATIONS
+};
+
+/**
+ * Call tracing records every call of the path functions together with the
+ * style and the inputs, so the real call mix of an application can be
+ * replayed with cwalk_trace.h. It is only compiled in if CWK_TRACE is defined,
+ * which has to be the same for every translation unit. The trace is written to
+ * the file in the CWK_TRACE_FILE environment variable, or to the one passed to
+ * cwk_trace_open.
+ *
+ * The file starts with the magic "CWKTRAC1", followed by the calls. Every call
+ * stores the operation, the style, the buffer size and the amount of paths as
+ * variable length integers, followed by the length and the characters of
+ * every path. Calls which the path functions make internally are not
+ * recorded.
+ */
+#ifdef CWK_TRACE
+
+#include <atomic>
+#include <initializer_list>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct cwk_trace_file
+{
+  std::mutex mutex;
+  std::atomic<FILE *> file;
+
+  cwk_trace_file() noexcept : file{NULL}
+  {
+    const char *path;
+
+    path = getenv("CWK_TRACE_FILE");
+    if (path != NULL && *path != '\0') {
+      file = open(path);
+    }
+  }
+
+  ~cwk_trace_file()
+  {
+    close();
+  }
+
+  static FILE *open(const char *path) noexcept
+  {
+    FILE *f;
+
+    f = fopen(path, "wb");
+    if (f != NULL && fwrite("CWKTRAC1", 1, 8, f) != 8) {
+      fclose(f);
+      f = NULL;
+    }
+
+    return f;
+  }
+
+  bool close() noexcept
+  {
+    FILE *f;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    f = file.exchange(NULL);
+    return f == NULL || fclose(f) == 0;
+  }
+};
+
+inline cwk_trace_file &cwk_trace_get_file() noexcept
+{
+  static cwk_trace_file file;
+  return file;
+}
+
+/**
+ * @brief Starts to write the trace to a file.
+ *
+ * A trace which is currently written is closed first.
+ *
+ * @param path The path of the file which will be written.
+ * @return Returns true if the file could be created or false otherwise.
+ */
+inline bool cwk_trace_open(const char *path) noexcept
+{
+  cwk_trace_file &trace = cwk_trace_get_file();
+  FILE *f;
+
+  trace.close();
+  f = cwk_trace_file::open(path);
+  if (f == NULL) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(trace.mutex);
+  trace.file = f;
+  return true;
+}
+
+/**
+ * @brief Stops tracing and closes the trace file.
+ *
+ * @return Returns true if all calls were written or false otherwise.
+ */
+inline bool cwk_trace_close() noexcept
+{
+  return cwk_trace_get_file().close();
+}
+
+/**
+ * A trace scope records a call when it is created. The depth tells whether
+ * the call comes from the outside or from another path function.
+ */
+class cwk_trace_scope
+{
+public:
+  cwk_trace_scope(cwk_trace_operation operation, cwk_path_style style,
+    size_t buffer_size, std::initializer_list<const char *> paths) noexcept
+  {
+    if (depth()++ == 0) {
+      record(operation, style, buffer_size, paths.begin(), paths.size());
+    }
+  }
+
+  cwk_trace_scope(cwk_trace_operation operation, cwk_path_style style,
+    size_t buffer_size, const char **paths) noexcept
+  {
+    size_t count;
+
+    if (depth()++ == 0) {
+      for (count = 0; paths[count] != NULL; ++count) {
+      }
+
+      record(operation, style, buffer_size, paths, count);
+    }
+  }
+
+  ~cwk_trace_scope()
+  {
+    --depth();
+  }
+
+  cwk_trace_scope(const cwk_trace_scope &) = delete;
+  cwk_trace_scope &operator=(const cwk_trace_scope &) = delete;
+
+private:
+  static size_t &depth() noexcept
+  {
+    static thread_local size_t value;
+    return value;
+  }
+
+  static size_t put_number(char *buffer, size_t pos, uint64_t value) noexcept
+  {
+    while (value >= 0x80) {
+      buffer[pos++] = (char)(value | 0x80);
+      value >>= 7;
+    }
+
+    buffer[pos++] = (char)value;
+    return pos;
+  }
+
+  static void record(cwk_trace_operation operation, cwk_path_style style,
+    size_t buffer_size, const char *const *paths, size_t count) noexcept
+  {
+    cwk_trace_file &trace = cwk_trace_get_file();
+    char header[64];
+    size_t i, pos, length;
+
+    // Most of the time nothing is traced, which is checked without taking
+    // the lock. The file is checked again once the lock is held, since it
+    // might have been closed in the meantime.
+    if (trace.file.load(std::memory_order_relaxed) == NULL) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(trace.mutex);
+    if (trace.file == NULL) {
+      return;
+    }
+
+    pos = put_number(header, 0, (uint64_t)operation);
+    pos = put_number(header, pos, (uint64_t)style);
+    pos = put_number(header, pos, buffer_size);
+    pos = put_number(header, pos, count);
+    fwrite(header, 1, pos, trace.file);
+    for (i = 0; i < count; ++i) {
+      length = strlen(paths[i]);
+      pos = put_number(header, 0, length);
+      fwrite(header, 1, pos, trace.file);
+      fwrite(paths[i], 1, length, trace.file);
+    }
+  }
+};
+
+#define CWK_TRACE_CALL(operation, ...)                                         \
+  const cwk_trace_scope cwk_trace_scope_(operation, get_style(), __VA_ARGS__)
+
+#else
+
+#define CWK_TRACE_CALL(operation, ...)
+
+#endif
+
+/**
+ * Operation counters tell where the path functions spend their work, so it can
+ * be attributed to the kind of paths an application uses without a profiler.
+ * They are only compiled in if CWK_STATS is defined, which has to be the same
+ * for every translation unit. Otherwise counting compiles to nothing.
+ *
+ * Every thread counts on its own, so counting needs no synchronization. The
+ * counters are read with cwk_stats_snapshot and cleared with cwk_stats_reset,
+ * both only see the counters of the calling thread.
+ */
+#ifdef CWK_STATS
+
+struct cwk_stats
+{
+  // The segments which were found while iterating or indexing paths.
+  uint64_t segments;
+  // The characters which were looked at to find those segments.
+  uint64_t bytes_scanned;
+  // The characters which were written to output buffers.
+  uint64_t bytes_written;
+  // The writes which did not fit into the output buffer.
+  uint64_t truncations;
+  // The passes over joined paths which determine which of their segments are
+  // removed by back segments.
+  uint64_t removal_scans;
+  // The roots which were parsed.
+  uint64_t root_parses;
+};
+
+inline cwk_stats &cwk_stats_local() noexcept
+{
+  static thread_local cwk_stats stats;
+  return stats;
+}
+
+/**
+ * @brief Returns the counters of the calling thread.
+ *
+ * @return Returns everything which was counted since the thread started or
+ * since the last reset.
+ */
+inline cwk_stats cwk_stats_snapshot() noexcept
+{
+  return cwk_stats_local();
+}
+
+/**
+ * @brief Clears the counters of the calling thread.
+ */
+inline void cwk_stats_reset() noexcept
+{
+  cwk_stats_local() = {};
+}
+
+#define CWK_STATS_ADD(counter, amount)                                         \
+  (void)(cwk_stats_local().counter += (uint64_t)(amount))
+
+#else
+
+#define CWK_STATS_ADD(counter, amount) (void)0
+
+#endif
+
+template <typename T_IMPL> class cwk_segment_range;
+template <typename T_IMPL, bool T_VISIBLE> class cwk_joined_segment_range;
+template <typename T_IMPL, size_t T_COUNT> class cwk_normalized_view;
+template <typename T_IMPL, size_t T_COUNT> class cwk_path_expression;
+template <typename T_IMPL> class cwk_path_builder;
+template <typename T_IMPL> class cwk_visibility;
+
 template <typename T_BASE> struct cwk_impl : T_BASE
 {
   using T_BASE::T_BASE;
@@ -112,6 +474,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t get_absolute(const char *base, const char *path, char *buffer,
     size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_ABSOLUTE, buffer_size, {base, path});
+
     size_t i;
     const char *paths[4];
 
@@ -166,6 +530,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t get_relative(const char *base_directory, const char *path,
     char *buffer, size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_RELATIVE, buffer_size, {base_directory, path});
+
     size_t pos, base_root_length, path_root_length;
     bool absolute, base_available, other_available, has_output;
     const char *base_paths[2], *other_paths[2];
@@ -190,13 +556,15 @@ template <typename T_BASE> struct cwk_impl : T_BASE
 
     // Initialize our joined segments. This will allow us to use the internal
     // functions to skip until diverge and invisible. We only have one path in
-    // them though.
+    // them though. Which segments are visible is determined once upfront.
     base_paths[0] = base_directory;
     base_paths[1] = NULL;
     other_paths[0] = path;
     other_paths[1] = NULL;
-    get_first_segment_joined(base_paths, &bsj);
-    get_first_segment_joined(other_paths, &osj);
+    cwk_visibility<cwk_impl> base_visibility(*this, base_paths, absolute);
+    cwk_visibility<cwk_impl> other_visibility(*this, other_paths, absolute);
+    get_first_segment_joined(base_paths, &bsj, &base_visibility);
+    get_first_segment_joined(other_paths, &osj, &other_visibility);
 
     // Okay, now we skip until the segments diverge. We don't have anything to
     // do with the segments which are equal.
@@ -290,6 +658,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t join(const char *path_a, const char *path_b, char *buffer,
     size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_JOIN, buffer_size, {path_a, path_b});
+
     const char *paths[3];
 
     // This is simple. We will just create an array with the two paths which we
@@ -324,6 +694,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t join_multiple(
     const char **paths, char *buffer, size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_JOIN_MULTIPLE, buffer_size, paths);
+
     // We can just call the internal join and normalize function for this one,
     // since it will handle everything.
     return join_and_normalize_multiple(paths, buffer, buffer_size);
@@ -341,6 +713,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   void get_root(const char *path, size_t *length) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_ROOT, 0, {path});
+
     // We use a different implementation here based on the configuration of the
     // library.
     if (path_style == CWK_STYLE_WINDOWS) {
@@ -370,6 +744,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t change_root(const char *path, const char *new_root, char *buffer,
     size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_CHANGE_ROOT, buffer_size, {path, new_root});
+
     const char *tail;
     size_t root_length, path_length, tail_length, new_root_length,
       new_path_size;
@@ -412,6 +788,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   bool is_absolute(const char *path) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_IS_ABSOLUTE, 0, {path});
+
     size_t length;
 
     // We grab the root of the path. This root does not include the first
@@ -433,6 +811,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   bool is_relative(const char *path) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_IS_RELATIVE, 0, {path});
+
     // The path is relative if it is not absolute.
     return !is_absolute(path);
   }
@@ -454,6 +834,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   void get_basename(
     const char *path, const char **basename, size_t *length) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_BASENAME, 0, {path});
+
     struct cwk_segment segment;
 
     // We get the last segment of the path. The last segment will contain the
@@ -493,6 +875,9 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t change_basename(const char *path, const char *new_basename,
     char *buffer, size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(
+      CWK_TRACE_CHANGE_BASENAME, buffer_size, {path, new_basename});
+
     struct cwk_segment segment;
     size_t pos, root_size, new_basename_size;
 
@@ -552,6 +937,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   void get_dirname(const char *path, size_t *length) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_DIRNAME, 0, {path});
+
     struct cwk_segment segment;
 
     // We get the last segment of the path. The last segment will contain the
@@ -585,6 +972,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   bool get_extension(
     const char *path, const char **extension, size_t *length) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_EXTENSION, 0, {path});
+
     struct cwk_segment segment;
     const char *c;
 
@@ -621,6 +1010,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   bool has_extension(const char *path) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_HAS_EXTENSION, 0, {path});
+
     const char *extension;
     size_t length;
 
@@ -652,6 +1043,9 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t change_extension(const char *path, const char *new_extension,
     char *buffer, size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(
+      CWK_TRACE_CHANGE_EXTENSION, buffer_size, {path, new_extension});
+
     struct cwk_segment segment;
     const char *c, *old_extension;
     size_t pos, root_size, trail_size, new_extension_size;
@@ -745,6 +1139,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t normalize(
     const char *path, char *buffer, size_t buffer_size) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_NORMALIZE, buffer_size, {path});
+
     const char *paths[2];
 
     // Now we initialize the paths which we will normalize. Since this function
@@ -769,6 +1165,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
   size_t get_intersection(
     const char *path_base, const char *path_other) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GET_INTERSECTION, 0, {path_base, path_other});
+
     bool absolute;
     size_t base_root_length, other_root_length;
     const char *end;
@@ -790,13 +1188,6 @@ template <typename T_BASE> struct cwk_impl : T_BASE
     paths_other[0] = path_other;
     paths_other[1] = NULL;
 
-    // So we get the first segment of both paths. If one of those paths don't
-    // have any segment, we will return 0.
-    if (!get_first_segment_joined(paths_base, &base) ||
-        !get_first_segment_joined(paths_other, &other)) {
-      return base_root_length;
-    }
-
     // We now determine whether the path is absolute or not. This is required
     // because if will ignore removed segments, and this behaves differently if
     // the path is absolute. However, we only need to check the base path
@@ -804,6 +1195,16 @@ template <typename T_BASE> struct cwk_impl : T_BASE
     // absolute.
     absolute = is_root_absolute(path_base, base_root_length);
 
+    // So we get the first segment of both paths. If one of those paths don't
+    // have any segment, we will return 0. Which segments are visible is
+    // determined once upfront.
+    cwk_visibility<cwk_impl> base_visibility(*this, paths_base, absolute);
+    cwk_visibility<cwk_impl> other_visibility(*this, paths_other, absolute);
+    if (!get_first_segment_joined(paths_base, &base, &base_visibility) ||
+        !get_first_segment_joined(paths_other, &other, &other_visibility)) {
+      return base_root_length;
+    }
+
     // We must keep track of the end of the previous segment. Initially, this is
     // set to the beginning of the path. This means that 0 is returned if the
     // first segment is not equal.
@@ -819,7 +1220,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
         break;
       }
 
-      if (!is_string_equal(
+      if (base.segment.size != other.segment.size ||
+          !is_string_equal(
             base.segment.begin, other.segment.begin, base.segment.size)) {
         // So the content of those two segments are not equal. We will return
         // the size up to the beginning.
@@ -925,6 +1327,7 @@ template <typename T_BASE> struct cwk_impl : T_BASE
 
     // If the string ends here, we can safely assume that there is no other
     // segment after this one.
+    CWK_STATS_ADD(bytes_scanned, c - (segment->begin + segment->size));
     if (*c == '\0') {
       return false;
     }
@@ -938,6 +1341,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
     c = find_next_stop(c);
     segment->end = c;
     segment->size = (size_t)(c - segment->begin);
+    CWK_STATS_ADD(segments, 1);
+    CWK_STATS_ADD(bytes_scanned, segment->size);
 
     // Tell the caller that we found a segment.
     return true;
@@ -980,9 +1385,12 @@ template <typename T_BASE> struct cwk_impl : T_BASE
     // We are guaranteed now that there is another segment, since we moved
     // before the previous separator and did not reach the segment path
     // beginning.
+    CWK_STATS_ADD(bytes_scanned, segment->begin - c);
     segment->end = c + 1;
     segment->begin = find_previous_stop(segment->segments, c);
     segment->size = (size_t)(segment->end - segment->begin);
+    CWK_STATS_ADD(segments, 1);
+    CWK_STATS_ADD(bytes_scanned, segment->size - 1);
 
     return true;
   }
@@ -1012,6 +1420,263 @@ template <typename T_BASE> struct cwk_impl : T_BASE
     return CWK_NORMAL;
   }
 
+  /**
+   * @brief Builds a structural index of all segments of a path.
+   *
+   * This function scans the path once, finds all separators and writes an
+   * entry for every segment to the entries of the submitted index. The
+   * entries and the capacity of the index must be set by the caller. Every
+   * entry contains the type of the segment and whether it would be removed by
+   * normalization, so the segments do not have to be parsed again. If the
+   * capacity is not large enough, only the first entries are written and the
+   * removed flags are not determined.
+   *
+   * @param path The path which will be indexed.
+   * @param index The index which will receive the segments.
+   * @return Returns the total amount of segments of the path.
+   */
+  size_t get_segment_index(
+    const char *path, struct cwk_segment_index *index) const noexcept
+  {
+    uint64_t mask;
+    size_t pos, block_size, segment_begin, separator, depth;
+
+    // First we determine the root, which is not part of any segment, and the
+    // length of the path. Knowing the length allows us to scan whole blocks
+    // without checking for the '\0' on every character.
+    get_root(path, &index->root_length);
+    index->path = path;
+    index->length = strlen(path);
+    CWK_STATS_ADD(bytes_scanned, index->length - index->root_length);
+    index->absolute = is_root_absolute(path, index->root_length);
+    index->count = 0;
+
+    // Now we scan the path in blocks of 64 characters. Every block results in
+    // a bit mask of separators, so we only have to look at the positions of
+    // the separators instead of every single character.
+    depth = 0;
+    segment_begin = index->root_length;
+    for (pos = index->root_length; pos < index->length; pos += block_size) {
+      block_size = index->length - pos;
+      if (block_size > 64) {
+        block_size = 64;
+      }
+
+      mask = get_separator_mask(path + pos, block_size);
+      while (mask) {
+        // Every separator ends the current segment. There might not be a
+        // segment if there are multiple separators next to each other.
+        separator = pos + (size_t)std::countr_zero(mask);
+        if (separator > segment_begin) {
+          index_segment(index, segment_begin, separator, &depth);
+        }
+
+        segment_begin = separator + 1;
+        mask &= mask - 1;
+      }
+    }
+
+    // The path might end without a separator, in which case we still have to
+    // add the last segment.
+    if (index->length > segment_begin) {
+      index_segment(index, segment_begin, index->length, &depth);
+    }
+
+    // Finally we determine which normal segments will be removed. We can only
+    // do this if we have all entries available.
+    if (index->count <= index->capacity) {
+      index_mark_removed(index);
+    }
+
+    return index->count;
+  }
+
+  /**
+   * @brief Gets a segment from a segment index.
+   *
+   * This function converts an entry of a segment index to a segment, which can
+   * then be used with all the other segment functions.
+   *
+   * @param index The index which contains the segment.
+   * @param entry The position of the entry within the index.
+   * @param segment The segment which will be written.
+   * @return Returns true if the entry is available or false otherwise.
+   */
+  bool get_indexed_segment(const struct cwk_segment_index *index, size_t entry,
+    struct cwk_segment *segment) const noexcept
+  {
+    // The entry might not be available if it is out of range or if it has not
+    // been written because the capacity was too small.
+    if (entry >= index->count || entry >= index->capacity) {
+      return false;
+    }
+
+    segment->path = index->path;
+    segment->segments = index->path + index->root_length;
+    segment->begin = index->path + index->entries[entry].begin;
+    segment->size = index->entries[entry].size;
+    segment->end = segment->begin + segment->size;
+    return true;
+  }
+
+  /**
+   * @brief Creates a range over the segments of a path.
+   *
+   * This function creates a bidirectional range which yields every segment of
+   * the path as a string view. The range behaves exactly like iterating with
+   * get_first_segment and get_next_segment, it does not copy the path and the
+   * path must stay valid while the range is used.
+   *
+   * @param path The path which will be iterated.
+   * @return Returns the range over the segments.
+   */
+  cwk_segment_range<cwk_impl> segments(const char *path) const noexcept
+  {
+    return cwk_segment_range<cwk_impl>(*this, path);
+  }
+
+  /**
+   * @brief Creates a range over the segments of multiple joined paths.
+   *
+   * This function creates a bidirectional range which yields the segments of
+   * multiple paths as if they were joined together. The last path of the
+   * submitted string array must be set to NULL. The root of all paths except
+   * the first one is treated as a segment, just like join_multiple does.
+   *
+   * @param paths An array of paths which will be iterated.
+   * @return Returns the range over the segments.
+   */
+  cwk_joined_segment_range<cwk_impl, false> joined_segments(
+    const char **paths) const noexcept
+  {
+    return cwk_joined_segment_range<cwk_impl, false>(*this, paths);
+  }
+
+  /**
+   * @brief Creates a range over the visible segments of a path.
+   *
+   * This function creates a bidirectional range which only yields the
+   * segments which remain after the path has been normalized. Those are the
+   * same segments which normalize would write to the output buffer.
+   *
+   * @param path The path which will be iterated.
+   * @return Returns the range over the visible segments.
+   */
+  cwk_joined_segment_range<cwk_impl, true> visible_segments(
+    const char *path) const noexcept
+  {
+    return cwk_joined_segment_range<cwk_impl, true>(*this, path);
+  }
+
+  /**
+   * @brief Creates a range over the visible segments of multiple paths.
+   *
+   * This function creates a bidirectional range which only yields the
+   * segments which remain after the paths have been joined and normalized. The
+   * last path of the submitted string array must be set to NULL.
+   *
+   * @param paths An array of paths which will be iterated.
+   * @return Returns the range over the visible segments.
+   */
+  cwk_joined_segment_range<cwk_impl, true> visible_segments(
+    const char **paths) const noexcept
+  {
+    return cwk_joined_segment_range<cwk_impl, true>(*this, paths);
+  }
+
+  /**
+   * @brief Creates a lazy view of the normalized, joined paths.
+   *
+   * This function creates a view over the segments which
+   * join_multiple would write to the output buffer if it was called with the
+   * submitted paths. Nothing is written anywhere, the segments are string
+   * views into the submitted paths. The paths must stay valid while the view
+   * is used. The root of the first path is available separately.
+   *
+   * @param paths The paths which will be joined and normalized.
+   * @return Returns the view of the normalized path.
+   */
+  template <typename... T_PATHS>
+    requires(sizeof...(T_PATHS) > 0 &&
+             (std::is_convertible_v<T_PATHS, const char *> && ...))
+  cwk_normalized_view<cwk_impl, sizeof...(T_PATHS)> normalized_view(
+    T_PATHS... paths) const noexcept
+  {
+    return cwk_normalized_view<cwk_impl, sizeof...(T_PATHS)>(*this, paths...);
+  }
+
+  /**
+   * @brief Creates a path expression which joins multiple paths.
+   *
+   * This function creates a lazy path expression. The expression joins and
+   * normalizes the submitted paths and may apply further changes to the root,
+   * the basename and the extension. Nothing is evaluated until the expression
+   * is written to a buffer, which happens in a single pass without any
+   * intermediate buffers. The paths must stay valid while the expression is
+   * used.
+   *
+   * @param paths The paths which will be joined and normalized.
+   * @return Returns the path expression.
+   */
+  template <typename... T_PATHS>
+    requires(sizeof...(T_PATHS) > 0 &&
+             (std::is_convertible_v<T_PATHS, const char *> && ...))
+  cwk_path_expression<cwk_impl, sizeof...(T_PATHS)> expression(
+    T_PATHS... paths) const noexcept
+  {
+    return cwk_path_expression<cwk_impl, sizeof...(T_PATHS)>(*this, paths...);
+  }
+
+  /**
+   * @brief Creates a path expression of an absolute path based on a base.
+   *
+   * This function creates a lazy path expression which evaluates to the same
+   * path as get_absolute would generate. Further changes can be applied to the
+   * expression before it is written to a buffer.
+   *
+   * @param base The absolute base path on which the relative path will be
+   * applied.
+   * @param path The relative path which will be applied on the base path.
+   * @return Returns the path expression.
+   */
+  cwk_path_expression<cwk_impl, 3> absolute_expression(
+    const char *base, const char *path) const noexcept
+  {
+    const char *fake_root;
+
+    // This is the same as get_absolute does, a relative base receives a root
+    // and an absolute path overrides the base.
+    fake_root = is_absolute(base)                  ? NULL
+                : path_style == CWK_STYLE_WINDOWS ? "\\"
+                                                   : "/";
+    if (is_absolute(path)) {
+      return fake_root ? cwk_path_expression<cwk_impl, 3>(
+                           *this, fake_root, path, (const char *)NULL)
+                       : cwk_path_expression<cwk_impl, 3>(
+                           *this, path, (const char *)NULL, (const char *)NULL);
+    }
+
+    return fake_root ? cwk_path_expression<cwk_impl, 3>(
+                         *this, fake_root, base, path)
+                     : cwk_path_expression<cwk_impl, 3>(
+                         *this, base, path, (const char *)NULL);
+  }
+
+  /**
+   * @brief Creates a path builder starting at a base path.
+   *
+   * This function creates a path builder, which keeps a single buffer with
+   * the normalized base path. Segments can then be pushed and popped again,
+   * which is much cheaper than joining the whole path for every change.
+   *
+   * @param base The path where the builder starts.
+   * @return Returns the path builder.
+   */
+  cwk_path_builder<cwk_impl> builder(const char *base) const
+  {
+    return cwk_path_builder<cwk_impl>(*this, base);
+  }
+
   /**
    * @brief Changes the content of a segment.
    *
@@ -1122,6 +1787,8 @@ template <typename T_BASE> struct cwk_impl : T_BASE
    */
   cwk_path_style guess_style(const char *path) const noexcept
   {
+    CWK_TRACE_CALL(CWK_TRACE_GUESS_STYLE, 0, {path});
+
     const char *c;
     size_t root_length;
     struct cwk_segment segment;
@@ -1190,6 +1857,15 @@ template <typename T_BASE> struct cwk_impl : T_BASE
 private:
   using T_BASE::path_style;
 
+  template <typename T_IMPL, bool T_VISIBLE>
+  friend class cwk_joined_segment_iterator;
+
+  template <typename T_IMPL, size_t T_COUNT> friend class cwk_path_expression;
+
+  template <typename T_IMPL> friend class cwk_path_builder;
+
+  template <typename T_IMPL> friend class cwk_visibility;
+
   /**
    * This is a list of separators used in different styles. Windows can read
    * multiple separators, but it generally outputs just a backslash. The output
@@ -1210,6 +1886,19 @@ private:
     struct cwk_segment segment;
     const char **paths;
     size_t path_index;
+
+    // The first path which has a segment. Its root is not part of the
+    // segments, the roots of all following paths are.
+    size_t first_index;
+
+    // The position of the segment among all segments of the joined paths,
+    // which is used to look up whether it is visible. The visibility is
+    // known for the first CWK_VISIBILITY_SEGMENTS segments if it was
+    // determined up front, and for the 64 segments starting at window_begin.
+    size_t index;
+    const uint64_t *visibility;
+    uint64_t window;
+    size_t window_begin;
   };
 
   inline size_t output_sized(char *buffer, size_t buffer_size, size_t position,
@@ -1236,6 +1925,9 @@ private:
       memmove(&buffer[position], str, amount_written);
     }
 
+    CWK_STATS_ADD(bytes_written, amount_written);
+    CWK_STATS_ADD(truncations, amount_written < length);
+
     // Return the theoretical length which would have been written when
     // everything would have fit in the buffer.
     return length;
@@ -1323,6 +2015,117 @@ private:
     return n == 0 || (*first == '\0' && *second == '\0');
   }
 
+  inline uint64_t get_separator_mask(
+    const char *str, size_t length) const noexcept
+  {
+    uint64_t mask;
+    size_t i;
+
+    // The mask contains a bit for every character in the block which is a
+    // separator. The block must not be longer than 64 characters.
+    assert(length <= 64);
+    mask = 0;
+    i = 0;
+
+#ifdef CWK_SSE2
+    // We compare 16 characters at once. The separators are the same as in the
+    // separator list, a slash is always a separator and the backslash only for
+    // windows.
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= length; i += 16) {
+      __m128i chunk, matches;
+
+      chunk = _mm_loadu_si128((const __m128i *)(str + i));
+      matches = _mm_cmpeq_epi8(chunk, slash);
+      if (path_style == CWK_STYLE_WINDOWS) {
+        matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, backslash));
+      }
+
+      mask |= (uint64_t)(unsigned)_mm_movemask_epi8(matches) << i;
+    }
+#endif
+
+    // Whatever is left, which is everything without SSE2, will be checked one
+    // character at a time.
+    for (; i < length; ++i) {
+      if (is_separator(&str[i])) {
+        mask |= (uint64_t)1 << i;
+      }
+    }
+
+    return mask;
+  }
+
+  inline void index_segment(struct cwk_segment_index *index, size_t begin,
+    size_t end, size_t *depth) const noexcept
+  {
+    struct cwk_segment_index_entry *entry;
+    cwk_segment segment;
+    cwk_segment_type type;
+
+    // We determine the type right away, since we already know where the
+    // segment is. The depth is tracked like a stack of normal segments, a back
+    // segment pops one of them if there is any.
+    CWK_STATS_ADD(segments, 1);
+    segment.begin = index->path + begin;
+    segment.size = end - begin;
+    type = get_segment_type(&segment);
+    if (type == CWK_NORMAL) {
+      ++*depth;
+    } else if (type == CWK_BACK && *depth > 0) {
+      --*depth;
+    }
+
+    // We still count the segment if there is no space left, so the caller
+    // knows how large the index has to be.
+    if (index->count < index->capacity) {
+      entry = &index->entries[index->count];
+      entry->begin = begin;
+      entry->size = end - begin;
+      entry->depth = *depth;
+      entry->type = type;
+      entry->removed = type == CWK_CURRENT;
+    }
+
+    ++index->count;
+  }
+
+  inline void index_mark_removed(
+    struct cwk_segment_index *index) const noexcept
+  {
+    struct cwk_segment_index_entry *entry;
+    size_t i, min_depth, previous_depth;
+
+    // A back segment is removed if there is a normal segment before it which
+    // it can pop off, which is the case if the depth before it was above zero.
+    // On absolute paths all of them are removed.
+    previous_depth = 0;
+    for (i = 0; i < index->count; ++i) {
+      entry = &index->entries[i];
+      if (entry->type == CWK_BACK) {
+        entry->removed = index->absolute || previous_depth > 0;
+      }
+
+      previous_depth = entry->depth;
+    }
+
+    // A normal segment is removed if the depth drops below its own depth
+    // afterwards. We walk backwards and keep track of the lowest depth, which
+    // avoids scanning the following segments for every normal segment.
+    min_depth = SIZE_MAX;
+    for (i = index->count; i > 0; --i) {
+      entry = &index->entries[i - 1];
+      if (entry->type == CWK_NORMAL) {
+        entry->removed = min_depth < entry->depth;
+      }
+
+      if (entry->depth < min_depth) {
+        min_depth = entry->depth;
+      }
+    }
+  }
+
   inline const char *find_next_stop(const char *c) const noexcept
   {
     // We just move forward until we find a '\0' or a separator, which will be
@@ -1391,6 +2194,8 @@ private:
     // position from the end.
     segment->size = (size_t)(segments - segment->begin);
     segment->end = segments;
+    CWK_STATS_ADD(segments, 1);
+    CWK_STATS_ADD(bytes_scanned, segments - segment->segments);
 
     // Tell the caller that we found a segment.
     return true;
@@ -1416,8 +2221,9 @@ private:
     return true;
   }
 
-  inline bool get_first_segment_joined(
-    const char **paths, struct cwk_segment_joined *sj) const noexcept
+  inline bool get_first_segment_joined(const char **paths,
+    struct cwk_segment_joined *sj,
+    const cwk_visibility<cwk_impl> *visibility = NULL) const noexcept
   {
     bool result;
 
@@ -1425,6 +2231,14 @@ private:
     // path and assign the path array to the struct.
     sj->path_index = 0;
     sj->paths = paths;
+    sj->index = 0;
+
+    // The visibility is taken from the caller if it has been determined
+    // already. Otherwise it is determined when it is needed for the first
+    // time.
+    sj->visibility = visibility ? visibility->bits : NULL;
+    sj->window = 0;
+    sj->window_begin = SIZE_MAX;
 
     // We loop through all paths until we find one which has a segment. The
     // result is stored in a variable, so we can let the caller know whether we
@@ -1436,6 +2250,7 @@ private:
       ++sj->path_index;
     }
 
+    sj->first_index = sj->path_index;
     return result;
   }
 
@@ -1451,6 +2266,7 @@ private:
     } else if (get_next_segment(&sj->segment)) {
       // There was another segment on the current path, so we are good to
       // continue.
+      ++sj->index;
       return true;
     }
 
@@ -1477,6 +2293,10 @@ private:
     } while (!result);
 
     // Finally, report the result back to the caller.
+    if (result) {
+      ++sj->index;
+    }
+
     return result;
   }
 
@@ -1493,6 +2313,7 @@ private:
     } else if (get_previous_segment(&sj->segment)) {
       // Now we try to get the previous segment from the current path. If we can
       // do that successfully, we can let the caller know that we found one.
+      --sj->index;
       return true;
     }
 
@@ -1509,9 +2330,11 @@ private:
       // index.
       --sj->path_index;
 
-      // If this is the first path we will have to consider that this path might
-      // include a root, otherwise we just treat is as a segment.
-      if (sj->path_index == 0) {
+      // If this is the first path with segments we will have to consider that
+      // this path might include a root, otherwise we just treat is as a
+      // segment. This must match get_first_segment_joined, which skips the
+      // root of every path up to the first one with a segment.
+      if (sj->path_index <= sj->first_index) {
         result = get_last_segment(sj->paths[sj->path_index], &sj->segment);
       } else {
         result = get_last_segment_without_root(
@@ -1520,118 +2343,104 @@ private:
 
     } while (!result);
 
+    if (result) {
+      --sj->index;
+    }
+
     return result;
   }
 
-  inline bool segment_back_will_be_removed(
-    struct cwk_segment_joined *sj) const noexcept
+  inline size_t get_visibility(const char **paths, bool absolute,
+    size_t begin, uint64_t *bits, size_t words) const noexcept
   {
+    struct cwk_segment_joined sj, last;
     cwk_segment_type type;
-    int counter;
-
-    // We are handling back segments here. We must verify how many back segments
-    // and how many normal segments come before this one to decide whether we
-    // keep or remove it.
-
-    // The counter determines how many normal segments are our current segment,
-    // which will popped off before us. If the counter goes above zero it means
-    // that our segment will be popped as well.
-    counter = 0;
-
-    // We loop over all previous segments until we either reach the beginning,
-    // which means our segment will not be dropped or the counter goes above
-    // zero.
-    while (get_previous_segment_joined(sj)) {
-
-      // Now grab the type. The type determines whether we will increase or
-      // decrease the counter. We don't handle a CWK_CURRENT frame here since it
-      // has no influence.
-      type = get_segment_type(&sj->segment);
-      if (type == CWK_NORMAL) {
-        // This is a normal segment. The normal segment will increase the
-        // counter since it neutralizes one back segment. If we go above zero we
-        // can return immediately.
-        ++counter;
-        if (counter > 0) {
-          return true;
-        }
-      } else if (type == CWK_BACK) {
-        // A CWK_BACK segment will reduce the counter by one. We can not remove
-        // a back segment as long we are not above zero since we don't have the
-        // opposite normal segment which we would remove.
-        --counter;
-      }
+    size_t end, depth, backs;
+
+    // This determines which of the segments from begin up to end are kept by
+    // the normalization. All other segments are still looked at, since they
+    // decide about the ones in between.
+    CWK_STATS_ADD(removal_scans, 1);
+    end = begin + words * 64;
+    memset(bits, 0, words * sizeof(*bits));
+    if (!get_first_segment_joined(paths, &sj)) {
+      return 0;
     }
 
-    // We never got a count larger than zero, so we will keep this segment
-    // alive.
-    return false;
-  }
+    // The depth is the amount of normal segments in front of the current one
+    // which are not removed by a back segment yet, just like the stack which
+    // the normalization uses. A back segment is kept if there is no such
+    // segment it could remove, unless the path is absolute. For now, every
+    // normal segment is assumed to be kept.
+    depth = 0;
+    do {
+      last = sj;
+      type = get_segment_type(&sj.segment);
+      if (type == CWK_CURRENT) {
+        continue;
+      } else if (type == CWK_BACK && depth > 0) {
+        --depth;
+        continue;
+      } else if (type == CWK_BACK && absolute) {
+        continue;
+      } else if (type == CWK_NORMAL) {
+        ++depth;
+      }
 
-  inline bool segment_normal_will_be_removed(
-    struct cwk_segment_joined *sj) const noexcept
-  {
-    cwk_segment_type type;
-    int counter;
-
-    // The counter determines how many segments are above our current segment,
-    // which will popped off before us. If the counter goes below zero it means
-    // that our segment will be popped as well.
-    counter = 0;
-
-    // We loop over all following segments until we either reach the end, which
-    // means our segment will not be dropped or the counter goes below zero.
-    while (get_next_segment_joined(sj)) {
-
-      // First, grab the type. The type determines whether we will increase or
-      // decrease the counter. We don't handle a CWK_CURRENT frame here since it
-      // has no influence.
-      type = get_segment_type(&sj->segment);
-      if (type == CWK_NORMAL) {
-        // This is a normal segment. The normal segment will increase the
-        // counter since it will be removed by a "../" before us.
-        ++counter;
-      } else if (type == CWK_BACK) {
-        // A CWK_BACK segment will reduce the counter by one. If we are below
-        // zero we can return immediately.
-        --counter;
-        if (counter < 0) {
-          return true;
+      if (sj.index >= begin && sj.index < end) {
+        bits[(sj.index - begin) / 64] |= (uint64_t)1 << (sj.index - begin) % 64;
+      }
+    } while (get_next_segment_joined(&sj));
+
+    // Now we walk backwards and count the back segments which still have to
+    // remove a normal segment in front of them. Every normal segment which is
+    // removed this way is not kept after all. We can stop at the beginning of
+    // the requested segments.
+    sj = last;
+    backs = 0;
+    do {
+      type = get_segment_type(&sj.segment);
+      if (type == CWK_BACK) {
+        ++backs;
+      } else if (type == CWK_NORMAL && backs > 0) {
+        --backs;
+        if (sj.index >= begin && sj.index < end) {
+          bits[(sj.index - begin) / 64] &=
+            ~((uint64_t)1 << (sj.index - begin) % 64);
         }
       }
-    }
+    } while (sj.index > begin && get_previous_segment_joined(&sj));
 
-    // We never got a negative count, so we will keep this segment alive.
-    return false;
+    return last.index + 1;
   }
 
-  inline bool segment_will_be_removed(
-    const struct cwk_segment_joined *sj, bool absolute) const noexcept
+  inline bool is_segment_joined_visible(
+    struct cwk_segment_joined *sj, bool absolute) const noexcept
   {
-    cwk_segment_type type;
-    struct cwk_segment_joined sjc;
+    size_t offset;
 
-    // We copy the joined path so we don't need to modify it.
-    sjc = *sj;
+    // If the visibility of this segment is known we can just look it up.
+    // Otherwise we determine it for the 64 segments around this one, unless
+    // those are the ones we already know about.
+    if (sj->visibility && sj->index < CWK_VISIBILITY_SEGMENTS) {
+      return sj->visibility[sj->index / 64] >> sj->index % 64 & 1;
+    }
 
-    // First we check whether this is a CWK_CURRENT or CWK_BACK segment, since
-    // those will always be dropped.
-    type = get_segment_type(&sj->segment);
-    if (type == CWK_CURRENT) {
-      return true;
-    } else if (type == CWK_BACK && absolute) {
-      return true;
-    } else if (type == CWK_BACK) {
-      return segment_back_will_be_removed(&sjc);
-    } else {
-      return segment_normal_will_be_removed(&sjc);
+    if (sj->index < sj->window_begin || sj->index - sj->window_begin >= 64) {
+      sj->window_begin = sj->index - sj->index % 64;
+      get_visibility(sj->paths, absolute, sj->window_begin, &sj->window, 1);
     }
+
+    offset = sj->index - sj->window_begin;
+    return sj->window >> offset & 1;
   }
 
   inline bool segment_joined_skip_invisible(
     struct cwk_segment_joined *sj, bool absolute) const noexcept
   {
-    while (segment_will_be_removed(sj, absolute)) {
+    // We skip every segment which is removed by the normalization, until we
+    // find one which is visible or reach the end.
+    while (!is_segment_joined_visible(sj, absolute)) {
       if (!get_next_segment_joined(sj)) {
         return false;
       }
@@ -1647,6 +2456,7 @@ private:
 
     // We can not determine the root if this is an empty string. So we set the
     // root to NULL and the length to zero and cancel the whole thing.
+    CWK_STATS_ADD(root_parses, 1);
     c = path;
     *length = 0;
     if (!*c) {
@@ -1729,6 +2539,7 @@ private:
   {
     // The slash of the unix path represents the root. There is no root if there
     // is no slash.
+    CWK_STATS_ADD(root_parses, 1);
     if (is_separator(path)) {
       *length = 1;
     } else {
@@ -1748,22 +2559,57 @@ private:
     return is_separator(&path[length - 1]);
   }
 
+  inline size_t get_truncated_segments_length(
+    const struct cwk_segment_joined *last, size_t count) const noexcept
+  {
+    struct cwk_segment_joined sj;
+    cwk_segment_type type;
+    size_t skip, length;
+
+    // The last segments which are kept by the normalization are the ones which
+    // did not fit into the buffer. We walk backwards over all segments once,
+    // and count the skipped normal segments for every back segment we pass.
+    sj = *last;
+    skip = 0;
+    length = 0;
+    do {
+      type = get_segment_type(&sj.segment);
+      if (type == CWK_BACK) {
+        ++skip;
+      } else if (type == CWK_NORMAL) {
+        if (skip > 0) {
+          --skip;
+        } else {
+          length += sj.segment.size + 1;
+          if (--count == 0) {
+            return length;
+          }
+        }
+      }
+    } while (get_previous_segment_joined(&sj));
+
+    // Whatever is left are "../" segments in front of a relative path.
+    return length + count * 3;
+  }
+
   inline size_t join_and_normalize_multiple(
     const char **paths, char *buffer, size_t buffer_size) const noexcept
   {
-    size_t pos;
-    bool absolute, has_segment_output;
-    struct cwk_segment_joined sj;
+    size_t pos, root_length, count, depth, start, overflow, overflow_pos, i;
+    bool absolute, overflow_first;
+    struct cwk_segment_joined sj, last;
+    cwk_segment_type type;
 
     // We initialize the position after the root, which should get us started.
-    get_root(paths[0], &pos);
+    get_root(paths[0], &root_length);
+    pos = root_length;
 
     // Determine whether the path is absolute or not. We need that to determine
     // later on whether we can remove superfluous "../" or not.
-    absolute = is_root_absolute(paths[0], pos);
+    absolute = is_root_absolute(paths[0], root_length);
 
     // First copy the root to the output. We will not modify the root.
-    output_sized(buffer, buffer_size, 0, paths[0], pos);
+    output_sized(buffer, buffer_size, 0, paths[0], root_length);
 
     // So we just grab the first segment. If there is no segment we will always
     // output a "/", since we currently only support absolute paths here.
@@ -1771,14 +2617,51 @@ private:
       goto done;
     }
 
-    // Let's assume that we don't have any segment output for now. We will
-    // toggle this flag once there is some output.
-    has_segment_output = false;
+    // The output behind the root is used as a stack of segments. Every normal
+    // segment is written right away, and a back segment removes the last one
+    // again. This way every segment is only looked at once. The count is the
+    // amount of segments on the stack, and the depth is the amount of normal
+    // segments among them, which are always on top of the "../" segments.
+    count = 0;
+    depth = 0;
+
+    // Segments which start behind the end of the buffer are not written, so
+    // their size is not known when they are removed again. We only count
+    // them and remember where the first one was written.
+    overflow = 0;
+    overflow_pos = 0;
+    overflow_first = false;
 
     do {
-      // Check whether we have to drop this segment because of resolving a
-      // relative path or because it is a CWK_CURRENT segment.
-      if (segment_will_be_removed(&sj, absolute)) {
+      last = sj;
+      type = get_segment_type(&sj.segment);
+      if (type == CWK_CURRENT) {
+        continue;
+      } else if (type == CWK_BACK && depth > 0) {
+        // This back segment removes the last normal segment. If it is in the
+        // buffer, we look for the separator in front of it. It can not contain
+        // any other separator.
+        --depth;
+        if (--count == 0) {
+          pos = root_length;
+          overflow = 0;
+        } else if (overflow > 0) {
+          if (--overflow == 0) {
+            pos = overflow_pos;
+          }
+        } else {
+          i = pos < buffer_size ? pos : buffer_size;
+          while (
+            i > root_length && buffer[i - 1] != separators[path_style][0]) {
+            --i;
+          }
+
+          pos = i - 1;
+        }
+
+        continue;
+      } else if (type == CWK_BACK && absolute) {
+        // There is nothing to go back to, and we can not go above the root.
         continue;
       }
 
@@ -1786,25 +2669,41 @@ private:
       // must not have a trailing separator. This must happen before the segment
       // output, since we would override the null terminating character with
       // reused buffers if this was done afterwards.
-      if (has_segment_output) {
-        pos += output_separator(buffer, buffer_size, pos);
+      start = count > 0 ? pos + 1 : pos;
+      if (overflow > 0 || start > buffer_size) {
+        if (overflow++ == 0) {
+          overflow_pos = pos;
+          overflow_first = count == 0;
+        }
+      } else if (count > 0) {
+        output_separator(buffer, buffer_size, pos);
       }
 
-      // Remember that we have segment output, so we can handle the trailing
-      // slash later on. This is necessary since we might have segments but they
-      // are all removed.
-      has_segment_output = true;
-
       // Write out the segment but keep in mind that we need to follow the
       // buffer size limitations. That's why we use the path output functions
-      // here.
-      pos += output_sized(
-        buffer, buffer_size, pos, sj.segment.begin, sj.segment.size);
+      // here. A back segment which is kept is always written as "..".
+      if (type == CWK_BACK) {
+        pos = start + output_back(buffer, buffer_size, start);
+      } else {
+        pos = start + output_sized(buffer, buffer_size, start, sj.segment.begin,
+                        sj.segment.size);
+        ++depth;
+      }
+
+      ++count;
     } while (get_next_segment_joined(&sj));
 
+    // The length of the segments behind the buffer is determined by walking
+    // backwards, which also works with reused buffers since nothing behind
+    // the buffer has been overwritten.
+    if (overflow > 0) {
+      pos = overflow_pos + get_truncated_segments_length(&last, overflow) -
+            (overflow_first ? 1 : 0);
+    }
+
     // Remove the trailing slash, but only if we have segment output. We don't
     // want to remove anything from the root.
-    if (!has_segment_output && pos == 0) {
+    if (count == 0 && pos == 0) {
       // This may happen if the path is absolute and all segments have been
       // removed. We can not have an empty output - and empty output means we
       // stay in the current directory. So we will output a ".".
@@ -1844,8 +2743,10 @@ private:
       }
 
       // Compare the content of both segments. We are done if they are not
-      // equal, since they diverge.
-      if (!is_string_equal(
+      // equal, since they diverge. A segment which is only the prefix of the
+      // other one is not equal either.
+      if (bsj->segment.size != osj->segment.size ||
+          !is_string_equal(
             bsj->segment.begin, osj->segment.begin, bsj->segment.size)) {
         break;
       }
@@ -1859,6 +2760,924 @@ private:
   }
 };
 
+/**
+ * The visibility of joined paths tells which of their segments are kept by the
+ * normalization. It is determined for the first CWK_VISIBILITY_SEGMENTS
+ * segments at once, so walking over the visible segments stays linear no
+ * matter where the back segments are. The bitmap is stored inline, so the
+ * visibility never allocates.
+ */
+template <typename T_IMPL> class cwk_visibility
+{
+public:
+  cwk_visibility() noexcept : bits{}
+  {
+  }
+
+  cwk_visibility(const T_IMPL &impl, const char **paths) noexcept
+    : cwk_visibility(impl, paths, is_absolute(impl, paths[0]))
+  {
+  }
+
+  cwk_visibility(
+    const T_IMPL &impl, const char **paths, bool absolute) noexcept
+  {
+    // The visibility depends on whether the path is absolute, since back
+    // segments can not go above the root of those.
+    impl.get_visibility(paths, absolute, 0, bits, CWK_VISIBILITY_SEGMENTS / 64);
+  }
+
+private:
+  template <typename T_BASE> friend struct cwk_impl;
+
+  uint64_t bits[CWK_VISIBILITY_SEGMENTS / 64];
+
+  static bool is_absolute(const T_IMPL &impl, const char *path) noexcept
+  {
+    size_t root_length;
+
+    impl.get_root(path, &root_length);
+    return impl.is_root_absolute(path, root_length);
+  }
+};
+
+/**
+ * The segment iterator walks over the segments of a single path. It keeps a
+ * copy of the path style, so it stays valid even if the instance which
+ * created it goes away. The end of the range is represented by the default
+ * sentinel.
+ */
+template <typename T_IMPL> class cwk_segment_iterator
+{
+public:
+  using value_type = std::string_view;
+  using difference_type = ptrdiff_t;
+  using iterator_concept = std::bidirectional_iterator_tag;
+
+  cwk_segment_iterator() = default;
+
+  cwk_segment_iterator(const T_IMPL &impl, const char *path) noexcept
+    : impl{impl}
+  {
+    // If there is no first segment we are at the end right away.
+    at_end = !impl.get_first_segment(path, &segment);
+  }
+
+  cwk_segment_iterator(
+    const T_IMPL &impl, const char *path, std::default_sentinel_t) noexcept
+    : impl{impl}
+  {
+    // The end stores the last segment, just like an iterator which was
+    // advanced to the end.
+    impl.get_last_segment(path, &segment);
+  }
+
+  std::string_view operator*() const noexcept
+  {
+    return std::string_view(segment.begin, segment.size);
+  }
+
+  const cwk_segment &get_segment() const noexcept
+  {
+    return segment;
+  }
+
+  cwk_segment_iterator &operator++() noexcept
+  {
+    // The segment is not modified if there is no next segment, so we can step
+    // back to the last segment from the end.
+    if (!impl.get_next_segment(&segment)) {
+      at_end = true;
+    }
+
+    return *this;
+  }
+
+  cwk_segment_iterator operator++(int) noexcept
+  {
+    cwk_segment_iterator previous = *this;
+    ++*this;
+    return previous;
+  }
+
+  cwk_segment_iterator &operator--() noexcept
+  {
+    // Moving back from the end means we are on the last segment again, which
+    // is still stored in the segment.
+    if (at_end) {
+      at_end = false;
+    } else {
+      impl.get_previous_segment(&segment);
+    }
+
+    return *this;
+  }
+
+  cwk_segment_iterator operator--(int) noexcept
+  {
+    cwk_segment_iterator previous = *this;
+    --*this;
+    return previous;
+  }
+
+  friend bool operator==(
+    const cwk_segment_iterator &a, const cwk_segment_iterator &b) noexcept
+  {
+    return a.at_end == b.at_end &&
+           (a.at_end || a.segment.begin == b.segment.begin);
+  }
+
+  friend bool operator==(
+    const cwk_segment_iterator &it, std::default_sentinel_t) noexcept
+  {
+    return it.at_end;
+  }
+
+private:
+  T_IMPL impl;
+  struct cwk_segment segment = {};
+  bool at_end = true;
+};
+
+/**
+ * The joined segment iterator walks over the segments of multiple paths as if
+ * they were joined. If T_VISIBLE is set, all segments which are removed by
+ * normalization are skipped.
+ */
+template <typename T_IMPL, bool T_VISIBLE> class cwk_joined_segment_iterator
+{
+public:
+  using value_type = std::string_view;
+  using difference_type = ptrdiff_t;
+  using iterator_concept = std::bidirectional_iterator_tag;
+
+  cwk_joined_segment_iterator() = default;
+
+  cwk_joined_segment_iterator(const T_IMPL &impl, const char **paths,
+    const cwk_visibility<T_IMPL> *visibility = NULL) noexcept
+    : impl{impl}
+  {
+    size_t root_length;
+
+    // We need to know whether the first path is absolute, since this decides
+    // whether back segments at the beginning are visible or not.
+    impl.get_root(paths[0], &root_length);
+    absolute = impl.is_root_absolute(paths[0], root_length);
+
+    at_end = !impl.get_first_segment_joined(paths, &sj, visibility);
+    if constexpr (T_VISIBLE) {
+      if (!at_end) {
+        at_end = !impl.segment_joined_skip_invisible(&sj, absolute);
+      }
+    }
+  }
+
+  std::string_view operator*() const noexcept
+  {
+    return std::string_view(sj.segment.begin, sj.segment.size);
+  }
+
+  const cwk_segment &get_segment() const noexcept
+  {
+    return sj.segment;
+  }
+
+  cwk_joined_segment_iterator &operator++() noexcept
+  {
+    decltype(sj) next;
+
+    // Unlike a single segment, the joined segment is modified even if there is
+    // no next segment. So we advance a copy and only keep it if it worked out,
+    // which allows us to step back from the end.
+    next = sj;
+    if (!impl.get_next_segment_joined(&next)) {
+      at_end = true;
+      return *this;
+    }
+
+    if constexpr (T_VISIBLE) {
+      if (!impl.segment_joined_skip_invisible(&next, absolute)) {
+        at_end = true;
+        return *this;
+      }
+    }
+
+    sj = next;
+    return *this;
+  }
+
+  cwk_joined_segment_iterator operator++(int) noexcept
+  {
+    cwk_joined_segment_iterator previous = *this;
+    ++*this;
+    return previous;
+  }
+
+  cwk_joined_segment_iterator &operator--() noexcept
+  {
+    // The last segment is still stored if we are at the end.
+    if (at_end) {
+      at_end = false;
+      return *this;
+    }
+
+    // Otherwise we move back until we find a segment which is visible.
+    while (impl.get_previous_segment_joined(&sj)) {
+      if constexpr (T_VISIBLE) {
+        if (!impl.is_segment_joined_visible(&sj, absolute)) {
+          continue;
+        }
+      }
+
+      break;
+    }
+
+    return *this;
+  }
+
+  cwk_joined_segment_iterator operator--(int) noexcept
+  {
+    cwk_joined_segment_iterator previous = *this;
+    --*this;
+    return previous;
+  }
+
+  friend bool operator==(const cwk_joined_segment_iterator &a,
+    const cwk_joined_segment_iterator &b) noexcept
+  {
+    return a.at_end == b.at_end && a.sj.segment.begin == b.sj.segment.begin;
+  }
+
+  friend bool operator==(
+    const cwk_joined_segment_iterator &it, std::default_sentinel_t) noexcept
+  {
+    return it.at_end;
+  }
+
+private:
+  T_IMPL impl;
+  typename T_IMPL::cwk_segment_joined sj = {};
+  bool absolute = false;
+  bool at_end = true;
+};
+
+/**
+ * A segment range is a view over the segments of a single path. It does not
+ * own the path, so iterators stay valid after the range is gone.
+ */
+template <typename T_IMPL>
+class cwk_segment_range
+  : public std::ranges::view_interface<cwk_segment_range<T_IMPL>>
+{
+public:
+  cwk_segment_range() = default;
+
+  cwk_segment_range(const T_IMPL &impl, const char *path) noexcept
+    : impl{impl}, path{path}
+  {
+  }
+
+  cwk_segment_iterator<T_IMPL> begin() const noexcept
+  {
+    return cwk_segment_iterator<T_IMPL>(impl, path);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+  /**
+   * @brief Returns an iterator at the end of the range.
+   *
+   * The iterator compares equal to the sentinel, but it can be decremented to
+   * walk the segments backwards without advancing an iterator to the end
+   * first.
+   *
+   * @return Returns the iterator behind the last segment.
+   */
+  cwk_segment_iterator<T_IMPL> end_iterator() const noexcept
+  {
+    return cwk_segment_iterator<T_IMPL>(impl, path, std::default_sentinel);
+  }
+
+private:
+  T_IMPL impl;
+  const char *path = "";
+};
+
+/**
+ * A joined segment range is a view over the segments of multiple paths. It
+ * either references a NULL-terminated array of paths of the caller, or stores
+ * a single path on its own.
+ */
+template <typename T_IMPL, bool T_VISIBLE>
+class cwk_joined_segment_range
+  : public std::ranges::view_interface<
+      cwk_joined_segment_range<T_IMPL, T_VISIBLE>>
+{
+public:
+  cwk_joined_segment_range() = default;
+
+  cwk_joined_segment_range(const T_IMPL &impl, const char **paths) noexcept
+    : impl{impl}, paths{paths}
+  {
+    if constexpr (T_VISIBLE) {
+      visibility = cwk_visibility<T_IMPL>(impl, paths);
+    }
+  }
+
+  cwk_joined_segment_range(const T_IMPL &impl, const char *path) noexcept
+    : impl{impl}, single_path{path, NULL}
+  {
+    if constexpr (T_VISIBLE) {
+      visibility =
+        cwk_visibility<T_IMPL>(impl, const_cast<const char **>(single_path));
+    }
+  }
+
+  cwk_joined_segment_iterator<T_IMPL, T_VISIBLE> begin() const noexcept
+  {
+    // We don't store a pointer to our own path array, since the range might be
+    // copied around. Instead we decide which array is used when iterating.
+    return cwk_joined_segment_iterator<T_IMPL, T_VISIBLE>(impl,
+      paths ? paths : const_cast<const char **>(single_path),
+      T_VISIBLE ? &visibility : NULL);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+private:
+  T_IMPL impl;
+  const char **paths = NULL;
+  const char *single_path[2] = {"", NULL};
+  cwk_visibility<T_IMPL> visibility;
+};
+
+template <typename T_IMPL>
+inline constexpr bool
+  std::ranges::enable_borrowed_range<cwk_segment_range<T_IMPL>> = true;
+
+/**
+ * A normalized view represents the result of joining and normalizing multiple
+ * paths without writing it to a buffer. Iterating the view yields the visible
+ * segments, the root is available through root().
+ */
+template <typename T_IMPL, size_t T_COUNT>
+class cwk_normalized_view
+  : public std::ranges::view_interface<cwk_normalized_view<T_IMPL, T_COUNT>>
+{
+public:
+  cwk_normalized_view() = default;
+
+  template <typename... T_PATHS>
+  cwk_normalized_view(const T_IMPL &impl, T_PATHS... paths) noexcept
+    : impl{impl}, paths{paths..., NULL},
+      visibility{impl, const_cast<const char **>(this->paths)}
+  {
+  }
+
+  cwk_joined_segment_iterator<T_IMPL, true> begin() const noexcept
+  {
+    return cwk_joined_segment_iterator<T_IMPL, true>(
+      impl, const_cast<const char **>(paths), &visibility);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+  /**
+   * @brief Gets the root of the normalized path.
+   *
+   * The root is taken from the first path and will not be modified by
+   * normalization. It is empty if the first path is relative.
+   *
+   * @return Returns the root of the normalized path.
+   */
+  std::string_view root() const noexcept
+  {
+    size_t length;
+
+    impl.get_root(paths[0], &length);
+    return std::string_view(paths[0], length);
+  }
+
+  /**
+   * @brief Determines the size of the normalized path.
+   *
+   * This returns the amount of characters which join_multiple would return
+   * for the same paths, without writing anything.
+   *
+   * @return Returns the size of the normalized path.
+   */
+  size_t length() const noexcept
+  {
+    size_t pos;
+    bool has_segment_output;
+
+    // We count just like the normalization would write. There is one
+    // separator between every two segments.
+    pos = root().size();
+    has_segment_output = false;
+    for (std::string_view segment : *this) {
+      if (has_segment_output) {
+        ++pos;
+      }
+
+      has_segment_output = true;
+      pos += segment.size();
+    }
+
+    // A relative path where all segments have been removed is written as the
+    // current directory. If there were no segments at all, nothing is written.
+    if (pos == 0 && cwk_joined_segment_iterator<T_IMPL, false>(impl,
+                      const_cast<const char **>(paths)) !=
+                      std::default_sentinel) {
+      pos = 1;
+    }
+
+    return pos;
+  }
+
+private:
+  T_IMPL impl;
+  const char *paths[T_COUNT + 1] = {};
+  cwk_visibility<T_IMPL> visibility;
+};
+
+/**
+ * A path expression is a lazy combination of path operations. It joins and
+ * normalizes paths and then optionally changes the root, the basename and the
+ * extension, in exactly that order. Everything is written in a single pass to
+ * the output buffer.
+ *
+ * The result is mostly the same as calling the individual functions one after
+ * another, but the intermediate results are never parsed again. The root is
+ * only taken from the first path, so a joined segment which looks like a root
+ * stays a segment. In windows style, expression(".", "C:\\") with the basename
+ * "n.c" gives "n.c", since "C:" is the last segment of the joined path. Using
+ * join and change_basename instead gives "C:n.c", since change_basename reads
+ * the joined "C:" as a root.
+ */
+template <typename T_IMPL, size_t T_COUNT> class cwk_path_expression
+{
+public:
+  template <typename... T_PATHS>
+  cwk_path_expression(const T_IMPL &impl, T_PATHS... paths) noexcept
+    : impl{impl}, paths{paths..., NULL}
+  {
+  }
+
+  /**
+   * @brief Changes the root of the expression, just like change_root.
+   */
+  cwk_path_expression with_root(const char *root) const noexcept
+  {
+    cwk_path_expression result = *this;
+    result.new_root = root;
+    return result;
+  }
+
+  /**
+   * @brief Changes the basename of the expression, just like change_basename.
+   */
+  cwk_path_expression with_basename(const char *basename) const noexcept
+  {
+    cwk_path_expression result = *this;
+    result.new_basename = basename;
+    return result;
+  }
+
+  /**
+   * @brief Changes the extension of the expression, just like
+   * change_extension.
+   */
+  cwk_path_expression with_extension(const char *extension) const noexcept
+  {
+    cwk_path_expression result = *this;
+    result.new_extension = extension;
+    return result;
+  }
+
+  /**
+   * @brief Evaluates the expression and writes the path to a buffer.
+   *
+   * The result will be written to a buffer, which might be truncated if the
+   * buffer is not large enough to hold the full path. However, the truncated
+   * result will always be null-terminated. Unlike the individual functions,
+   * the buffer must not overlap with any of the paths.
+   *
+   * @param buffer The buffer where the result will be written to.
+   * @param buffer_size The size of the result buffer.
+   * @return Returns the total amount of characters of the resulting path.
+   */
+  size_t write(char *buffer, size_t buffer_size) const noexcept
+  {
+    cwk_visibility<T_IMPL> visibility(impl, paths_array());
+    cwk_joined_segment_iterator<T_IMPL, true> it;
+    std::string_view held[2];
+    size_t pos, root_length, count;
+
+    // The root is copied or replaced, but the normalization always depends on
+    // the original root.
+    impl.get_root(paths[0], &root_length);
+    if (new_root) {
+      pos = impl.output(buffer, buffer_size, 0, new_root);
+    } else {
+      pos = impl.output_sized(buffer, buffer_size, 0, paths[0], root_length);
+    }
+
+    // We write all visible segments except the last two, since those might
+    // still be changed. This is why we always keep them back.
+    count = 0;
+    it = cwk_joined_segment_iterator<T_IMPL, true>(
+      impl, paths_array(), &visibility);
+    for (; it != std::default_sentinel; ++it) {
+      if (count == 2) {
+        pos += write_segment(buffer, buffer_size, pos, held[0]);
+        held[0] = held[1];
+        held[1] = *it;
+      } else {
+        held[count++] = *it;
+      }
+    }
+
+    // The normalization writes a current directory if all segments of a
+    // relative path have been removed. This one is treated as a segment.
+    if (count == 0 && root_length == 0 &&
+        cwk_joined_segment_iterator<T_IMPL, false>(impl, paths_array()) !=
+          std::default_sentinel) {
+      held[count++] = ".";
+    }
+
+    // An empty basename removes the last segment but leaves the separator in
+    // front of it. A following extension change will then apply to the segment
+    // before, which is why we kept two of them.
+    if (new_basename && new_extension && count == 2 &&
+        trim_separators(new_basename).empty()) {
+      pos += write_with_extension(buffer, buffer_size, pos, held[0], true);
+      pos += impl.output_separator(buffer, buffer_size, pos);
+      impl.terminate_output(buffer, buffer_size, pos);
+      return pos;
+    }
+
+    if (count == 2) {
+      pos += write_segment(buffer, buffer_size, pos, held[0]);
+      held[0] = held[1];
+      count = 1;
+    }
+
+    // Now we replace the last segment with the basename, which will be trimmed
+    // the same way change_basename does. If there is no last segment, the
+    // basename is placed right after the root.
+    if (new_basename) {
+      held[0] = trim_separators(new_basename);
+      count = 1;
+    }
+
+    if (new_extension) {
+      pos += write_with_extension(buffer, buffer_size, pos, held[0], count > 0);
+    } else if (count > 0) {
+      pos += impl.output_sized(
+        buffer, buffer_size, pos, held[0].data(), held[0].size());
+    }
+
+    impl.terminate_output(buffer, buffer_size, pos);
+    return pos;
+  }
+
+  /**
+   * @brief Determines the length of the evaluated expression.
+   *
+   * @return Returns the amount of characters which write would return.
+   */
+  size_t length() const noexcept
+  {
+    return write(NULL, 0);
+  }
+
+private:
+  T_IMPL impl;
+  const char *paths[T_COUNT + 1];
+  const char *new_root = NULL;
+  const char *new_basename = NULL;
+  const char *new_extension = NULL;
+
+  const char **paths_array() const noexcept
+  {
+    return const_cast<const char **>(paths);
+  }
+
+  size_t write_segment(char *buffer, size_t buffer_size, size_t pos,
+    std::string_view segment) const noexcept
+  {
+    size_t start;
+
+    // Every segment which is written before the last one is followed by a
+    // separator.
+    start = pos;
+    pos += impl.output_sized(
+      buffer, buffer_size, pos, segment.data(), segment.size());
+    pos += impl.output_separator(buffer, buffer_size, pos);
+    return pos - start;
+  }
+
+  std::string_view trim_separators(const char *value) const noexcept
+  {
+    size_t value_size;
+
+    // The separators are trimmed at the beginning and at the end of the value.
+    while (impl.is_separator(value)) {
+      ++value;
+    }
+
+    value_size = strlen(value);
+    while (value_size > 0 && impl.is_separator(&value[value_size - 1])) {
+      --value_size;
+    }
+
+    return std::string_view(value, value_size);
+  }
+
+  size_t write_with_extension(char *buffer, size_t buffer_size, size_t pos,
+    std::string_view last, bool has_last) const noexcept
+  {
+    const char *extension;
+    size_t start, i, head, dot;
+
+    // Without a last segment we behave like change_extension on a root, we add
+    // a dot if there is none and write the extension as it is.
+    extension = new_extension;
+    start = pos;
+    if (!has_last) {
+      if (*extension != '.') {
+        pos += impl.output_dot(buffer, buffer_size, pos);
+      }
+
+      pos += impl.output(buffer, buffer_size, pos, extension);
+      return pos - start;
+    }
+
+    // The last segment might contain separators if it is a changed basename,
+    // in that case the extension belongs to the part after the separator.
+    head = 0;
+    for (i = 0; i < last.size(); ++i) {
+      if (impl.is_separator(&last[i])) {
+        head = i + 1;
+      }
+    }
+
+    // Now we find the last dot, which is where the old extension starts. All
+    // of it will be replaced by the new one.
+    dot = last.size();
+    for (i = head; i < last.size(); ++i) {
+      if (last[i] == '.') {
+        dot = i;
+      }
+    }
+
+    last = last.substr(0, dot);
+    pos +=
+      impl.output_sized(buffer, buffer_size, pos, last.data(), last.size());
+    if (*extension == '.') {
+      ++extension;
+    }
+
+    pos += impl.output_dot(buffer, buffer_size, pos);
+    pos += impl.output(buffer, buffer_size, pos, extension);
+    return pos - start;
+  }
+};
+
+/**
+ * A path builder holds a single normalized path in a growing buffer together
+ * with a stack of its segment boundaries. Pushing a name appends its segments
+ * the same way join would, and popping removes the last segment again without
+ * parsing the path. The path is always null-terminated.
+ */
+template <typename T_IMPL> class cwk_path_builder
+{
+public:
+  cwk_path_builder(const T_IMPL &impl, const char *base) : impl{impl}
+  {
+    assign(base);
+  }
+
+  /**
+   * @brief Reserves space for a path length and an amount of segments.
+   *
+   * Reserving enough space upfront guarantees that push and pop will not
+   * allocate any memory as long as the limits are not exceeded.
+   */
+  void reserve(size_t length, size_t depth)
+  {
+    buffer.reserve(length);
+    boundaries.reserve(depth);
+  }
+
+  /**
+   * @brief Pushes a name to the end of the path.
+   *
+   * This function appends the segments of the name to the path, just like
+   * join would do. Separators at the beginning and the end of the name are
+   * ignored, "./" segments are skipped and "../" segments pop the previous
+   * segment if there is one. If no segment is left on a relative path, the
+   * path is "." like the result of join.
+   *
+   * @param name The name which will be appended.
+   * @return Returns the total length of the new path.
+   */
+  size_t push(const char *name)
+  {
+    struct cwk_segment segment;
+    std::string_view value;
+
+    // The name is treated like every path after the first one in a join, so
+    // even a root is considered to be a segment.
+    if (!impl.get_first_segment_without_root(name, name, &segment)) {
+      return length();
+    }
+
+    had_segments = true;
+    do {
+      value = std::string_view(segment.begin, segment.size);
+      switch (impl.get_segment_type(&segment)) {
+      case CWK_CURRENT:
+        break;
+      case CWK_BACK:
+        push_back_segment(value);
+        break;
+      case CWK_NORMAL:
+        push_segment(value);
+        break;
+      }
+    } while (impl.get_next_segment(&segment));
+
+    return length();
+  }
+
+  /**
+   * @brief Pushes a single name to the end of the path.
+   *
+   * This function appends the name as exactly one segment, without trimming
+   * or resolving anything. This is meant for names which are known to be a
+   * single segment, like the entries read from a directory.
+   *
+   * @param name The name which will be appended.
+   * @return Returns the total length of the new path.
+   */
+  size_t push_name(std::string_view name)
+  {
+    had_segments = true;
+    push_segment(name);
+    return length();
+  }
+
+  /**
+   * @brief Replaces the whole path with a new base.
+   *
+   * This behaves like creating a new builder, but keeps the memory which has
+   * already been allocated.
+   *
+   * @param base The path where the builder starts.
+   */
+  void assign(const char *base)
+  {
+    struct cwk_segment segment;
+    size_t length;
+
+    // The root of the base stays in the buffer until the next assignment. We
+    // need to know whether it is absolute, since back segments can not go
+    // beyond it.
+    impl.get_root(base, &length);
+    root_length = length;
+    absolute = impl.is_root_absolute(base, length);
+    buffer.assign(base, length);
+    boundaries.clear();
+    had_segments = impl.get_first_segment(base, &segment);
+
+    // The base is normalized, so we only take the visible segments of it.
+    for (std::string_view segment : impl.visible_segments(base)) {
+      push_segment(segment);
+    }
+  }
+
+  /**
+   * @brief Removes the last segment of the path.
+   *
+   * @return Returns true if a segment was removed or false if there is none.
+   */
+  bool pop() noexcept
+  {
+    if (boundaries.empty()) {
+      return false;
+    }
+
+    // The boundary is the length of the path before the segment and its
+    // separator were added, so we can just cut it off.
+    buffer.resize(boundaries.back());
+    boundaries.pop_back();
+    return true;
+  }
+
+  /**
+   * @brief Removes all segments, so only the root of the base is left.
+   */
+  void clear() noexcept
+  {
+    buffer.resize(root_length);
+    boundaries.clear();
+  }
+
+  const char *c_str() const noexcept
+  {
+    return is_current() ? "." : buffer.c_str();
+  }
+
+  std::string_view view() const noexcept
+  {
+    return is_current() ? std::string_view(".") : std::string_view(buffer);
+  }
+
+  size_t length() const noexcept
+  {
+    return view().size();
+  }
+
+  size_t depth() const noexcept
+  {
+    return boundaries.size();
+  }
+
+  /**
+   * @brief Gets the last segment of the path.
+   *
+   * @return Returns the last segment or an empty view if there is none.
+   */
+  std::string_view basename() const noexcept
+  {
+    size_t begin;
+
+    if (boundaries.empty()) {
+      return std::string_view();
+    }
+
+    // The segment begins after the separator, unless it is the first one
+    // which directly follows the root.
+    begin = boundaries.back();
+    if (boundaries.size() > 1) {
+      ++begin;
+    }
+
+    return std::string_view(buffer).substr(begin);
+  }
+
+private:
+  T_IMPL impl;
+  std::string buffer;
+  std::vector<size_t> boundaries;
+  size_t root_length = 0;
+  bool absolute = false;
+  bool had_segments = false;
+
+  bool is_current() const noexcept
+  {
+    // Segments which all removed each other leave the current directory,
+    // which join writes as "." as well. A path which never had any segment
+    // stays empty.
+    return buffer.empty() && had_segments;
+  }
+
+  void push_segment(std::string_view segment)
+  {
+    // There is a separator between two segments, but never between the root
+    // and the first segment.
+    boundaries.push_back(buffer.size());
+    if (boundaries.size() > 1) {
+      buffer.push_back(impl.separators[impl.get_style()][0]);
+    }
+
+    buffer.append(segment);
+  }
+
+  void push_back_segment(std::string_view segment)
+  {
+    // A back segment removes the previous segment, unless that one is a back
+    // segment itself. Those remain on relative paths which go beyond their
+    // beginning, while absolute paths can not go beyond the root at all.
+    if (!boundaries.empty() && basename() != "..") {
+      pop();
+    } else if (!absolute) {
+      push_segment(segment);
+    }
+  }
+};
+
 using cwk = cwk_impl<cwk_dynamic>;
 using cwk_unix = cwk_impl<cwk_static<CWK_STYLE_UNIX>>;
-using cwk_windows = cwk_impl<cwk_static<CWK_STYLE_WINDOWS>>;
\ No newline at end of file
+using cwk_windows = cwk_impl<cwk_static<CWK_STYLE_WINDOWS>>;
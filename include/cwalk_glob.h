@@ -0,0 +1,1059 @@
+#pragma once
+
+#include <cwalk.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <ctype.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * The maximum amount of automaton states a glob set keeps in its cache. Once
+ * the limit is reached, the cache is dropped and built again while matching,
+ * which bounds the memory of sets with pathological patterns.
+ */
+#ifndef CWK_GLOB_MAX_STATES
+#define CWK_GLOB_MAX_STATES 4096
+#endif
+
+class cwk_glob_set;
+
+/**
+ * A glob is a compiled pattern which matches paths segment by segment. The
+ * segments are split with the separators of the path style, and compared case
+ * insensitively for the windows style. The following syntax is supported
+ * within a segment:
+ *
+ * "*" - any amount of characters
+ * "?" - a single character
+ * "[abc]", "[a-z]", "[!a]" - a single character of a class
+ *
+ * A segment which only consists of "**" matches any amount of segments,
+ * including none. A trailing globstar therefore matches a directory and
+ * everything below it. A pattern which does not contain any separator matches
+ * the last segment of a path at any depth, so "*.o" matches both "main.o" and
+ * "src/main.o". A pattern without any segment, like an empty one, matches
+ * nothing.
+ */
+class cwk_glob
+{
+public:
+  cwk_glob() = default;
+
+  template <typename T_IMPL>
+  cwk_glob(const T_IMPL &impl, const char *pattern)
+    : impl{impl.get_style()}
+  {
+    compile(pattern);
+  }
+
+  /**
+   * @brief Matches a path against the pattern.
+   *
+   * The path must be relative to the same directory as the pattern. Roots and
+   * special segments are not interpreted, they are matched like any other
+   * segment.
+   *
+   * @param path The path which will be matched.
+   * @return Returns true if the path matches or false otherwise.
+   */
+  bool match(const char *path) const
+  {
+    std::vector<uint32_t> positions, next;
+    struct cwk_segment segment;
+    bool matched;
+
+    // We simulate the pattern like an automaton over segments. The positions
+    // are the pattern segments which may match the next path segment.
+    add_position(&positions, 0);
+    if (!impl.get_first_segment(path, &segment)) {
+      return false;
+    }
+
+    do {
+      matched = step(positions, std::string_view(segment.begin, segment.size),
+        &next);
+      positions.swap(next);
+    } while (!positions.empty() && impl.get_next_segment(&segment));
+
+    // The loop only ends early if no position is left, so the last step
+    // decides about the whole path.
+    return matched;
+  }
+
+  /**
+   * @brief Advances a set of positions by one segment.
+   *
+   * This function is the building block for incremental matching while
+   * walking a tree. The positions are indices of the pattern segments which
+   * are still able to match, the initial set is returned by start.
+   *
+   * @param positions The current positions.
+   * @param segment The segment which will be consumed.
+   * @param next The positions after consuming the segment.
+   * @return Returns true if the pattern fully matched after the segment.
+   */
+  bool step(const std::vector<uint32_t> &positions, std::string_view segment,
+    std::vector<uint32_t> *next) const
+  {
+    bool matched;
+
+    next->clear();
+    matched = false;
+    for (uint32_t position : positions) {
+      // The end of the pattern can't consume anything.
+      if (position == segments.size()) {
+        continue;
+      }
+
+      // A globstar consumes any segment and stays where it is, while a normal
+      // segment has to match and moves on.
+      if (segments[position].globstar) {
+        matched |= add_position(next, position);
+      } else if (match_segment(segments[position], segment)) {
+        matched |= add_position(next, position + 1);
+      }
+    }
+
+    return matched;
+  }
+
+  /**
+   * @brief Returns the initial positions before any segment is consumed.
+   */
+  std::vector<uint32_t> start() const
+  {
+    std::vector<uint32_t> positions;
+
+    add_position(&positions, 0);
+    return positions;
+  }
+
+  /**
+   * @brief Determines whether the positions are waiting for more segments.
+   *
+   * A set of positions may still match a deeper path if any of them points to
+   * a pattern segment. This is used to prune directories which can not
+   * contain any matches.
+   */
+  bool is_alive(const std::vector<uint32_t> &positions) const noexcept
+  {
+    for (uint32_t position : positions) {
+      if (position < segments.size()) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  friend class cwk_glob_set;
+
+  struct token
+  {
+    enum
+    {
+      LITERAL,
+      ANY,
+      STAR,
+      CLASS
+    } type;
+    std::string literal;
+    uint64_t set[4];
+  };
+
+  struct pattern_segment
+  {
+    std::vector<token> tokens;
+    std::string literal;
+    bool is_literal;
+    bool globstar;
+  };
+
+  cwk impl;
+  std::vector<pattern_segment> segments;
+
+  bool add_position(std::vector<uint32_t> *positions, uint32_t position) const
+  {
+    // Positions are added together with everything which is reachable
+    // without consuming a segment, which is everything after a globstar. The
+    // result tells whether the end of the pattern is reachable.
+    for (;;) {
+      positions->push_back(position);
+      if (position == segments.size()) {
+        return true;
+      }
+
+      if (!segments[position].globstar) {
+        return false;
+      }
+
+      ++position;
+    }
+  }
+
+  void compile(const char *pattern)
+  {
+    struct cwk_segment segment;
+    bool has_separator;
+    const char *c;
+
+    // A pattern without separators is matched at any depth, which is the
+    // same as having a globstar in front of it.
+    has_separator = false;
+    for (c = pattern; *c; ++c) {
+      if (impl.is_separator(c)) {
+        has_separator = true;
+        break;
+      }
+    }
+
+    if (!impl.get_first_segment(pattern, &segment)) {
+      return;
+    }
+
+    if (!has_separator) {
+      segments.push_back(pattern_segment{{}, "**", false, true});
+    }
+
+    do {
+      segments.push_back(
+        compile_segment(std::string_view(segment.begin, segment.size)));
+    } while (impl.get_next_segment(&segment));
+  }
+
+  pattern_segment compile_segment(std::string_view text) const
+  {
+    pattern_segment result;
+    token current;
+    size_t i;
+
+    result.globstar = text == "**";
+    result.is_literal = true;
+    if (result.globstar) {
+      result.is_literal = false;
+      return result;
+    }
+
+    // We split the segment into tokens, consecutive literal characters are
+    // merged into a single literal token.
+    for (i = 0; i < text.size(); ++i) {
+      if (text[i] == '*') {
+        current.type = token::STAR;
+      } else if (text[i] == '?') {
+        current.type = token::ANY;
+      } else if (text[i] == '[' && compile_class(text, &i, &current)) {
+        current.type = token::CLASS;
+      } else {
+        if (!result.tokens.empty() &&
+            result.tokens.back().type == token::LITERAL) {
+          result.tokens.back().literal += fold(text[i]);
+        } else {
+          current.type = token::LITERAL;
+          current.literal = std::string(1, fold(text[i]));
+          result.tokens.push_back(current);
+        }
+
+        continue;
+      }
+
+      // Two stars next to each other are the same as a single one.
+      result.is_literal = false;
+      if (current.type == token::STAR && !result.tokens.empty() &&
+          result.tokens.back().type == token::STAR) {
+        continue;
+      }
+
+      result.tokens.push_back(current);
+    }
+
+    if (result.is_literal) {
+      for (const token &t : result.tokens) {
+        result.literal += t.literal;
+      }
+    }
+
+    return result;
+  }
+
+  bool compile_class(std::string_view text, size_t *i, token *result) const
+  {
+    size_t j, begin;
+    unsigned char from, to, ch;
+    bool negated;
+
+    // We look for the end of the class first. If there is none, the bracket
+    // is treated as a literal character.
+    begin = *i + 1;
+    negated = begin < text.size() && (text[begin] == '!' || text[begin] == '^');
+    if (negated) {
+      ++begin;
+    }
+
+    j = begin;
+    if (j < text.size() && text[j] == ']') {
+      ++j;
+    }
+
+    while (j < text.size() && text[j] != ']') {
+      ++j;
+    }
+
+    if (j >= text.size()) {
+      return false;
+    }
+
+    memset(result->set, 0, sizeof(result->set));
+    for (size_t k = begin; k < j; ++k) {
+      from = (unsigned char)fold(text[k]);
+      to = from;
+      if (k + 2 < j && text[k + 1] == '-') {
+        to = (unsigned char)fold(text[k + 2]);
+        k += 2;
+      }
+
+      for (ch = from; ch <= to; ++ch) {
+        result->set[ch / 64] |= (uint64_t)1 << (ch % 64);
+        if (ch == 255) {
+          break;
+        }
+      }
+    }
+
+    if (negated) {
+      for (uint64_t &bits : result->set) {
+        bits = ~bits;
+      }
+    }
+
+    *i = j;
+    return true;
+  }
+
+  char fold(char c) const noexcept
+  {
+    // Windows paths are compared case insensitively, so we fold both the
+    // pattern and the path to lower case.
+    if (impl.get_style() == CWK_STYLE_WINDOWS) {
+      return (char)tolower((unsigned char)c);
+    }
+
+    return c;
+  }
+
+  bool match_literal(std::string_view literal, const char *str) const noexcept
+  {
+    size_t i;
+
+    for (i = 0; i < literal.size(); ++i) {
+      if (literal[i] != fold(str[i])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool match_token(const token &t, std::string_view text, size_t pos) const
+  {
+    // The caller makes sure that there is at least one character left.
+    unsigned char ch;
+
+    switch (t.type) {
+    case token::LITERAL:
+      return text.size() - pos >= t.literal.size() &&
+             match_literal(t.literal, text.data() + pos);
+    case token::ANY:
+      return true;
+    case token::CLASS:
+      ch = (unsigned char)fold(text[pos]);
+      return (t.set[ch / 64] >> (ch % 64)) & 1;
+    default:
+      return false;
+    }
+  }
+
+  bool match_segment(
+    const pattern_segment &pattern, std::string_view text) const
+  {
+    size_t t, pos, star_token, star_pos, length;
+
+    // Literal segments are by far the most common ones, so they get a quick
+    // comparison without looking at the tokens.
+    if (pattern.is_literal) {
+      return text.size() == pattern.literal.size() &&
+             match_literal(pattern.literal, text.data());
+    }
+
+    // Otherwise this is the usual wildcard matching with a single backtracking
+    // point, which is the last star we have seen.
+    t = 0;
+    pos = 0;
+    star_token = SIZE_MAX;
+    star_pos = 0;
+    while (pos < text.size() || t < pattern.tokens.size()) {
+      if (t < pattern.tokens.size()) {
+        const token &current = pattern.tokens[t];
+        if (current.type == token::STAR) {
+          star_token = t++;
+          star_pos = pos;
+          continue;
+        }
+
+        if (pos < text.size() && match_token(current, text, pos)) {
+          length = current.type == token::LITERAL ? current.literal.size() : 1;
+          pos += length;
+          ++t;
+          continue;
+        }
+      }
+
+      // Nothing matched here, so we let the last star consume one more
+      // character and try again from there.
+      if (star_token == SIZE_MAX || star_pos >= text.size()) {
+        return false;
+      }
+
+      t = star_token + 1;
+      pos = ++star_pos;
+    }
+
+    return true;
+  }
+};
+
+/**
+ * A glob set compiles many patterns into a single automaton, so a path is
+ * matched against all of them in a single pass over its characters. The
+ * patterns support the same syntax as a cwk_glob, and additionally braces like
+ * "*.{c,cpp}", which may be nested. The automaton is determinized lazily while
+ * paths are matched, so only states which are actually reached are built.
+ *
+ * Positions may be advanced by multiple threads at the same time. States and
+ * transitions which were built already are read without a lock, and only new
+ * ones are built under a lock. Matching whole paths may drop all states once
+ * there are too many of them, which invalidates all positions, so it must not
+ * be used by multiple threads at the same time.
+ */
+class cwk_glob_set
+{
+public:
+  cwk_glob_set() = default;
+
+  template <typename T_IMPL>
+  explicit cwk_glob_set(const T_IMPL &impl) : impl{impl.get_style()}
+  {
+  }
+
+  /**
+   * @brief Adds a pattern to the set.
+   *
+   * Adding a pattern drops all cached states of the automaton, so all
+   * patterns should be added before the first match.
+   *
+   * @param pattern The pattern which will be added.
+   * @param braces Whether braces are expanded or matched literally.
+   * @return Returns the index of the pattern, which is reported by match.
+   */
+  size_t add(const char *pattern, bool braces = true)
+  {
+    std::vector<std::string> expanded;
+
+    // Braces are expanded into separate patterns, which all report the same
+    // index. The automaton merges their common parts anyway.
+    if (braces) {
+      expand(pattern, &expanded);
+    } else {
+      expanded.push_back(pattern);
+    }
+
+    for (const std::string &alternative : expanded) {
+      compile(cwk_glob(impl, alternative.c_str()), count);
+    }
+
+    cache->size = 0;
+    return count++;
+  }
+
+  size_t size() const noexcept
+  {
+    return count;
+  }
+
+  /**
+   * @brief Determines whether any pattern matches a path.
+   *
+   * The root of the path is skipped and separators are handled like in
+   * cwk_glob, so repeated and trailing separators don't matter.
+   *
+   * @param path The path which will be matched.
+   * @return Returns true if at least one pattern matches or false otherwise.
+   */
+  bool match(const char *path) const
+  {
+    return !get_state(run(path)).accepts.empty();
+  }
+
+  /**
+   * @brief Determines all patterns which match a path.
+   *
+   * @param path The path which will be matched.
+   * @param matches The indices of the matching patterns in ascending order.
+   * @return Returns the amount of matching patterns.
+   */
+  size_t match(const char *path, std::vector<size_t> *matches) const
+  {
+    *matches = get_state(run(path)).accepts;
+    return matches->size();
+  }
+
+  /**
+   * @brief Returns the position before any segment is consumed.
+   *
+   * A position is the id of a state of the automaton, which stays valid until
+   * a pattern is added or a whole path is matched.
+   */
+  uint32_t start() const
+  {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+
+    if (cache->size == 0) {
+      reset();
+    }
+
+    return START;
+  }
+
+  /**
+   * @brief Advances a position by one segment.
+   *
+   * This is the building block for incremental matching while walking a
+   * tree, just like cwk_glob::step. The next position already expects
+   * another segment.
+   *
+   * @param position The current position.
+   * @param segment The segment which will be consumed.
+   * @param next The position after consuming the segment.
+   * @return Returns true if any pattern fully matched after the segment.
+   */
+  bool step(uint32_t position, std::string_view segment, uint32_t *next) const
+  {
+    uint32_t state;
+
+    state = position;
+    for (char c : segment) {
+      if (state == DEAD) {
+        break;
+      }
+
+      state = transition(state, (unsigned char)fold(c), false);
+    }
+
+    *next = transition(state, SEPARATOR, false);
+    return !get_state(state).accepts.empty();
+  }
+
+  /**
+   * @brief Determines whether a position is waiting for more segments.
+   *
+   * A position may still match a deeper path unless the automaton is dead.
+   * This is used to prune directories which can not contain any matches.
+   */
+  bool is_alive(uint32_t position) const noexcept
+  {
+    return position != DEAD;
+  }
+
+private:
+  static constexpr uint32_t NONE = UINT32_MAX;
+  static constexpr uint32_t DEAD = 0;
+  static constexpr uint32_t START = 1;
+  static constexpr size_t SEPARATOR = 256;
+  static constexpr size_t CHUNK_SIZE = 8;
+  static constexpr size_t CHUNKS = 29;
+
+  struct node
+  {
+    uint64_t set[4];
+    uint32_t target;
+    uint32_t separator_target;
+    std::vector<uint32_t> epsilon;
+    size_t accept;
+  };
+
+  struct dfa_state
+  {
+    std::vector<uint32_t> nodes;
+    std::vector<size_t> accepts;
+    std::atomic<uint32_t> transitions[SEPARATOR + 1];
+  };
+
+  /**
+   * The states are kept in chunks which double in size, so a state never
+   * moves once it was built and can be read while others are added.
+   */
+  struct state_cache
+  {
+    std::mutex mutex;
+    std::atomic<dfa_state *> chunks[CHUNKS] = {};
+    uint32_t size = 0;
+    std::map<std::vector<uint32_t>, uint32_t> lookup;
+    std::vector<uint64_t> visited;
+    uint64_t generation = 0;
+
+    ~state_cache()
+    {
+      for (std::atomic<dfa_state *> &chunk : chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+      }
+    }
+  };
+
+  cwk impl;
+  size_t count = 0;
+  std::vector<node> nodes;
+  std::vector<uint32_t> starts;
+  std::unique_ptr<state_cache> cache = std::make_unique<state_cache>();
+
+  static void expand(std::string_view pattern, std::vector<std::string> *result)
+  {
+    std::vector<size_t> commas;
+    size_t i, j, depth, begin;
+
+    // We look for the first brace which is closed again. Unbalanced braces
+    // are treated as literal characters.
+    for (i = 0; i < pattern.size(); ++i) {
+      if (pattern[i] != '{') {
+        continue;
+      }
+
+      commas.clear();
+      depth = 0;
+      for (j = i + 1; j < pattern.size(); ++j) {
+        if (pattern[j] == '{') {
+          ++depth;
+        } else if (pattern[j] == '}' && depth > 0) {
+          --depth;
+        } else if (pattern[j] == '}') {
+          break;
+        } else if (pattern[j] == ',' && depth == 0) {
+          commas.push_back(j);
+        }
+      }
+
+      if (j == pattern.size()) {
+        continue;
+      }
+
+      // Every alternative is combined with the prefix and the suffix, and
+      // then expanded again since it may contain more braces.
+      commas.push_back(j);
+      begin = i + 1;
+      for (size_t end : commas) {
+        expand(std::string(pattern.substr(0, i)) +
+                 std::string(pattern.substr(begin, end - begin)) +
+                 std::string(pattern.substr(j + 1)),
+          result);
+        begin = end + 1;
+      }
+
+      return;
+    }
+
+    result->push_back(std::string(pattern));
+  }
+
+  uint32_t add_node(const uint64_t *set, uint32_t target)
+  {
+    node result;
+
+    memcpy(result.set, set, sizeof(result.set));
+    result.target = target;
+    result.separator_target = NONE;
+    result.accept = SIZE_MAX;
+    nodes.push_back(std::move(result));
+    return (uint32_t)nodes.size() - 1;
+  }
+
+  void compile(const cwk_glob &glob, size_t index)
+  {
+    const uint64_t all[4] = {~0ull, ~0ull, ~0ull, ~0ull};
+    const uint64_t none[4] = {};
+    uint64_t single[4];
+    uint32_t next, current;
+    size_t i, remaining;
+    bool trailing;
+
+    if (glob.segments.empty()) {
+      return;
+    }
+
+    // The pattern is translated into an automaton over characters. Every
+    // consuming node moves on to the node which is created right after it,
+    // and separators are a symbol of their own.
+    starts.push_back((uint32_t)nodes.size());
+    for (i = 0; i < glob.segments.size(); ++i) {
+      const cwk_glob::pattern_segment &segment = glob.segments[i];
+      trailing = std::all_of(glob.segments.begin() + i, glob.segments.end(),
+        [](const cwk_glob::pattern_segment &s) { return s.globstar; });
+
+      // Segments are separated by a separator, except after a globstar which
+      // already consumes its separators. If only globstars follow, the
+      // separator is optional, so "a/**" matches "a" as well.
+      if (i > 0 && !glob.segments[i - 1].globstar) {
+        current = add_node(none, NONE);
+        nodes[current].separator_target = current + 1;
+        if (trailing) {
+          remaining = glob.segments.size() - i;
+          nodes[current].epsilon.push_back(
+            current + 1 + (uint32_t)remaining * 2);
+        }
+      }
+
+      // A globstar is a pair of nodes. The first one is at the beginning of a
+      // segment and may be skipped, the second one is within a segment and
+      // goes back to the first one after a separator.
+      if (segment.globstar) {
+        current = add_node(all, (uint32_t)nodes.size() + 1);
+        nodes[current].epsilon.push_back(current + 2);
+        next = add_node(all, current + 1);
+        nodes[next].separator_target = current;
+        if (trailing) {
+          nodes[next].epsilon.push_back(current + 2);
+        }
+
+        continue;
+      }
+
+      for (const cwk_glob::token &t : segment.tokens) {
+        switch (t.type) {
+        case cwk_glob::token::LITERAL:
+          for (char c : t.literal) {
+            memset(single, 0, sizeof(single));
+            single[(unsigned char)c / 64] |= (uint64_t)1
+                                             << ((unsigned char)c % 64);
+            add_node(single, (uint32_t)nodes.size() + 1);
+          }
+          break;
+        case cwk_glob::token::ANY:
+          add_node(all, (uint32_t)nodes.size() + 1);
+          break;
+        case cwk_glob::token::CLASS:
+          add_node(t.set, (uint32_t)nodes.size() + 1);
+          break;
+        case cwk_glob::token::STAR:
+          current = add_node(all, (uint32_t)nodes.size());
+          nodes[current].epsilon.push_back(current + 1);
+          break;
+        }
+      }
+    }
+
+    current = add_node(none, NONE);
+    nodes[current].accept = index;
+  }
+
+  void add_closure(std::vector<uint32_t> *set, uint32_t index) const
+  {
+    // The epsilon edges only point forward, so there are no cycles. The
+    // generation avoids adding the same node twice.
+    if (cache->visited[index] == cache->generation) {
+      return;
+    }
+
+    cache->visited[index] = cache->generation;
+    set->push_back(index);
+    for (uint32_t target : nodes[index].epsilon) {
+      add_closure(set, target);
+    }
+  }
+
+  dfa_state &get_state(uint32_t id) const noexcept
+  {
+    size_t chunk;
+
+    // Chunk k starts after the CHUNK_SIZE * (2^k - 1) states in front of it.
+    chunk = (size_t)std::bit_width((size_t)id / CHUNK_SIZE + 1) - 1;
+    return cache->chunks[chunk].load(std::memory_order_acquire)
+      [id - CHUNK_SIZE * (((size_t)1 << chunk) - 1)];
+  }
+
+  uint32_t add_state(std::vector<uint32_t> &&set) const
+  {
+    std::map<std::vector<uint32_t>, uint32_t>::iterator it;
+    size_t chunk;
+    uint32_t id;
+
+    std::sort(set.begin(), set.end());
+    it = cache->lookup.find(set);
+    if (it != cache->lookup.end()) {
+      return it->second;
+    }
+
+    // The chunks are kept when the states are dropped, so only a state which
+    // was never built before may need a new one.
+    id = cache->size;
+    chunk = (size_t)std::bit_width((size_t)id / CHUNK_SIZE + 1) - 1;
+    if (!cache->chunks[chunk].load(std::memory_order_relaxed)) {
+      cache->chunks[chunk].store(
+        new dfa_state[CHUNK_SIZE << chunk], std::memory_order_release);
+    }
+
+    dfa_state &state = get_state(id);
+    state.accepts.clear();
+    for (uint32_t index : set) {
+      if (nodes[index].accept != SIZE_MAX) {
+        state.accepts.push_back(nodes[index].accept);
+      }
+    }
+
+    std::sort(state.accepts.begin(), state.accepts.end());
+    state.accepts.erase(std::unique(state.accepts.begin(), state.accepts.end()),
+      state.accepts.end());
+    for (std::atomic<uint32_t> &transition : state.transitions) {
+      transition.store(NONE, std::memory_order_relaxed);
+    }
+
+    state.nodes = set;
+    cache->lookup.emplace(std::move(set), id);
+    ++cache->size;
+    return id;
+  }
+
+  void reset() const
+  {
+    std::vector<uint32_t> set;
+
+    // The dead state is the empty set, which can never be left again. It is
+    // not in the lookup, so the start state always gets the next id, even if
+    // it is empty.
+    cache->size = 0;
+    cache->lookup.clear();
+    add_state({});
+    cache->lookup.clear();
+    for (std::atomic<uint32_t> &transition : get_state(DEAD).transitions) {
+      transition.store(DEAD, std::memory_order_relaxed);
+    }
+
+    cache->visited.assign(nodes.size(), 0);
+    cache->generation = 1;
+    for (uint32_t start : starts) {
+      add_closure(&set, start);
+    }
+
+    add_state(std::move(set));
+  }
+
+  uint32_t transition(uint32_t state, size_t symbol, bool may_reset) const
+  {
+    std::vector<uint32_t> set;
+    uint32_t next;
+
+    // Transitions are only written once, and the state they point to is
+    // complete before that, so the common case does not need the lock.
+    next = get_state(state).transitions[symbol].load(std::memory_order_acquire);
+    if (next != NONE) {
+      return next;
+    }
+
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    next = get_state(state).transitions[symbol].load(std::memory_order_relaxed);
+    if (next != NONE) {
+      return next;
+    }
+
+    // This transition has not been built yet, so we simulate all nodes of
+    // the state on the symbol.
+    ++cache->generation;
+    for (uint32_t index : get_state(state).nodes) {
+      const node &current = nodes[index];
+      if (symbol == SEPARATOR) {
+        if (current.separator_target != NONE) {
+          add_closure(&set, current.separator_target);
+        }
+      } else if ((current.set[symbol / 64] >> (symbol % 64)) & 1) {
+        add_closure(&set, current.target);
+      }
+    }
+
+    // If the cache is full while a whole path is matched, we start over. The
+    // current state is not needed anymore, since the caller continues with
+    // the new one. Positions may still point to any state, so they keep all.
+    if (set.empty()) {
+      next = DEAD;
+    } else if (may_reset && cache->size >= CWK_GLOB_MAX_STATES) {
+      reset();
+      return add_state(std::move(set));
+    } else {
+      next = add_state(std::move(set));
+    }
+
+    get_state(state).transitions[symbol].store(next, std::memory_order_release);
+    return next;
+  }
+
+  uint32_t run(const char *path) const
+  {
+    size_t root_length;
+    uint32_t state;
+    bool separator, started;
+    const char *c;
+
+    if (cache->size == 0) {
+      reset();
+    }
+
+    // The root is not part of the match, just like with a cwk_glob. A
+    // separator is only fed to the automaton once another segment follows,
+    // which collapses repeated and ignores trailing separators.
+    impl.get_root(path, &root_length);
+    state = START;
+    separator = false;
+    started = false;
+    for (c = path + root_length; *c != '\0' && state != DEAD; ++c) {
+      if (impl.is_separator(c)) {
+        separator = started;
+        continue;
+      }
+
+      if (separator) {
+        state = transition(state, SEPARATOR, true);
+        separator = false;
+      }
+
+      state = transition(state, (unsigned char)fold(*c), true);
+      started = true;
+    }
+
+    // A path without any segment is never matched, not even by "**".
+    return started ? state : DEAD;
+  }
+
+  char fold(char c) const noexcept
+  {
+    if (impl.get_style() == CWK_STYLE_WINDOWS) {
+      return (char)tolower((unsigned char)c);
+    }
+
+    return c;
+  }
+};
+
+/**
+ * A walk filter decides which entries a walk reports and which directories it
+ * opens. Entries matching an exclude pattern are never reported, and excluded
+ * directories are never opened. If there are include patterns, only entries
+ * matching one of them are reported, and directories which can not contain any
+ * match are not opened. All patterns are relative to the root of the walk. The
+ * include and the exclude patterns are each matched by a glob set, whose
+ * states are shared by all threads of a walk.
+ */
+class cwk_walk_filter
+{
+public:
+  /**
+   * The state of a directory during a walk. It contains the positions of both
+   * glob sets after the path of the directory.
+   */
+  struct state
+  {
+    uint32_t include = 0;
+    uint32_t exclude = 0;
+  };
+
+  cwk_walk_filter() = default;
+
+  template <typename T_IMPL>
+  explicit cwk_walk_filter(const T_IMPL &impl) : includes{impl}, excludes{impl}
+  {
+  }
+
+  /**
+   * @brief Adds a pattern which entries have to match to be reported.
+   *
+   * Braces are expanded by default like in a cwk_glob_set, so "*.{c,h}"
+   * matches both extensions. Patterns which contain literal braces have to
+   * turn that off.
+   *
+   * @param pattern The pattern which will be added.
+   * @param braces Whether braces are expanded or matched literally.
+   */
+  void include(const char *pattern, bool braces = true)
+  {
+    includes.add(pattern, braces);
+  }
+
+  /**
+   * @brief Adds a pattern which excludes matching entries and everything
+   * below them.
+   *
+   * Braces are expanded by default, just like for include.
+   *
+   * @param pattern The pattern which will be added.
+   * @param braces Whether braces are expanded or matched literally.
+   */
+  void exclude(const char *pattern, bool braces = true)
+  {
+    excludes.add(pattern, braces);
+  }
+
+  bool empty() const noexcept
+  {
+    return includes.size() == 0 && excludes.size() == 0;
+  }
+
+  /**
+   * @brief Returns the state of the root directory of a walk.
+   */
+  state start() const
+  {
+    state result;
+
+    result.include = includes.start();
+    result.exclude = excludes.start();
+    return result;
+  }
+
+  /**
+   * @brief Decides about a single entry of a directory.
+   *
+   * @param parent The state of the directory which contains the entry.
+   * @param name The name of the entry.
+   * @param directory Whether the entry is a directory.
+   * @param child The state of the entry, only relevant for directories.
+   * @param report Set to whether the entry should be reported.
+   * @return Returns true if the walk should descend into the entry.
+   */
+  bool check(const state &parent, std::string_view name, bool directory,
+    state *child, bool *report) const
+  {
+    // An exclude match ends everything right away, since neither the entry
+    // nor anything below it will be visited.
+    if (excludes.size() > 0 &&
+        excludes.step(parent.exclude, name, &child->exclude)) {
+      *report = false;
+      return false;
+    }
+
+    if (includes.size() == 0) {
+      *report = true;
+      return directory;
+    }
+
+    *report = includes.step(parent.include, name, &child->include);
+    return directory && includes.is_alive(child->include);
+  }
+
+private:
+  cwk_glob_set includes;
+  cwk_glob_set excludes;
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cwalk.h>
+#include <cwalk_glob.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * An ignore matcher implements the rules of .gitignore files. The matcher
+ * follows a walk through the tree: push enters a directory and pop leaves it
+ * again, both without looking at any rules. Rules are added to the directory
+ * which was entered last and only apply to entries below it, with patterns
+ * anchored relative to that directory. The rules of all files in a directory
+ * are compiled into a single glob set, so an entry is checked against each
+ * file in one pass. The matcher caches state while matching, so it must not be
+ * used by multiple threads at the same time.
+ */
+class cwk_ignore
+{
+public:
+  template <typename T_IMPL>
+  explicit cwk_ignore(const T_IMPL &impl) : impl{impl.get_style()}
+  {
+  }
+
+  /**
+   * @brief Enters a directory.
+   *
+   * @param name The name of the directory within the current directory.
+   */
+  void push(std::string_view name)
+  {
+    boundaries.push_back(path.size());
+    if (!path.empty()) {
+      path += '/';
+    }
+
+    path.append(name);
+  }
+
+  /**
+   * @brief Leaves the current directory and drops its rules.
+   */
+  void pop()
+  {
+    if (boundaries.empty()) {
+      return;
+    }
+
+    if (!frames.empty() && frames.back().depth == boundaries.size()) {
+      frames.pop_back();
+    }
+
+    path.resize(boundaries.back());
+    boundaries.pop_back();
+  }
+
+  /**
+   * @brief Returns the amount of directories entered below the root.
+   */
+  size_t depth() const noexcept
+  {
+    return boundaries.size();
+  }
+
+  /**
+   * @brief Adds the rules of an ignore file to the current directory.
+   *
+   * The rules are given in the format of a .gitignore file. Empty lines and
+   * comments are skipped, a leading "!" negates a rule and a trailing
+   * separator restricts it to directories. Patterns with a separator at the
+   * beginning or in the middle are anchored to the current directory, all
+   * others match at any depth below it.
+   *
+   * @param rules The content of the ignore file.
+   */
+  void add_rules(std::string_view rules)
+  {
+    size_t begin, end;
+
+    // Rules of multiple files in the same directory end up in the same set,
+    // later rules take precedence just like within a file.
+    if (frames.empty() || frames.back().depth != boundaries.size()) {
+      frames.push_back(frame{boundaries.size(),
+        path.empty() ? 0 : path.size() + 1, cwk_glob_set(impl), {}});
+    }
+
+    for (begin = 0; begin < rules.size(); begin = end + 1) {
+      end = rules.find('\n', begin);
+      if (end == std::string_view::npos) {
+        end = rules.size();
+      }
+
+      add_rule(frames.back(), rules.substr(begin, end - begin));
+    }
+  }
+
+  /**
+   * @brief Determines whether an entry of the current directory is ignored.
+   *
+   * The last matching rule of the deepest directory decides. Entries within
+   * an ignored directory are not checked, since a walk never gets there.
+   *
+   * @param name The name of the entry.
+   * @param directory Whether the entry is a directory.
+   * @return Returns true if the entry is ignored or false otherwise.
+   */
+  bool is_ignored(std::string_view name, bool directory) const
+  {
+    size_t i, j;
+
+    // The path of the entry is built once. The path relative to the
+    // directory of an ignore file is just a suffix of it.
+    scratch = path;
+    if (!scratch.empty()) {
+      scratch += '/';
+    }
+
+    scratch.append(name);
+    for (i = frames.size(); i-- > 0;) {
+      const frame &current = frames[i];
+      current.set.match(scratch.c_str() + current.offset, &matches);
+      for (j = matches.size(); j-- > 0;) {
+        const rule &r = current.rules[matches[j]];
+        if (!r.directory_only || directory) {
+          return !r.negated;
+        }
+      }
+    }
+
+    return false;
+  }
+
+private:
+  struct rule
+  {
+    bool negated;
+    bool directory_only;
+  };
+
+  struct frame
+  {
+    size_t depth;
+    size_t offset;
+    cwk_glob_set set;
+    std::vector<rule> rules;
+  };
+
+  cwk impl;
+  std::string path;
+  std::vector<size_t> boundaries;
+  std::vector<frame> frames;
+  mutable std::string scratch;
+  mutable std::vector<size_t> matches;
+
+  void add_rule(frame &target, std::string_view line)
+  {
+    struct rule result;
+    std::string pattern;
+
+    // Trailing spaces are removed unless they are escaped, and so are line
+    // endings of files written on windows.
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+
+    while (!line.empty() && line.back() == ' ' &&
+           (line.size() < 2 || line[line.size() - 2] != '\\')) {
+      line.remove_suffix(1);
+    }
+
+    if (line.empty() || line[0] == '#') {
+      return;
+    }
+
+    // A leading backslash escapes a "!" or "#" which is part of the name.
+    result.negated = line[0] == '!';
+    if (result.negated ||
+        (line.size() > 1 && line[0] == '\\' &&
+          (line[1] == '!' || line[1] == '#'))) {
+      line.remove_prefix(1);
+    }
+
+    result.directory_only = false;
+    while (!line.empty() && impl.is_separator(&line.back())) {
+      result.directory_only = true;
+      line.remove_suffix(1);
+    }
+
+    if (line.empty()) {
+      return;
+    }
+
+    // The remaining pattern has the same anchoring rules as a glob, which
+    // only matches at any depth if there is no separator in it.
+    pattern = std::string(line);
+    if (pattern.size() >= 2 && pattern[pattern.size() - 2] == '\\' &&
+        pattern.back() == ' ') {
+      pattern.erase(pattern.size() - 2, 1);
+    }
+
+    // A trailing globstar of a glob also matches the directory in front of
+    // it, while in git it only matches what is inside. So "abc/**" becomes
+    // "abc/*/**", which needs at least one more segment.
+    if (pattern.size() > 2 && pattern.ends_with("**") &&
+        impl.is_separator(&pattern[pattern.size() - 3])) {
+      pattern.insert(pattern.size() - 2, "*/");
+    }
+
+    target.set.add(pattern.c_str(), false);
+    target.rules.push_back(result);
+  }
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cwalk.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <list>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+
+/**
+ * The default amount of directory descriptors an opener keeps open. Each of
+ * them counts against the descriptor limit of the process.
+ */
+#ifndef CWK_OPEN_CACHE_SIZE
+#define CWK_OPEN_CACHE_SIZE 256
+#endif
+
+/**
+ * An opener opens files relative to descriptors of their directories. The
+ * directories are kept open in a least recently used cache, keyed by their
+ * normalized path, so opening many files of the same directories only walks
+ * the directory path once. Paths are normalized lexically before they are
+ * split into the directory and the basename. The cache assumes that the
+ * directories are not replaced, and an opener must not be used by multiple
+ * threads at the same time.
+ */
+template <typename T_IMPL> class cwk_opener
+{
+public:
+  /**
+   * @brief Creates an opener.
+   *
+   * If a root is given, all paths are relative to it and are opened with
+   * openat2 and RESOLVE_BENEATH, so neither ".." nor symbolic links can
+   * leave it. Files are opened beneath their cached directory first, and if
+   * a link leaves that one, they are opened again beneath the root. This
+   * requires linux 5.6, older kernels fail with ENOSYS.
+   *
+   * @param impl The path style implementation.
+   * @param capacity The maximum amount of cached directories.
+   * @param root The directory which contains all paths, or NULL.
+   */
+  cwk_opener(const T_IMPL &impl, size_t capacity = CWK_OPEN_CACHE_SIZE,
+    const char *root = NULL)
+    : impl{impl}, capacity{capacity ? capacity : 1}, builder{impl.builder("")}
+  {
+    if (root) {
+      root_fd = ::open(root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+      root_failed = root_fd < 0;
+    }
+  }
+
+  cwk_opener(const cwk_opener &) = delete;
+  cwk_opener &operator=(const cwk_opener &) = delete;
+
+  ~cwk_opener()
+  {
+    clear();
+    if (root_fd >= 0) {
+      close(root_fd);
+    }
+  }
+
+  /**
+   * @brief Opens a file.
+   *
+   * The directory of the file is taken from the cache or opened and added to
+   * it, and the file is then opened relative to it.
+   *
+   * @param path The path of the file.
+   * @param flags The flags for openat, O_CLOEXEC is always added.
+   * @param mode The mode if a file is created.
+   * @return Returns the descriptor, or -1 if it could not be opened in which
+   * case errno is set.
+   */
+  int open(const char *path, int flags, mode_t mode = 0)
+  {
+    std::string_view basename, directory;
+    int dirfd, fd;
+
+    // Most paths are normalized already, so they can be split right away.
+    // All others go through the builder, which normalizes them first.
+    if (!split_normalized(path, &directory, &basename)) {
+      builder.assign(path);
+      path = builder.c_str();
+      basename = builder.basename();
+      if (basename.empty()) {
+        return open_at(
+          root_fd >= 0 ? root_fd : AT_FDCWD, builder.c_str(), flags, mode);
+      }
+
+      // The directory is everything in front of the basename, except for
+      // the separator between them. The basename is at the end of the
+      // builder, so it is null-terminated.
+      directory = builder.view().substr(0, builder.length() - basename.size());
+      if (directory.size() > 1) {
+        directory.remove_suffix(1);
+      }
+    }
+
+    dirfd = get_directory(directory);
+    if (dirfd == -1) {
+      return -1;
+    }
+
+    // A link may point to a sibling of its directory, which is still beneath
+    // the root. The kernel can only tell that from the root itself, which is
+    // why the whole path is opened from there in that case.
+    fd = open_at(dirfd, basename.data(), flags, mode);
+    if (fd < 0 && errno == EXDEV && root_fd >= 0 && dirfd != root_fd) {
+      fd = open_at(root_fd, path, flags, mode);
+    }
+
+    return fd;
+  }
+
+  /**
+   * @brief Returns the cached descriptor of a directory.
+   *
+   * The descriptor is opened with O_PATH and stays owned by the opener, it
+   * may be closed by any later call.
+   *
+   * @param directory The normalized path of the directory.
+   * @return Returns the descriptor, AT_FDCWD for the current directory if
+   * there is no root, or -1 on errors in which case errno is set.
+   */
+  int get_directory(std::string_view directory)
+  {
+    std::string key;
+    int fd;
+
+    if (directory.empty()) {
+      return root_fd >= 0 ? root_fd : root_failed ? -1 : AT_FDCWD;
+    }
+
+    // Files of the same directory are usually opened one after another, so
+    // the most recent directory is checked before hashing anything.
+    if (!entries.empty() && entries.front().key == directory) {
+      return entries.front().fd;
+    }
+
+    // A hit moves the directory to the front, so the last one is always the
+    // one which has not been used for the longest time. The lookup works on
+    // the view, so only a miss allocates the key.
+    auto it = lookup.find(directory);
+    if (it != lookup.end()) {
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->fd;
+    }
+
+    key = std::string(directory);
+    fd = open_at(root_fd >= 0 ? root_fd : AT_FDCWD, key.c_str(),
+      O_PATH | O_DIRECTORY, 0);
+    if (fd < 0) {
+      return -1;
+    }
+
+    if (entries.size() >= capacity) {
+      close(entries.back().fd);
+      lookup.erase(entries.back().key);
+      entries.pop_back();
+    }
+
+    entries.push_front(entry{key, fd});
+    lookup.emplace(std::move(key), entries.begin());
+    return fd;
+  }
+
+  /**
+   * @brief Closes all cached directories.
+   */
+  void clear() noexcept
+  {
+    for (const entry &e : entries) {
+      close(e.fd);
+    }
+
+    entries.clear();
+    lookup.clear();
+  }
+
+  /**
+   * @brief Returns the amount of cached directories.
+   */
+  size_t size() const noexcept
+  {
+    return entries.size();
+  }
+
+private:
+  struct entry
+  {
+    std::string key;
+    int fd;
+  };
+
+  struct key_hash
+  {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view key) const noexcept
+    {
+      return std::hash<std::string_view>{}(key);
+    }
+  };
+
+  T_IMPL impl;
+  size_t capacity;
+  cwk_path_builder<T_IMPL> builder;
+  int root_fd = -1;
+  bool root_failed = false;
+  std::list<entry> entries;
+  std::unordered_map<std::string, typename std::list<entry>::iterator,
+    key_hash, std::equal_to<>>
+    lookup;
+
+  bool split_normalized(const char *path, std::string_view *directory,
+    std::string_view *basename) const noexcept
+  {
+    const char *c, *segment, *last;
+    size_t root_length;
+
+    // We look for anything which the normalization would change, which is
+    // an empty segment, a "." or ".." segment or a trailing separator.
+    impl.get_root(path, &root_length);
+    segment = path + root_length;
+    last = NULL;
+    for (c = segment;; ++c) {
+      if (*c != '\0' && !impl.is_separator(c)) {
+        continue;
+      }
+
+      if (c == segment || (segment[0] == '.' &&
+                            (c - segment == 1 ||
+                              (c - segment == 2 && segment[1] == '.')))) {
+        return false;
+      }
+
+      if (*c == '\0') {
+        break;
+      }
+
+      last = c;
+      segment = c + 1;
+    }
+
+    // The directory of a file in the root keeps the root, while a relative
+    // file without directory has an empty one.
+    if (last) {
+      *directory = std::string_view(path, (size_t)(last - path));
+    } else {
+      *directory = std::string_view(path, root_length);
+    }
+
+    *basename = std::string_view(segment);
+    return true;
+  }
+
+  int open_at(int dirfd, const char *path, int flags, mode_t mode) const
+  {
+    struct open_how how;
+
+    if (root_failed) {
+      errno = EBADF;
+      return -1;
+    }
+
+    if (root_fd < 0) {
+      return openat(dirfd, path, flags | O_CLOEXEC, mode);
+    }
+
+    // Below a root, every step has to stay beneath the directory it starts
+    // from. Cached directories are opened from the root, so they are beneath
+    // it themselves.
+    memset(&how, 0, sizeof(how));
+    how.flags = (uint64_t)(flags | O_CLOEXEC);
+    how.mode = (flags & (O_CREAT | O_TMPFILE)) ? mode : 0;
+    how.resolve = RESOLVE_BENEATH;
+    return (int)syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+  }
+};
+
+#endif
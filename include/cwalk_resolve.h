@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cwalk.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
+#include <limits.h>
+#include <mutex>
+#include <shared_mutex>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The amount of shards of the resolution cache. Every shard has its own lock,
+ * so more shards mean less contention between threads.
+ */
+#ifndef CWK_RESOLVE_SHARDS
+#define CWK_RESOLVE_SHARDS 64
+#endif
+
+/**
+ * The resolver determines the canonical path of files on disk, just like
+ * realpath. The directories which were resolved along the way are kept in a
+ * cache which is shared by all threads using the resolver, so the siblings of
+ * a resolved path only cost a single readlink. The cache assumes that the
+ * directories don't change, it has to be cleared if they do.
+ */
+template <typename T_IMPL> class cwk_resolver
+{
+public:
+  cwk_resolver(const T_IMPL &impl) : impl{impl}
+  {
+  }
+
+  cwk_resolver(const cwk_resolver &) = delete;
+  cwk_resolver &operator=(const cwk_resolver &) = delete;
+
+  /**
+   * @brief Resolves a path to its canonical absolute path.
+   *
+   * This function follows all symbolic links of the path and resolves ".."
+   * after the links have been followed, so the result is the same as the one
+   * of realpath. Relative paths are resolved relative to the current working
+   * directory. The result will be written to a buffer, which might be
+   * truncated if the buffer is not large enough to hold the full path.
+   * However, the truncated result will always be null-terminated. This
+   * function may be called by multiple threads at the same time.
+   *
+   * @param path The path which will be resolved.
+   * @param buffer The buffer where the result will be written to.
+   * @param buffer_size The size of the result buffer.
+   * @return Returns the total amount of characters of the full path, or zero
+   * if the path could not be resolved, in which case errno is set.
+   */
+  size_t resolve_real(
+    const char *path, char *buffer, size_t buffer_size) const
+  {
+    std::string input, real;
+    char cwd[PATH_MAX];
+    size_t links;
+
+    // Relative paths are made absolute first. The working directory is not
+    // cached, since it may change between the calls. An empty path is not
+    // the working directory though.
+    if (*path == '\0') {
+      errno = ENOENT;
+      return 0;
+    } else if (impl.is_absolute(path)) {
+      input = path;
+    } else {
+      if (!getcwd(cwd, sizeof(cwd))) {
+        return 0;
+      }
+
+      input = std::string(cwd) + "/" + path;
+    }
+
+    links = 0;
+    if (!resolve_absolute(input.c_str(), &real, &links)) {
+      return 0;
+    }
+
+    if (buffer_size > 0) {
+      memcpy(buffer, real.data(),
+        real.size() < buffer_size ? real.size() : buffer_size - 1);
+      buffer[real.size() < buffer_size ? real.size() : buffer_size - 1] =
+        '\0';
+    }
+
+    return real.size();
+  }
+
+  /**
+   * @brief Drops all cached directories.
+   *
+   * This must not be called while another thread is resolving a path.
+   */
+  void clear()
+  {
+    for (shard &s : shards) {
+      s.entries.clear();
+    }
+  }
+
+private:
+  struct shard
+  {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, std::string> entries;
+  };
+
+  T_IMPL impl;
+  mutable shard shards[CWK_RESOLVE_SHARDS];
+
+  shard &get_shard(const std::string &key) const
+  {
+    return shards[std::hash<std::string>{}(key) % CWK_RESOLVE_SHARDS];
+  }
+
+  bool lookup(const std::string &key, std::string *real) const
+  {
+    shard &s = get_shard(key);
+    std::shared_lock<std::shared_mutex> lock(s.mutex);
+    auto it = s.entries.find(key);
+    if (it == s.entries.end()) {
+      return false;
+    }
+
+    *real = it->second;
+    return true;
+  }
+
+  void insert(const std::string &key, const std::string &real) const
+  {
+    shard &s = get_shard(key);
+    std::unique_lock<std::shared_mutex> lock(s.mutex);
+    s.entries.emplace(key, real);
+  }
+
+  /**
+   * A descriptor is an O_PATH descriptor of a resolved directory, which is
+   * closed once it goes out of scope.
+   */
+  struct descriptor
+  {
+    int fd = -1;
+
+    descriptor() = default;
+    descriptor(const descriptor &) = delete;
+    descriptor &operator=(const descriptor &) = delete;
+
+    ~descriptor()
+    {
+      reset(-1);
+    }
+
+    void reset(int value) noexcept
+    {
+      if (fd >= 0) {
+        close(fd);
+      }
+
+      fd = value;
+    }
+  };
+
+  bool resolve_segment(int at, const char *name, std::string_view segment,
+    bool needs_directory, std::string *real, size_t *links,
+    descriptor *directory) const
+  {
+    char target[PATH_MAX];
+    std::string candidate;
+    ssize_t length;
+    int fd;
+
+    // Most segments which have to be directories are directories, which we
+    // open right away. Everything else is either a link or an error.
+    if (needs_directory) {
+      fd = openat(at, name, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (fd >= 0) {
+        real->push_back('/');
+        real->append(segment);
+        directory->reset(fd);
+        return true;
+      } else if (errno != ENOTDIR && errno != ELOOP) {
+        return false;
+      }
+    }
+
+    length = readlinkat(at, name, target, sizeof(target) - 1);
+    if (length < 0 && errno == EINVAL && needs_directory) {
+      errno = ENOTDIR;
+      return false;
+    } else if (length < 0 && errno == EINVAL) {
+      real->push_back('/');
+      real->append(segment);
+      directory->reset(-1);
+      return true;
+    } else if (length < 0) {
+      return false;
+    }
+
+    // This is a link, so we resolve its target from the directory it is in.
+    // The amount of links is limited like in the kernel.
+    if (++*links > 40) {
+      errno = ELOOP;
+      return false;
+    }
+
+    target[length] = '\0';
+    if (target[0] != '/') {
+      candidate = *real + "/" + target;
+    } else {
+      candidate = target;
+    }
+
+    if (!resolve_absolute(candidate.c_str(), real, links)) {
+      return false;
+    }
+
+    if (*real == "/") {
+      real->clear();
+    }
+
+    // The target has to be a directory as well if there is anything behind
+    // the link.
+    directory->reset(-1);
+    if (needs_directory) {
+      directory->reset(openat(AT_FDCWD, real->empty() ? "/" : real->c_str(),
+        O_PATH | O_DIRECTORY | O_CLOEXEC));
+      if (directory->fd < 0) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool resolve_absolute(
+    const char *path, std::string *real, size_t *links) const
+  {
+    std::vector<std::string_view> segments;
+    struct cwk_segment segment;
+    std::string key, candidate;
+    descriptor directory;
+    size_t i, start;
+    bool trailing;
+    int at;
+
+    // A separator behind the last segment means that the path has to be a
+    // directory, just like a segment which is followed by another one.
+    trailing = false;
+    if (impl.get_first_segment(path, &segment)) {
+      do {
+        segments.push_back(std::string_view(segment.begin, segment.size));
+      } while (impl.get_next_segment(&segment));
+
+      trailing = *segment.end != '\0';
+    }
+
+    // The resolved path is kept without the root, so the root itself is an
+    // empty string. The key of a directory is the lexical path which leads
+    // to it, without any current directory segments. Siblings share the same
+    // directory, so we try that one first and walk from the root otherwise.
+    real->clear();
+    start = 0;
+    for (i = 0; i + 1 < segments.size(); ++i) {
+      if (segments[i] != ".") {
+        key += '/';
+        key.append(segments[i]);
+      }
+    }
+
+    if (!key.empty() && lookup(key, real)) {
+      start = segments.size() - 1;
+    } else {
+      key.clear();
+      real->clear();
+    }
+
+    // The descriptor belongs to the resolved path, so every segment is looked
+    // up relative to its directory. Directories from the cache don't have a
+    // descriptor, the next segment is looked up with its whole path then.
+    for (i = start; i < segments.size(); ++i) {
+      if (segments[i] == ".") {
+        continue;
+      }
+
+      key += '/';
+      key.append(segments[i]);
+      if (i + 1 < segments.size() && lookup(key, real)) {
+        directory.reset(-1);
+        continue;
+      }
+
+      if (directory.fd >= 0) {
+        candidate.assign(segments[i]);
+        at = directory.fd;
+      } else {
+        candidate = *real + "/";
+        candidate.append(segments[i]);
+        at = AT_FDCWD;
+      }
+
+      // Going back is only done on the resolved path, which is why ".."
+      // behind a link does not simply remove the link. The resolved path is
+      // always a directory here, so the kernel can go back from it as well.
+      if (segments[i] == "..") {
+        real->resize(real->rfind('/') == std::string::npos
+                       ? 0
+                       : real->rfind('/'));
+        if (directory.fd >= 0) {
+          directory.reset(openat(
+            directory.fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC));
+          if (directory.fd < 0) {
+            return false;
+          }
+        }
+      } else if (!resolve_segment(at, candidate.c_str(), segments[i],
+                   i + 1 < segments.size() || trailing, real, links,
+                   &directory)) {
+        return false;
+      }
+
+      // Only directories are cached, since files are rarely resolved twice
+      // but would make up most of the cache.
+      if (i + 1 < segments.size()) {
+        insert(key, *real);
+      }
+    }
+
+    if (real->empty()) {
+      *real = "/";
+    }
+
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,549 @@
+#pragma once
+
+#include <cwalk.h>
+#include <cwalk_stat.h>
+#include <cwalk_walk.h>
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * A snapshot entry describes a single entry of a walked tree. The path is
+ * relative to the root of the snapshot and uses slashes as separators. The
+ * type is one of the DT_* constants and the modification time is in
+ * nanoseconds since the epoch.
+ */
+struct cwk_snapshot_entry
+{
+  std::string path;
+  unsigned char type;
+  int64_t mtime;
+  uint64_t size;
+  uint64_t inode;
+};
+
+/**
+ * The delta between a snapshot and the tree on disk. Directories are only
+ * reported when they are added or removed, changes of their content are
+ * reported for the entries themselves. The amount of directories which had to
+ * be read is reported as well.
+ */
+struct cwk_snapshot_delta
+{
+  std::vector<std::string> added;
+  std::vector<std::string> removed;
+  std::vector<std::string> modified;
+  size_t directories_read;
+};
+
+/**
+ * A snapshot is the state of a directory tree at some point, which can be
+ * saved to disk and compared against the tree later. The comparison only
+ * reads directories whose modification time changed, all other directories
+ * still have the same entries. Every known entry is checked with a batched
+ * statx, which detects modified files.
+ *
+ * Modification times have the resolution of the kernel clock tick, so a
+ * directory or file which changed right after it was read may keep its time.
+ * Such entries have a time which is not older than the start of the scan.
+ * Directories like that are always read again, and files like that are
+ * always reported as modified.
+ *
+ * The file format starts with the magic "CWKSNAP1", the amount of entries, the
+ * time of the scan and the time of the root, followed by the entries sorted by
+ * path. The paths are front coded, so each entry only stores the part which
+ * differs from the previous path. All numbers are stored as variable length
+ * integers.
+ */
+class cwk_snapshot
+{
+public:
+  /**
+   * @brief Scans a whole tree.
+   *
+   * @param root The directory which will be scanned.
+   * @return Returns true if the root could be read or false otherwise. Errors
+   * below the root are ignored, unreadable directories appear empty.
+   */
+  bool scan(const char *root)
+  {
+    int root_fd;
+    bool result;
+
+    entries.clear();
+    directories_read = 0;
+    scan_time = get_time();
+    root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0 || !stat_root(root_fd)) {
+      if (root_fd >= 0) {
+        close(root_fd);
+      }
+
+      return false;
+    }
+
+    result = scan_directory(root_fd, ".", &entries, NULL);
+    close(root_fd);
+    std::sort(entries.begin(), entries.end(), compare_entries);
+    return result;
+  }
+
+  /**
+   * @brief Compares the snapshot against the tree and updates it.
+   *
+   * @param root The directory which will be compared, which is usually the
+   * same one which was scanned.
+   * @param delta The differences between the snapshot and the tree.
+   * @return Returns true if the root could be read or false otherwise.
+   */
+  bool rescan(const char *root, struct cwk_snapshot_delta *delta)
+  {
+    std::vector<cwk_snapshot_entry> added;
+    std::vector<const char *> paths;
+    std::vector<size_t> changed;
+    std::vector<bool> keep;
+    cwk_stat_batch batch;
+    cwk_stat_table table;
+    int64_t old_root_mtime, old_scan_time;
+    int root_fd;
+    size_t i;
+
+    delta->added.clear();
+    delta->removed.clear();
+    delta->modified.clear();
+    directories_read = 0;
+
+    old_root_mtime = root_mtime;
+    old_scan_time = scan_time;
+    scan_time = get_time();
+    root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0 || !stat_root(root_fd)) {
+      if (root_fd >= 0) {
+        close(root_fd);
+      }
+
+      return false;
+    }
+
+    // All known entries are checked at once. The paths are relative, so
+    // they are resolved from the root descriptor.
+    for (const cwk_snapshot_entry &e : entries) {
+      paths.push_back(e.path.c_str());
+    }
+
+    batch.fetch(paths.data(), paths.size(), &table, root_fd);
+    keep.assign(entries.size(), true);
+    for (i = 0; i < entries.size(); ++i) {
+      cwk_snapshot_entry &e = entries[i];
+      if (table.error[i] != 0) {
+        delta->removed.push_back(e.path);
+        keep[i] = false;
+        continue;
+      }
+
+      // An entry which changed its type is a different entry, so it is
+      // treated like it was removed and then added again.
+      if (IFTODT(table.mode[i]) != e.type) {
+        delta->removed.push_back(e.path);
+        keep[i] = false;
+        add_entry(root_fd, e.path, &added, delta);
+        continue;
+      }
+
+      // A directory whose entries changed has a new modification time,
+      // which is the only case where it has to be read.
+      if (e.type == DT_DIR) {
+        if (table.mtime[i] != e.mtime || e.mtime >= old_scan_time) {
+          changed.push_back(i);
+        }
+      } else if (table.mtime[i] != e.mtime || table.size[i] != e.size ||
+                 table.inode[i] != e.inode || e.mtime >= old_scan_time) {
+        delta->modified.push_back(e.path);
+      }
+
+      e.mtime = table.mtime[i];
+      e.size = table.size[i];
+      e.inode = table.inode[i];
+    }
+
+    if (root_mtime != old_root_mtime || old_root_mtime >= old_scan_time) {
+      find_added(root_fd, ".", &added, delta);
+    }
+
+    for (size_t index : changed) {
+      if (keep[index]) {
+        find_added(root_fd, entries[index].path, &added, delta);
+      }
+    }
+
+    close(root_fd);
+
+    // The new entries are merged with the ones which still exist, and the
+    // result is sorted again for the lookup and the front coding.
+    i = 0;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                    [&](const cwk_snapshot_entry &) { return !keep[i++]; }),
+      entries.end());
+    entries.insert(entries.end(), std::make_move_iterator(added.begin()),
+      std::make_move_iterator(added.end()));
+    std::sort(entries.begin(), entries.end(), compare_entries);
+    std::sort(delta->added.begin(), delta->added.end());
+    std::sort(delta->removed.begin(), delta->removed.end());
+    std::sort(delta->modified.begin(), delta->modified.end());
+    delta->directories_read = directories_read;
+    return true;
+  }
+
+  /**
+   * @brief Writes the snapshot to a file.
+   *
+   * @param file The path of the file which will be written.
+   * @return Returns true if the file was written or false otherwise.
+   */
+  bool save(const char *file) const
+  {
+    std::string buffer, previous;
+    size_t shared, written;
+    ssize_t result;
+    int fd;
+
+    buffer.assign("CWKSNAP1", 8);
+    write_number(&buffer, entries.size());
+    write_number(&buffer, (uint64_t)scan_time);
+    write_number(&buffer, (uint64_t)root_mtime);
+    previous.clear();
+    for (const cwk_snapshot_entry &e : entries) {
+      shared = 0;
+      while (shared < previous.size() && shared < e.path.size() &&
+             previous[shared] == e.path[shared]) {
+        ++shared;
+      }
+
+      write_number(&buffer, shared);
+      write_number(&buffer, e.path.size() - shared);
+      buffer.append(e.path, shared, std::string::npos);
+      buffer.push_back((char)e.type);
+      write_number(&buffer, (uint64_t)e.mtime);
+      write_number(&buffer, e.size);
+      write_number(&buffer, e.inode);
+      previous = e.path;
+    }
+
+    fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    for (written = 0; written < buffer.size(); written += (size_t)result) {
+      result = write(fd, buffer.data() + written, buffer.size() - written);
+      if (result <= 0) {
+        close(fd);
+        return false;
+      }
+    }
+
+    return close(fd) == 0;
+  }
+
+  /**
+   * @brief Reads a snapshot from a file.
+   *
+   * @param file The path of the file which will be read.
+   * @return Returns true if the file was read or false if it could not be
+   * read or is not a valid snapshot, in which case the snapshot is empty.
+   */
+  bool load(const char *file)
+  {
+    std::string buffer;
+    char chunk[65536];
+    ssize_t result;
+    int fd;
+
+    entries.clear();
+    fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+
+    while ((result = read(fd, chunk, sizeof(chunk))) > 0) {
+      buffer.append(chunk, (size_t)result);
+    }
+
+    close(fd);
+    if (result < 0 || !parse(buffer)) {
+      entries.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Finds an entry by its path relative to the root.
+   *
+   * @return Returns the entry or NULL if there is none.
+   */
+  const cwk_snapshot_entry *find(std::string_view path) const
+  {
+    auto it = std::lower_bound(entries.begin(), entries.end(), path,
+      [](const cwk_snapshot_entry &e, std::string_view p) {
+        return e.path < p;
+      });
+    if (it == entries.end() || it->path != path) {
+      return NULL;
+    }
+
+    return &*it;
+  }
+
+  const std::vector<cwk_snapshot_entry> &get_entries() const noexcept
+  {
+    return entries;
+  }
+
+private:
+  std::vector<cwk_snapshot_entry> entries;
+  int64_t scan_time = 0;
+  int64_t root_mtime = 0;
+  size_t directories_read = 0;
+
+  static bool compare_entries(
+    const cwk_snapshot_entry &a, const cwk_snapshot_entry &b)
+  {
+    return a.path < b.path;
+  }
+
+  static void write_number(std::string *buffer, uint64_t value)
+  {
+    while (value >= 0x80) {
+      buffer->push_back((char)(value | 0x80));
+      value >>= 7;
+    }
+
+    buffer->push_back((char)value);
+  }
+
+  static bool read_number(
+    const std::string &buffer, size_t *position, uint64_t *value)
+  {
+    unsigned shift;
+
+    *value = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+      if (*position >= buffer.size()) {
+        return false;
+      }
+
+      *value |= (uint64_t)(buffer[*position] & 0x7f) << shift;
+      if (!(buffer[(*position)++] & 0x80)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool parse(const std::string &buffer)
+  {
+    uint64_t count, shared, suffix, mtime;
+    cwk_snapshot_entry e;
+    std::string previous;
+    size_t position, i;
+
+    if (buffer.compare(0, 8, "CWKSNAP1") != 0) {
+      return false;
+    }
+
+    position = 8;
+    if (!read_number(buffer, &position, &count) ||
+        !read_number(buffer, &position, &mtime)) {
+      return false;
+    }
+
+    scan_time = (int64_t)mtime;
+    if (!read_number(buffer, &position, &mtime)) {
+      return false;
+    }
+
+    root_mtime = (int64_t)mtime;
+    for (i = 0; i < count; ++i) {
+      if (!read_number(buffer, &position, &shared) ||
+          !read_number(buffer, &position, &suffix) ||
+          shared > previous.size() || suffix > buffer.size() - position) {
+        return false;
+      }
+
+      e.path.assign(previous, 0, shared);
+      e.path.append(buffer, position, suffix);
+      position += suffix;
+      if (position >= buffer.size()) {
+        return false;
+      }
+
+      e.type = (unsigned char)buffer[position++];
+      if (!read_number(buffer, &position, &mtime) ||
+          !read_number(buffer, &position, &e.size) ||
+          !read_number(buffer, &position, &e.inode)) {
+        return false;
+      }
+
+      e.mtime = (int64_t)mtime;
+      previous = e.path;
+      entries.push_back(e);
+    }
+
+    return position == buffer.size();
+  }
+
+  static int64_t get_mtime(const struct stat &st) noexcept
+  {
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  }
+
+  static int64_t get_time() noexcept
+  {
+    struct timespec now;
+
+    // The kernel stamps files with the coarse clock, so that is the one we
+    // have to compare against.
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  }
+
+  bool stat_root(int root_fd)
+  {
+    struct stat st;
+
+    if (fstat(root_fd, &st) != 0) {
+      return false;
+    }
+
+    root_mtime = get_mtime(st);
+    return true;
+  }
+
+  static std::string join(const std::string &directory, std::string_view name)
+  {
+    std::string path;
+
+    // The entries of the root itself are stored without a prefix.
+    if (directory != ".") {
+      path = directory;
+      path += '/';
+    }
+
+    path.append(name);
+    return path;
+  }
+
+  bool scan_directory(int root_fd, const std::string &directory,
+    std::vector<cwk_snapshot_entry> *result, struct cwk_snapshot_delta *delta)
+  {
+    std::vector<std::string> subdirectories;
+    struct cwk_directory_entry dirent;
+    cwk_directory_reader reader;
+    cwk_snapshot_entry e;
+    struct stat st;
+
+    // Every entry needs a stat anyway for its time and size, which also
+    // tells us the type.
+    if (!reader.open(root_fd, directory.c_str())) {
+      return false;
+    }
+
+    ++directories_read;
+    while (reader.next(&dirent)) {
+      if (fstatat(reader.fd(), dirent.name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        continue;
+      }
+
+      e.path = join(directory, std::string_view(dirent.name,
+                                 dirent.name_length));
+      e.type = IFTODT(st.st_mode);
+      e.mtime = get_mtime(st);
+      e.size = (uint64_t)st.st_size;
+      e.inode = st.st_ino;
+      if (e.type == DT_DIR) {
+        subdirectories.push_back(e.path);
+      }
+
+      if (delta) {
+        delta->added.push_back(e.path);
+      }
+
+      result->push_back(std::move(e));
+    }
+
+    // The reader is closed before we descend, so only one directory is open
+    // at a time.
+    reader.close();
+    for (const std::string &subdirectory : subdirectories) {
+      scan_directory(root_fd, subdirectory, result, delta);
+    }
+
+    return true;
+  }
+
+  void add_entry(int root_fd, const std::string &path,
+    std::vector<cwk_snapshot_entry> *added, struct cwk_snapshot_delta *delta)
+  {
+    cwk_snapshot_entry e;
+    struct stat st;
+
+    if (fstatat(root_fd, path.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) {
+      return;
+    }
+
+    e.path = path;
+    e.type = IFTODT(st.st_mode);
+    e.mtime = get_mtime(st);
+    e.size = (uint64_t)st.st_size;
+    e.inode = st.st_ino;
+    delta->added.push_back(path);
+    added->push_back(std::move(e));
+    if (added->back().type == DT_DIR) {
+      scan_directory(root_fd, path, added, delta);
+    }
+  }
+
+  void find_added(int root_fd, const std::string &directory,
+    std::vector<cwk_snapshot_entry> *added, struct cwk_snapshot_delta *delta)
+  {
+    struct cwk_directory_entry dirent;
+    std::vector<std::string> names;
+    cwk_directory_reader reader;
+    std::string path;
+
+    // Only the names are compared here, the known entries have been checked
+    // with the batch already.
+    if (!reader.open(root_fd, directory.c_str())) {
+      return;
+    }
+
+    ++directories_read;
+    while (reader.next(&dirent)) {
+      path = join(directory, std::string_view(dirent.name, dirent.name_length));
+      if (!find(path)) {
+        names.push_back(std::move(path));
+      }
+    }
+
+    reader.close();
+    for (const std::string &name : names) {
+      add_entry(root_fd, name, added, delta);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cwalk.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * The amount of statx requests which are in flight at the same time. Every
+ * request needs a statx buffer of 256 bytes while it is in flight.
+ */
+#ifndef CWK_STAT_QUEUE_SIZE
+#define CWK_STAT_QUEUE_SIZE 256
+#endif
+
+/**
+ * A stat table contains the metadata of a list of paths, with one array per
+ * field so scans over a single field stay in the cache. The error is zero if
+ * the path was found, or the errno of the failed statx otherwise, in which
+ * case all other fields of that path are zero. The modification time is in
+ * nanoseconds since the epoch.
+ */
+struct cwk_stat_table
+{
+  std::vector<uint64_t> size;
+  std::vector<int64_t> mtime;
+  std::vector<uint64_t> inode;
+  std::vector<uint32_t> mode;
+  std::vector<int> error;
+
+  void resize(size_t count)
+  {
+    size.assign(count, 0);
+    mtime.assign(count, 0);
+    inode.assign(count, 0);
+    mode.assign(count, 0);
+    error.assign(count, 0);
+  }
+
+  size_t count() const noexcept
+  {
+    return error.size();
+  }
+};
+
+/**
+ * The stat batch fetches the metadata of many paths at once. The statx calls
+ * are submitted through an io_uring, so a whole batch costs a few system
+ * calls instead of one per path. If io_uring is not available, because the
+ * kernel is too old or it is disabled, every path is fetched with a
+ * synchronous statx instead. A batch must not be used by multiple threads at
+ * the same time.
+ */
+class cwk_stat_batch
+{
+public:
+  /**
+   * @brief Creates a batch with the given amount of requests in flight.
+   *
+   * A batch with zero entries never uses io_uring, which is mostly useful to
+   * compare against the fallback.
+   */
+  explicit cwk_stat_batch(unsigned entries = CWK_STAT_QUEUE_SIZE)
+  {
+    setup(entries);
+  }
+
+  cwk_stat_batch(const cwk_stat_batch &) = delete;
+  cwk_stat_batch &operator=(const cwk_stat_batch &) = delete;
+
+  ~cwk_stat_batch()
+  {
+    teardown();
+  }
+
+  /**
+   * @brief Determines whether the batch is submitted through io_uring.
+   *
+   * @return Returns true if io_uring is used or false if the synchronous
+   * fallback is used.
+   */
+  bool uses_io_uring() const noexcept
+  {
+    return ring >= 0;
+  }
+
+  /**
+   * @brief Fetches the metadata of a list of paths.
+   *
+   * The paths must stay valid until the function returns. Relative paths
+   * are resolved relative to the directory descriptor.
+   *
+   * @param paths The paths which will be checked.
+   * @param count The amount of paths.
+   * @param table The table which will receive one row for every path.
+   * @param dirfd The directory descriptor or AT_FDCWD.
+   * @param flags The statx flags, symbolic links are not followed by default.
+   */
+  void fetch(const char *const *paths, size_t count,
+    struct cwk_stat_table *table, int dirfd = AT_FDCWD,
+    int flags = AT_SYMLINK_NOFOLLOW)
+  {
+    table->resize(count);
+    if (ring >= 0) {
+      fetch_ring(paths, count, table, dirfd, flags);
+    } else {
+      fetch_sync(paths, 0, count, table, dirfd, flags);
+    }
+  }
+
+private:
+  int ring = -1;
+  unsigned entries = 0;
+  void *sq_pointer = MAP_FAILED;
+  void *cq_pointer = MAP_FAILED;
+  size_t sq_size = 0;
+  size_t cq_size = 0;
+  struct io_uring_sqe *sqes = (struct io_uring_sqe *)MAP_FAILED;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_cqe *cqes;
+  std::vector<struct statx> buffers;
+  std::vector<size_t> slots;
+  std::vector<unsigned> free_slots;
+
+  void setup(unsigned requested) noexcept
+  {
+    struct io_uring_params params;
+
+    // Every failure here simply leaves us with the synchronous fallback, so
+    // there is nothing to report.
+    memset(&params, 0, sizeof(params));
+    if (requested == 0) {
+      return;
+    }
+
+    ring = (int)syscall(__NR_io_uring_setup, requested, &params);
+    if (ring < 0) {
+      return;
+    }
+
+    entries = params.sq_entries;
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+
+    sq_pointer = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    if (sq_pointer == MAP_FAILED) {
+      teardown();
+      return;
+    }
+
+    cq_pointer = sq_pointer;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+      cq_pointer = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+      if (cq_pointer == MAP_FAILED) {
+        teardown();
+        return;
+      }
+    }
+
+    sqes = (struct io_uring_sqe *)mmap(NULL,
+      params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      teardown();
+      return;
+    }
+
+    sq_head = (unsigned *)((char *)sq_pointer + params.sq_off.head);
+    sq_tail = (unsigned *)((char *)sq_pointer + params.sq_off.tail);
+    sq_mask = (unsigned *)((char *)sq_pointer + params.sq_off.ring_mask);
+    sq_array = (unsigned *)((char *)sq_pointer + params.sq_off.array);
+    cq_head = (unsigned *)((char *)cq_pointer + params.cq_off.head);
+    cq_tail = (unsigned *)((char *)cq_pointer + params.cq_off.tail);
+    cq_mask = (unsigned *)((char *)cq_pointer + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_pointer + params.cq_off.cqes);
+    buffers.resize(entries);
+    slots.resize(entries);
+    free_slots.reserve(entries);
+  }
+
+  void teardown() noexcept
+  {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, entries * sizeof(struct io_uring_sqe));
+    }
+
+    if (cq_pointer != MAP_FAILED && cq_pointer != sq_pointer) {
+      munmap(cq_pointer, cq_size);
+    }
+
+    if (sq_pointer != MAP_FAILED) {
+      munmap(sq_pointer, sq_size);
+    }
+
+    if (ring >= 0) {
+      close(ring);
+    }
+
+    sqes = (struct io_uring_sqe *)MAP_FAILED;
+    sq_pointer = cq_pointer = MAP_FAILED;
+    ring = -1;
+  }
+
+  static void store(struct cwk_stat_table *table, size_t index,
+    const struct statx &st) noexcept
+  {
+    table->size[index] = st.stx_size;
+    table->mtime[index] =
+      (int64_t)st.stx_mtime.tv_sec * 1000000000 + st.stx_mtime.tv_nsec;
+    table->inode[index] = st.stx_ino;
+    table->mode[index] = st.stx_mode;
+    table->error[index] = 0;
+  }
+
+  static void fetch_sync(const char *const *paths, size_t begin, size_t end,
+    struct cwk_stat_table *table, int dirfd, int flags) noexcept
+  {
+    struct statx st;
+    size_t i;
+
+    for (i = begin; i < end; ++i) {
+      if (statx(dirfd, paths[i], flags, STATX_BASIC_STATS, &st) == 0) {
+        store(table, i, st);
+      } else {
+        table->error[i] = errno;
+      }
+    }
+  }
+
+  unsigned reap(const char *const *paths, struct cwk_stat_table *table,
+    int dirfd, int flags) noexcept
+  {
+    unsigned head, slot, reaped;
+    int res;
+
+    reaped = 0;
+    head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+      slot = (unsigned)cqe->user_data;
+      res = cqe->res;
+      ++head;
+      ++reaped;
+
+      // Kernels which know io_uring but not statx reject the operation,
+      // which we repeat synchronously.
+      if (res == 0) {
+        store(table, slots[slot], buffers[slot]);
+      } else if (res == -EINVAL || res == -EOPNOTSUPP) {
+        fetch_sync(paths, slots[slot], slots[slot] + 1, table, dirfd, flags);
+      } else {
+        table->error[slots[slot]] = -res;
+      }
+
+      free_slots.push_back(slot);
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+  }
+
+  void fetch_ring(const char *const *paths, size_t count,
+    struct cwk_stat_table *table, int dirfd, int flags) noexcept
+  {
+    struct io_uring_sqe *sqe;
+    unsigned tail, index, queued, slot;
+    size_t next, in_flight;
+    long result;
+
+    // The free slots have room for all entries since the setup, so this does
+    // not allocate.
+    free_slots.clear();
+    for (slot = 0; slot < entries; ++slot) {
+      free_slots.push_back(slot);
+    }
+
+    // We keep the ring full as long as there are paths left. Every slot owns
+    // a statx buffer, and the user data of a request is its slot.
+    next = 0;
+    in_flight = 0;
+    tail = *sq_tail;
+    while (next < count || in_flight > 0 ||
+           tail != __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) {
+      while (next < count && !free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = next;
+
+        index = tail & *sq_mask;
+        sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = dirfd;
+        sqe->addr = (uint64_t)(uintptr_t)paths[next];
+        sqe->len = STATX_BASIC_STATS;
+        sqe->off = (uint64_t)(uintptr_t)&buffers[slot];
+        sqe->statx_flags = (uint32_t)flags;
+        sqe->user_data = slot;
+        sq_array[index] = index;
+        ++tail;
+        ++next;
+      }
+
+      // The kernel must see the entries before it sees the new tail. Entries
+      // which the kernel did not take the last time are still in the ring, so
+      // all of them are submitted again. Only the ones it took are in flight.
+      __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+      queued = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+      result = syscall(__NR_io_uring_enter, ring, queued, 1,
+        IORING_ENTER_GETEVENTS, NULL, 0);
+      if (result > 0) {
+        in_flight += (size_t)result;
+      } else if (result < 0 && errno != EINTR && errno != EAGAIN &&
+                 errno != EBUSY) {
+        break;
+      }
+
+      in_flight -= reap(paths, table, dirfd, flags);
+    }
+
+    // If the ring broke down, everything is fetched again synchronously. The
+    // kernel still writes into the buffers of the requests in flight, so we
+    // wait for them before the ring is closed.
+    if (next < count || in_flight > 0 ||
+        tail != __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) {
+      drain(paths, table, dirfd, flags, in_flight);
+      teardown();
+      fetch_sync(paths, 0, count, table, dirfd, flags);
+    }
+  }
+
+  void drain(const char *const *paths, struct cwk_stat_table *table,
+    int dirfd, int flags, size_t in_flight) noexcept
+  {
+    long result;
+
+    in_flight -= reap(paths, table, dirfd, flags);
+    while (in_flight > 0) {
+      result = syscall(__NR_io_uring_enter, ring, 0, 1, IORING_ENTER_GETEVENTS,
+        NULL, 0);
+      if (result < 0 && errno != EINTR && errno != EAGAIN &&
+          errno != EBUSY) {
+        break;
+      }
+
+      in_flight -= reap(paths, table, dirfd, flags);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cwalk.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * A single call of a trace. The paths are the string arguments of the call in
+ * the order of the function parameters, the buffer size is zero for
+ * functions which do not write to a buffer.
+ */
+struct cwk_trace_record
+{
+  cwk_trace_operation operation;
+  cwk_path_style style;
+  size_t buffer_size;
+  std::vector<std::string> paths;
+};
+
+/**
+ * A trace holds the calls which were recorded by a program that was built
+ * with CWK_TRACE, see cwalk.h for the format. Traces can be replayed against
+ * any build of the library, which doesn't have to be built with CWK_TRACE
+ * itself.
+ */
+class cwk_trace
+{
+public:
+  /**
+   * @brief Reads a trace from a file.
+   *
+   * @param file The path of the file which will be read.
+   * @return Returns true if the file was read or false if it could not be
+   * read or is not a valid trace, in which case the trace is empty.
+   */
+  bool load(const char *file)
+  {
+    std::string buffer;
+    char chunk[65536];
+    size_t result;
+    FILE *f;
+
+    records.clear();
+    f = fopen(file, "rb");
+    if (f == NULL) {
+      return false;
+    }
+
+    while ((result = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+      buffer.append(chunk, result);
+    }
+
+    if (ferror(f) || !parse(buffer)) {
+      records.clear();
+      fclose(f);
+      return false;
+    }
+
+    fclose(f);
+    return true;
+  }
+
+  /**
+   * @brief Executes a recorded call again.
+   *
+   * The call is executed with the style of the record. The buffer size of the
+   * record is used if it fits into the submitted buffer, so truncated calls
+   * are truncated again.
+   *
+   * @param record The call which will be executed.
+   * @param buffer The buffer where results will be written to.
+   * @param buffer_size The size of the buffer.
+   * @return Returns the result of the call as a number: the length for
+   * functions which return one, and zero or one for the others.
+   */
+  static size_t replay(
+    const cwk_trace_record &record, char *buffer, size_t buffer_size) noexcept
+  {
+    const cwk cwk_path(record.style);
+    const char *stack[8], **paths, *result;
+    std::vector<const char *> list;
+    size_t i, length;
+
+    if (record.buffer_size < buffer_size) {
+      buffer_size = record.buffer_size;
+    }
+
+    // Only the joins of many paths need a list, which is just on the stack
+    // for the usual amount of paths.
+    paths = stack;
+    if (record.paths.size() >= sizeof(stack) / sizeof(stack[0])) {
+      list.resize(record.paths.size() + 1);
+      paths = list.data();
+    }
+
+    for (i = 0; i < record.paths.size(); ++i) {
+      paths[i] = record.paths[i].c_str();
+    }
+
+    paths[i] = NULL;
+    switch (record.operation) {
+    case CWK_TRACE_GET_ABSOLUTE:
+      return cwk_path.get_absolute(paths[0], paths[1], buffer, buffer_size);
+    case CWK_TRACE_GET_RELATIVE:
+      return cwk_path.get_relative(paths[0], paths[1], buffer, buffer_size);
+    case CWK_TRACE_JOIN:
+      return cwk_path.join(paths[0], paths[1], buffer, buffer_size);
+    case CWK_TRACE_JOIN_MULTIPLE:
+      return cwk_path.join_multiple(paths, buffer, buffer_size);
+    case CWK_TRACE_GET_ROOT:
+      cwk_path.get_root(paths[0], &length);
+      return length;
+    case CWK_TRACE_CHANGE_ROOT:
+      return cwk_path.change_root(paths[0], paths[1], buffer, buffer_size);
+    case CWK_TRACE_IS_ABSOLUTE:
+      return cwk_path.is_absolute(paths[0]);
+    case CWK_TRACE_IS_RELATIVE:
+      return cwk_path.is_relative(paths[0]);
+    case CWK_TRACE_GET_BASENAME:
+      cwk_path.get_basename(paths[0], &result, &length);
+      return length;
+    case CWK_TRACE_CHANGE_BASENAME:
+      return cwk_path.change_basename(paths[0], paths[1], buffer, buffer_size);
+    case CWK_TRACE_GET_DIRNAME:
+      cwk_path.get_dirname(paths[0], &length);
+      return length;
+    case CWK_TRACE_GET_EXTENSION:
+      return cwk_path.get_extension(paths[0], &result, &length) ? length : 0;
+    case CWK_TRACE_HAS_EXTENSION:
+      return cwk_path.has_extension(paths[0]);
+    case CWK_TRACE_CHANGE_EXTENSION:
+      return cwk_path.change_extension(paths[0], paths[1], buffer,
+        buffer_size);
+    case CWK_TRACE_NORMALIZE:
+      return cwk_path.normalize(paths[0], buffer, buffer_size);
+    case CWK_TRACE_GET_INTERSECTION:
+      return cwk_path.get_intersection(paths[0], paths[1]);
+    case CWK_TRACE_GUESS_STYLE:
+      return cwk_path.guess_style(paths[0]);
+    case CWK_TRACE_OPERATIONS:
+      break;
+    }
+
+    return 0;
+  }
+
+  const std::vector<cwk_trace_record> &get_records() const noexcept
+  {
+    return records;
+  }
+
+private:
+  std::vector<cwk_trace_record> records;
+
+  static bool read_number(
+    const std::string &buffer, size_t *position, uint64_t *value)
+  {
+    unsigned shift;
+
+    *value = 0;
+    for (shift = 0; shift < 64; shift += 7) {
+      if (*position >= buffer.size()) {
+        return false;
+      }
+
+      *value |= (uint64_t)(buffer[*position] & 0x7f) << shift;
+      if (!(buffer[(*position)++] & 0x80)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Returns the amount of paths the operation takes, or zero if it takes a
+   * list of any length.
+   */
+  static size_t get_path_count(cwk_trace_operation operation)
+  {
+    switch (operation) {
+    case CWK_TRACE_GET_ABSOLUTE:
+    case CWK_TRACE_GET_RELATIVE:
+    case CWK_TRACE_JOIN:
+    case CWK_TRACE_CHANGE_ROOT:
+    case CWK_TRACE_CHANGE_BASENAME:
+    case CWK_TRACE_CHANGE_EXTENSION:
+    case CWK_TRACE_GET_INTERSECTION:
+      return 2;
+    case CWK_TRACE_JOIN_MULTIPLE:
+      return 0;
+    default:
+      return 1;
+    }
+  }
+
+  bool parse(const std::string &buffer)
+  {
+    uint64_t operation, style, buffer_size, count, length;
+    cwk_trace_record record;
+    size_t position;
+
+    if (buffer.compare(0, 8, "CWKTRAC1") != 0) {
+      return false;
+    }
+
+    // Every record is validated, since a replay would read past the paths of
+    // a record which has fewer paths than its operation takes.
+    position = 8;
+    while (position < buffer.size()) {
+      if (!read_number(buffer, &position, &operation) ||
+          !read_number(buffer, &position, &style) ||
+          !read_number(buffer, &position, &buffer_size) ||
+          !read_number(buffer, &position, &count) ||
+          operation >= CWK_TRACE_OPERATIONS || style > CWK_STYLE_UNIX) {
+        return false;
+      }
+
+      record.operation = (cwk_trace_operation)operation;
+      record.style = (cwk_path_style)style;
+      record.buffer_size = (size_t)buffer_size;
+      if (get_path_count(record.operation) != 0 &&
+          count != get_path_count(record.operation)) {
+        return false;
+      }
+
+      record.paths.clear();
+      while (count-- > 0) {
+        if (!read_number(buffer, &position, &length) ||
+            length > buffer.size() - position) {
+          return false;
+        }
+
+        record.paths.emplace_back(buffer, position, (size_t)length);
+        position += (size_t)length;
+      }
+
+      records.push_back(record);
+    }
+
+    return true;
+  }
+};
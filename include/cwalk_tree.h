@@ -0,0 +1,476 @@
+#pragma once
+
+#include <cwalk.h>
+#include <cwalk_walk.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <map>
+#include <poll.h>
+#include <set>
+#include <string>
+#include <string_view>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The time in milliseconds an update waits for more events after the last
+ * one. A burst of events, like an extracted archive, is applied at once
+ * instead of one event at a time.
+ */
+#ifndef CWK_TREE_SETTLE_MS
+#define CWK_TREE_SETTLE_MS 5
+#endif
+
+/**
+ * A tree index keeps all entries of a directory tree in memory and follows
+ * the changes of the tree through inotify. The entries are keyed by their
+ * normalized path, which starts with the normalized root, so queries can be
+ * answered without any system calls. Paths in queries are normalized with the
+ * same style, and they have to be absolute if the root was absolute.
+ *
+ * Events only mark paths as dirty. Once a burst is over, every dirty path is
+ * checked with a single lstat, and directories are read again if they are
+ * new or were replaced. The index only stores the types of the entries, so it
+ * does not watch for modified contents. An index must not be used by
+ * multiple threads at the same time.
+ */
+template <typename T_IMPL> class cwk_tree_index
+{
+public:
+  cwk_tree_index(const T_IMPL &impl)
+    : impl{impl}, builder{impl.builder("")}, query{impl.builder("")}
+  {
+  }
+
+  cwk_tree_index(const cwk_tree_index &) = delete;
+  cwk_tree_index &operator=(const cwk_tree_index &) = delete;
+
+  ~cwk_tree_index()
+  {
+    close();
+  }
+
+  /**
+   * @brief Starts to index a directory tree.
+   *
+   * The watches are added before the directories are read, so entries which
+   * are created during the initial scan are either read or reported later.
+   *
+   * @param root The directory which will be indexed.
+   * @return Returns true if the root is indexed or false otherwise, in which
+   * case errno is set.
+   */
+  bool open(const char *root)
+  {
+    struct stat st;
+
+    close();
+    if (lstat(root, &st) != 0) {
+      return false;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+      errno = ENOTDIR;
+      return false;
+    }
+
+    descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (descriptor < 0) {
+      return false;
+    }
+
+    builder.assign(root);
+    root_path = builder.view();
+    entries.emplace(root_path, DT_DIR);
+    scan();
+    return true;
+  }
+
+  /**
+   * @brief Stops indexing and drops all entries.
+   */
+  void close() noexcept
+  {
+    if (descriptor >= 0) {
+      ::close(descriptor);
+    }
+
+    descriptor = -1;
+    entries.clear();
+    watches.clear();
+    directories.clear();
+  }
+
+  /**
+   * @brief Returns the inotify descriptor, which can be polled for changes.
+   */
+  int fd() const noexcept
+  {
+    return descriptor;
+  }
+
+  /**
+   * @brief Applies the changes of the tree to the index.
+   *
+   * This waits for the first event, and then for more events until none
+   * arrived for CWK_TREE_SETTLE_MS milliseconds.
+   *
+   * @param timeout The time in milliseconds to wait for the first event,
+   * zero to not wait at all or -1 to wait forever.
+   * @return Returns the amount of paths which were checked.
+   */
+  size_t update(int timeout = 0)
+  {
+    std::set<std::string> dirty;
+    bool overflow;
+
+    if (descriptor < 0) {
+      return 0;
+    }
+
+    overflow = false;
+    if (!wait(timeout)) {
+      return 0;
+    }
+
+    do {
+      read_events(&dirty, &overflow);
+    } while (wait(CWK_TREE_SETTLE_MS));
+
+    // If the kernel dropped events we don't know what changed, so the whole
+    // tree is read again.
+    if (overflow) {
+      dirty.clear();
+      dirty.insert(root_path);
+    }
+
+    return apply(dirty);
+  }
+
+  /**
+   * @brief Determines whether a path is in the index.
+   *
+   * @param path The path which will be looked up.
+   * @return Returns true if the path exists or false otherwise.
+   */
+  bool exists(const char *path)
+  {
+    query.assign(path);
+    return entries.find(query.view()) != entries.end();
+  }
+
+  /**
+   * @brief Gets the type of a path in the index.
+   *
+   * An entry whose type could not be determined is in the index as well, so
+   * exists has to be used to tell whether a path is there.
+   *
+   * @param path The path which will be looked up.
+   * @return Returns one of the DT_* constants, or DT_UNKNOWN if the type of
+   * the entry is not known or the path is not in the index.
+   */
+  unsigned char get_type(const char *path)
+  {
+    query.assign(path);
+    auto it = entries.find(query.view());
+    return it == entries.end() ? (unsigned char)DT_UNKNOWN : it->second;
+  }
+
+  /**
+   * @brief Lists all entries below a directory.
+   *
+   * The entries are listed recursively and sorted by their path, the
+   * directory itself is not listed. The callback receives the normalized
+   * path and the type of every entry.
+   *
+   * @param prefix The directory whose entries will be listed.
+   * @param fn The callback which is invoked for every entry.
+   * @return Returns the amount of listed entries.
+   */
+  template <typename T_FN> size_t list(const char *prefix, T_FN fn)
+  {
+    size_t count;
+
+    count = 0;
+    for (auto it = lower_bound(prefix); it != entries.end() &&
+                                        it->first.starts_with(query.view());
+         ++it) {
+      if (it->first == root_path) {
+        continue;
+      }
+
+      fn(std::string_view(it->first), it->second);
+      ++count;
+    }
+
+    return count;
+  }
+
+  /**
+   * @brief Returns the amount of entries in the index, including the root.
+   */
+  size_t size() const noexcept
+  {
+    return entries.size();
+  }
+
+private:
+  using entry_map = std::map<std::string, unsigned char, std::less<>>;
+
+  T_IMPL impl;
+  cwk_path_builder<T_IMPL> builder;
+  cwk_path_builder<T_IMPL> query;
+  std::string root_path;
+  int descriptor = -1;
+  entry_map entries;
+  std::unordered_map<int, std::string> watches;
+  std::unordered_map<std::string, int> directories;
+
+  static constexpr uint32_t watch_mask = IN_CREATE | IN_DELETE |
+                                         IN_MOVED_FROM | IN_MOVED_TO |
+                                         IN_DELETE_SELF | IN_MOVE_SELF |
+                                         IN_ONLYDIR | IN_DONT_FOLLOW;
+
+  typename entry_map::iterator lower_bound(const char *prefix)
+  {
+    // Pushing an empty name adds the separator behind the directory, unless
+    // it is a bare root which ends with one already. Every entry below the
+    // directory starts with that, and no other entry does. The entries below
+    // the current directory have no prefix at all, so the prefix matches the
+    // current directory itself as well.
+    query.assign(prefix);
+    if (query.depth() > 0) {
+      query.push_name("");
+    } else if (query.view() == ".") {
+      query.assign("");
+    }
+
+    auto it = entries.lower_bound(query.view());
+    if (it != entries.end() && it->first == query.view()) {
+      ++it;
+    }
+
+    return it;
+  }
+
+  bool wait(int timeout) const
+  {
+    struct pollfd p;
+
+    p.fd = descriptor;
+    p.events = POLLIN;
+    p.revents = 0;
+    while (poll(&p, 1, timeout) < 0) {
+      if (errno != EINTR) {
+        return false;
+      }
+    }
+
+    return (p.revents & POLLIN) != 0;
+  }
+
+  void read_events(std::set<std::string> *dirty, bool *overflow)
+  {
+    alignas(struct inotify_event) char buffer[16384];
+    const struct inotify_event *event;
+    ssize_t length;
+    size_t position;
+
+    while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+      for (position = 0; position < (size_t)length;
+           position += sizeof(struct inotify_event) + event->len) {
+        event = (const struct inotify_event *)(buffer + position);
+        if (event->mask & IN_Q_OVERFLOW) {
+          *overflow = true;
+          continue;
+        }
+
+        // The watches of removed directories are dropped by us already, so
+        // events of unknown watches are simply ignored.
+        auto it = watches.find(event->wd);
+        if (it == watches.end()) {
+          continue;
+        }
+
+        if (event->mask & IN_IGNORED) {
+          auto directory = directories.find(it->second);
+          if (directory != directories.end() &&
+              directory->second == event->wd) {
+            directories.erase(directory);
+          }
+
+          watches.erase(it);
+          continue;
+        }
+
+        // Changes of a directory itself are reported by its parent as well,
+        // except for the root which has no watched parent.
+        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+          if (it->second == root_path) {
+            dirty->insert(root_path);
+          }
+
+          continue;
+        }
+
+        if (event->len > 0) {
+          builder.assign(it->second.c_str());
+          builder.push_name(event->name);
+          dirty->emplace(builder.view());
+        }
+      }
+    }
+  }
+
+  size_t apply(const std::set<std::string> &dirty)
+  {
+    std::string skip;
+    struct stat st;
+    bool skipping;
+    size_t count;
+
+    // The dirty paths are sorted, so a directory comes before its entries.
+    // Once a directory was read again, its entries are up to date already.
+    count = 0;
+    skipping = false;
+    for (const std::string &path : dirty) {
+      if (skipping && path.starts_with(skip)) {
+        continue;
+      }
+
+      ++count;
+      auto it = entries.find(path);
+      if (lstat(path.c_str(), &st) != 0) {
+        if (it != entries.end()) {
+          erase(path);
+        }
+
+        continue;
+      }
+
+      // Entries which are not directories are only changed if they were
+      // replaced by something of another type.
+      if (it != entries.end() && it->second != DT_DIR &&
+          it->second == IFTODT(st.st_mode)) {
+        continue;
+      }
+
+      if (it != entries.end()) {
+        erase(path);
+      }
+
+      entries.emplace(path, IFTODT(st.st_mode));
+      if (S_ISDIR(st.st_mode)) {
+        builder.assign(path.c_str());
+        scan();
+        lower_bound(path.c_str());
+        skip = query.view();
+        skipping = true;
+      }
+    }
+
+    return count;
+  }
+
+  void erase(const std::string &path)
+  {
+    auto it = entries.find(path);
+    if (it->second == DT_DIR) {
+      unwatch(path);
+    }
+
+    entries.erase(it);
+
+    // All entries below the directory share the same prefix, so they are
+    // next to each other in the map.
+    it = lower_bound(path.c_str());
+    while (it != entries.end() && it->first.starts_with(query.view())) {
+      if (it->second == DT_DIR) {
+        unwatch(it->first);
+      }
+
+      it = entries.erase(it);
+    }
+  }
+
+  void unwatch(const std::string &path)
+  {
+    auto it = directories.find(path);
+    if (it == directories.end()) {
+      return;
+    }
+
+    // A renamed directory keeps its watch, which might belong to its new path
+    // already. The watch is only removed if it still belongs to this one.
+    auto watch = watches.find(it->second);
+    if (watch != watches.end() && watch->second == path) {
+      inotify_rm_watch(descriptor, it->second);
+      watches.erase(watch);
+    }
+
+    directories.erase(it);
+  }
+
+  void scan()
+  {
+    struct cwk_directory_entry dirent;
+    std::vector<std::string> names;
+    cwk_directory_reader reader;
+    int wd;
+
+    // The builder holds the path of the directory, which has to be watched
+    // before it is read. A directory which is gone already will be reported
+    // by its parent. Only directories can be watched, so this also tells us
+    // the type of entries which was not known before.
+    wd = inotify_add_watch(descriptor, builder.c_str(), watch_mask);
+    if (wd < 0) {
+      return;
+    }
+
+    // The same directory always gets the same watch, so a directory which
+    // was renamed takes its watch away from its old path.
+    auto watch = watches.find(wd);
+    if (watch != watches.end() && watch->second != builder.view()) {
+      auto directory = directories.find(watch->second);
+      if (directory != directories.end() && directory->second == wd) {
+        directories.erase(directory);
+      }
+    }
+
+    watches[wd] = builder.view();
+    directories[std::string(builder.view())] = wd;
+    entries[std::string(builder.view())] = DT_DIR;
+    if (!reader.open(AT_FDCWD, builder.c_str())) {
+      return;
+    }
+
+    // The reader falls back to fstatat for entries whose type the file system
+    // does not report. If that fails as well, the entry might still be a
+    // directory, so it is scanned like one.
+    while (reader.next(&dirent)) {
+      builder.push_name(std::string_view(dirent.name, dirent.name_length));
+      entries[std::string(builder.view())] = dirent.type;
+      if (dirent.type == DT_DIR || dirent.type == DT_UNKNOWN) {
+        names.emplace_back(dirent.name, dirent.name_length);
+      }
+
+      builder.pop();
+    }
+
+    // Only one directory is open at a time, the subdirectories are read once
+    // this one is closed.
+    reader.close();
+    for (const std::string &name : names) {
+      builder.push_name(name);
+      scan();
+      builder.pop();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,784 @@
+#pragma once
+
+#include <cwalk.h>
+#include <cwalk_glob.h>
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <dirent.h>
+#include <exception>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * The size of the buffer which is used to read directory entries. A larger
+ * buffer means less getdents64 calls for large directories, but every open
+ * directory reader keeps one of them.
+ */
+#ifndef CWK_DIRENT_BUFFER_SIZE
+#define CWK_DIRENT_BUFFER_SIZE 16384
+#endif
+
+/**
+ * A directory entry is a single entry read from a directory. The name is only
+ * valid until the next entry is read. The type is one of the DT_* constants of
+ * dirent.h. If the file system doesn't report it, the reader determines it with
+ * fstatat, and it is only DT_UNKNOWN if the entry disappeared in the meantime.
+ */
+struct cwk_directory_entry
+{
+  const char *name;
+  size_t name_length;
+  unsigned char type;
+  uint64_t inode;
+};
+
+/**
+ * A walk entry is a single entry found during a walk. The path is normalized
+ * and null-terminated, the name points to the last segment of the path. Both
+ * are only valid while the callback is running.
+ */
+struct cwk_walk_entry
+{
+  const char *path;
+  size_t path_length;
+  const char *name;
+  size_t name_length;
+  unsigned char type;
+  size_t depth;
+};
+
+/**
+ * The walk options configure how a directory tree is walked. A thread count of
+ * zero uses one thread per core. The depth of the entries within the root
+ * directory is one, entries deeper than the maximum depth are not visited.
+ * Symbolic links are reported, but never followed. The filter is evaluated on
+ * the names as they are read, so filtered directories are never opened. It
+ * must stay alive until the walk is finished.
+ */
+struct cwk_walk_options
+{
+  size_t threads = 0;
+  size_t max_depth = SIZE_MAX;
+  const cwk_walk_filter *filter = NULL;
+};
+
+/**
+ * The walk result contains the statistics of a finished walk. Directories
+ * which could not be opened or read are counted as errors and skipped. Entries
+ * which are rejected by the filter are not counted.
+ */
+struct cwk_walk_result
+{
+  size_t entries;
+  size_t directories;
+  size_t errors;
+};
+
+/**
+ * The directory reader reads the entries of a single directory using raw
+ * getdents64 calls, which return the type of most entries without a stat.
+ */
+class cwk_directory_reader
+{
+public:
+  cwk_directory_reader() = default;
+  cwk_directory_reader(const cwk_directory_reader &) = delete;
+  cwk_directory_reader &operator=(const cwk_directory_reader &) = delete;
+
+  ~cwk_directory_reader()
+  {
+    close();
+  }
+
+  /**
+   * @brief Opens a directory relative to another directory.
+   *
+   * @param dirfd The directory descriptor or AT_FDCWD.
+   * @param path The path of the directory which will be opened.
+   * @return Returns true if the directory was opened or false otherwise.
+   */
+  bool open(int dirfd, const char *path) noexcept
+  {
+    close();
+    descriptor = openat(dirfd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return descriptor >= 0;
+  }
+
+  void close() noexcept
+  {
+    if (descriptor >= 0) {
+      ::close(descriptor);
+    }
+
+    descriptor = -1;
+    position = 0;
+    size = 0;
+    failed = false;
+  }
+
+  /**
+   * @brief Reads the next entry of the directory.
+   *
+   * This function reads the next entry and skips the "." and ".." entries.
+   * If the file system does not report the type of an entry, it is determined
+   * with a single fstatat.
+   *
+   * @param entry The entry which will be written.
+   * @return Returns true if there was an entry or false at the end or on
+   * errors, which can be checked with has_failed.
+   */
+  bool next(struct cwk_directory_entry *entry) noexcept
+  {
+    struct dirent64 *dirent;
+    struct stat st;
+    long result;
+
+    for (;;) {
+      // We refill the buffer once all entries of it have been consumed. A
+      // result of zero means that we reached the end of the directory.
+      if (position >= size) {
+        result = syscall(
+          SYS_getdents64, descriptor, buffer, sizeof(buffer));
+        if (result <= 0) {
+          failed = result < 0;
+          position = size = 0;
+          return false;
+        }
+
+        position = 0;
+        size = (size_t)result;
+      }
+
+      dirent = (struct dirent64 *)(buffer + position);
+      position += dirent->d_reclen;
+
+      // The current and parent directory entries are never reported, since
+      // they are not part of the tree.
+      if (dirent->d_name[0] == '.' &&
+          (dirent->d_name[1] == '\0' ||
+            (dirent->d_name[1] == '.' && dirent->d_name[2] == '\0'))) {
+        continue;
+      }
+
+      entry->name = dirent->d_name;
+      entry->name_length = strlen(dirent->d_name);
+      entry->type = dirent->d_type;
+      entry->inode = dirent->d_ino;
+
+      // Some file systems don't fill in the type, so we have to ask for it.
+      // Entries which disappeared in the meantime are reported as unknown.
+      if (entry->type == DT_UNKNOWN &&
+          fstatat(descriptor, dirent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        entry->type = IFTODT(st.st_mode);
+      }
+
+      return true;
+    }
+  }
+
+  int fd() const noexcept
+  {
+    return descriptor;
+  }
+
+  bool has_failed() const noexcept
+  {
+    return failed;
+  }
+
+private:
+  int descriptor = -1;
+  size_t position = 0;
+  size_t size = 0;
+  bool failed = false;
+  alignas(struct dirent64) char buffer[CWK_DIRENT_BUFFER_SIZE];
+};
+
+/**
+ * The walker visits all entries of a directory tree in parallel. Every thread
+ * has its own queue of directories, and threads without work steal from the
+ * others. The paths are built with a path builder, so they are normalized by
+ * construction and never have to be normalized again.
+ */
+template <typename T_IMPL> class cwk_lazy_walk;
+
+template <typename T_IMPL> class cwk_walker
+{
+public:
+  cwk_walker(const T_IMPL &impl, const cwk_walk_options &options = {})
+    : impl{impl}, options{options}
+  {
+  }
+
+  /**
+   * @brief Walks a directory tree.
+   *
+   * This function walks all entries below the root directory and calls the
+   * callback for every one of them. The callback receives a cwk_walk_entry
+   * and returns whether the walker should descend into the entry, which is
+   * only relevant for directories. The callback is called concurrently from
+   * multiple threads if more than one thread is used, and must not throw.
+   *
+   * @param root The directory where the walk starts.
+   * @param fn The callback which is called for every entry.
+   * @return Returns the statistics of the walk.
+   */
+  template <typename T_FN>
+  cwk_walk_result walk(const char *root, T_FN &&fn) const
+  {
+    std::vector<std::thread> threads;
+    struct cwk_walk_result result;
+    struct shared_state state;
+    size_t i, count;
+
+    // Every thread gets its own queue. The root is normalized once and then
+    // placed in the queue of the first thread.
+    count = options.threads ? options.threads
+                            : std::thread::hardware_concurrency();
+    if (count == 0) {
+      count = 1;
+    }
+
+    state.queues = std::vector<worker_queue>(count);
+    state.pending = 1;
+    state.changes = 0;
+    state.queues[0].jobs.push_back(job{std::string(impl.builder(root).view()),
+      0, options.filter ? options.filter->start() : cwk_walk_filter::state{},
+      NULL});
+
+    // The calling thread takes part in the walk as the first worker, so a
+    // single threaded walk does not start any threads at all.
+    for (i = 1; i < count; ++i) {
+      threads.emplace_back([this, &state, &fn, i] { run(state, i, fn); });
+    }
+
+    run(state, 0, fn);
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+
+    result = {};
+    for (const worker_queue &queue : state.queues) {
+      result.entries += queue.result.entries;
+      result.directories += queue.result.directories;
+      result.errors += queue.result.errors;
+    }
+
+    return result;
+  }
+
+  /**
+   * @brief Creates a lazy walk of a directory tree.
+   *
+   * This function creates a lazy walk, which only reads directories when the
+   * caller asks for more entries. The walk is single threaded and depth
+   * first, the amount of threads in the options is ignored.
+   *
+   * @param root The directory where the walk starts.
+   * @return Returns the lazy walk.
+   */
+  cwk_lazy_walk<T_IMPL> lazy_walk(const char *root) const
+  {
+    return cwk_lazy_walk<T_IMPL>(impl, root, options);
+  }
+
+private:
+  /**
+   * A parent is a descriptor of a directory which stays open until all of its
+   * subdirectories have been opened relative to it.
+   */
+  struct parent
+  {
+    int fd;
+
+    explicit parent(int fd) noexcept : fd{fd}
+    {
+    }
+
+    parent(const parent &) = delete;
+    parent &operator=(const parent &) = delete;
+
+    ~parent()
+    {
+      close(fd);
+    }
+  };
+
+  struct job
+  {
+    std::string path;
+    size_t depth;
+    cwk_walk_filter::state filter;
+    std::shared_ptr<const parent> directory;
+  };
+
+  struct alignas(64) worker_queue
+  {
+    std::mutex mutex;
+    std::deque<job> jobs;
+    struct cwk_walk_result result = {};
+  };
+
+  struct shared_state
+  {
+    std::vector<worker_queue> queues;
+    std::atomic<size_t> pending;
+    std::atomic<uint32_t> changes;
+  };
+
+  T_IMPL impl;
+  cwk_walk_options options;
+
+  bool take_job(shared_state &state, size_t index, job *next) const
+  {
+    size_t i, victim;
+
+    // The own queue is used like a stack, which keeps the walk depth first and
+    // the paths in the cache.
+    {
+      std::lock_guard<std::mutex> lock(state.queues[index].mutex);
+      if (!state.queues[index].jobs.empty()) {
+        *next = std::move(state.queues[index].jobs.back());
+        state.queues[index].jobs.pop_back();
+        return true;
+      }
+    }
+
+    // Other queues are robbed from the front, which are the directories
+    // closest to the root and likely contain the most work.
+    for (i = 1; i < state.queues.size(); ++i) {
+      victim = (index + i) % state.queues.size();
+      std::lock_guard<std::mutex> lock(state.queues[victim].mutex);
+      if (!state.queues[victim].jobs.empty()) {
+        *next = std::move(state.queues[victim].jobs.front());
+        state.queues[victim].jobs.pop_front();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  template <typename T_FN>
+  void run(shared_state &state, size_t index, T_FN &fn) const
+  {
+    cwk_directory_reader reader;
+    uint32_t changes;
+    job next;
+
+    auto builder = impl.builder("");
+
+    // We keep going as long as there are directories which are either queued
+    // or being read by another thread, since those might queue more work.
+    // Threads without work sleep until a job is queued or the walk is over.
+    // The changes are read before looking for work, so a job which is queued
+    // in between wakes us up right away.
+    while (state.pending.load(std::memory_order_acquire) > 0) {
+      changes = state.changes.load(std::memory_order_acquire);
+      if (!take_job(state, index, &next)) {
+        if (state.pending.load(std::memory_order_acquire) > 0) {
+          state.changes.wait(changes, std::memory_order_acquire);
+        }
+
+        continue;
+      }
+
+      read_directory(state, index, next, reader, builder, fn);
+      next.directory.reset();
+      if (state.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        state.changes.fetch_add(1, std::memory_order_release);
+        state.changes.notify_all();
+      }
+    }
+  }
+
+  template <typename T_FN>
+  void read_directory(shared_state &state, size_t index, const job &current,
+    cwk_directory_reader &reader, cwk_path_builder<T_IMPL> &builder,
+    T_FN &fn) const
+  {
+    struct cwk_directory_entry dirent;
+    struct cwk_walk_entry entry;
+    worker_queue &queue = state.queues[index];
+    std::shared_ptr<const parent> directory;
+    cwk_walk_filter::state child;
+    std::string_view name;
+    bool descend, report;
+    int fd;
+
+    // The path of the directory is already normalized, so the builder only
+    // has to parse it once for all entries of this directory. Directories
+    // below the root are opened by their name relative to their parent, so
+    // the kernel does not have to look up the whole path again.
+    builder.assign(current.path.c_str());
+    if (current.directory
+          ? !reader.open(current.directory->fd, builder.basename().data())
+          : !reader.open(AT_FDCWD, builder.c_str())) {
+      ++queue.result.errors;
+      return;
+    }
+
+    ++queue.result.directories;
+    entry.depth = current.depth + 1;
+
+    while (reader.next(&dirent)) {
+      // The filter only looks at the name, so entries which are neither
+      // reported nor descended into don't even get a path.
+      descend = true;
+      report = true;
+      if (options.filter) {
+        descend = options.filter->check(current.filter,
+          std::string_view(dirent.name, dirent.name_length),
+          dirent.type == DT_DIR, &child, &report);
+        if (!descend && !report) {
+          continue;
+        }
+      }
+
+      // The name is pushed as a single segment, it can not contain any
+      // separators which are relevant on this system.
+      builder.push_name(std::string_view(dirent.name, dirent.name_length));
+      name = builder.basename();
+      entry.path = builder.c_str();
+      entry.path_length = builder.length();
+      entry.name = name.data();
+      entry.name_length = name.size();
+      entry.type = dirent.type;
+
+      if (report) {
+        ++queue.result.entries;
+        descend = fn(entry) && descend;
+      }
+
+      // The subdirectories share an O_PATH descriptor of this directory,
+      // which stays open after the reader is closed. If there are no
+      // descriptors left, they are opened by their whole path instead.
+      if (descend && dirent.type == DT_DIR && entry.depth < options.max_depth) {
+        if (!directory) {
+          fd = openat(reader.fd(), ".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+          if (fd >= 0) {
+            directory = std::make_shared<const parent>(fd);
+          }
+        }
+
+        state.pending.fetch_add(1, std::memory_order_relaxed);
+        {
+          std::lock_guard<std::mutex> lock(queue.mutex);
+          queue.jobs.push_back(job{std::string(builder.view()), entry.depth,
+            std::move(child), directory});
+        }
+
+        state.changes.fetch_add(1, std::memory_order_release);
+        state.changes.notify_one();
+      }
+
+      builder.pop();
+    }
+
+    if (reader.has_failed()) {
+      ++queue.result.errors;
+    }
+
+    reader.close();
+  }
+};
+
+/**
+ * A generator is a coroutine which yields references to values. The value is
+ * only valid until the generator is resumed again.
+ */
+template <typename T> class cwk_generator
+{
+public:
+  struct promise_type
+  {
+    const T *value;
+
+    cwk_generator get_return_object() noexcept
+    {
+      return cwk_generator(
+        std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_always final_suspend() noexcept
+    {
+      return {};
+    }
+
+    std::suspend_always yield_value(const T &yielded) noexcept
+    {
+      value = &yielded;
+      return {};
+    }
+
+    void return_void() noexcept
+    {
+    }
+
+    void unhandled_exception() noexcept
+    {
+      std::terminate();
+    }
+  };
+
+  class iterator
+  {
+  public:
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+
+    explicit iterator(std::coroutine_handle<promise_type> handle) noexcept
+      : handle{handle}
+    {
+    }
+
+    const T &operator*() const noexcept
+    {
+      return *handle.promise().value;
+    }
+
+    iterator &operator++()
+    {
+      handle.resume();
+      return *this;
+    }
+
+    void operator++(int)
+    {
+      ++*this;
+    }
+
+    friend bool operator==(const iterator &it, std::default_sentinel_t) noexcept
+    {
+      return !it.handle || it.handle.done();
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  cwk_generator() = default;
+
+  cwk_generator(cwk_generator &&other) noexcept : handle{other.handle}
+  {
+    other.handle = nullptr;
+  }
+
+  cwk_generator &operator=(cwk_generator &&other) noexcept
+  {
+    std::swap(handle, other.handle);
+    return *this;
+  }
+
+  ~cwk_generator()
+  {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  /**
+   * @brief Starts the generator and returns the iterator to the first value.
+   *
+   * This must only be called once, since the generator can not be restarted.
+   */
+  iterator begin()
+  {
+    if (handle) {
+      handle.resume();
+    }
+
+    return iterator(handle);
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+private:
+  std::coroutine_handle<promise_type> handle;
+
+  explicit cwk_generator(std::coroutine_handle<promise_type> handle) noexcept
+    : handle{handle}
+  {
+  }
+};
+
+/**
+ * A lazy walk visits the entries of a directory tree on demand. Nothing is
+ * read before the first entry is requested, and only one buffer per directory
+ * level is kept, so the memory is bounded by the depth of the tree. Calling
+ * skip after receiving a directory prevents that it is ever opened. The walk
+ * must not be moved once it has been started.
+ */
+template <typename T_IMPL> class cwk_lazy_walk
+{
+public:
+  cwk_lazy_walk(const T_IMPL &impl, const char *root,
+    const cwk_walk_options &options)
+    : impl{impl}, root{root}, options{options}, generator{generate()}
+  {
+  }
+
+  cwk_lazy_walk(const cwk_lazy_walk &) = delete;
+  cwk_lazy_walk &operator=(const cwk_lazy_walk &) = delete;
+
+  typename cwk_generator<cwk_walk_entry>::iterator begin()
+  {
+    return generator.begin();
+  }
+
+  std::default_sentinel_t end() const noexcept
+  {
+    return std::default_sentinel;
+  }
+
+  /**
+   * @brief Skips the subtree of the current entry.
+   *
+   * This function must be called after a directory has been received and
+   * before the walk is advanced. The directory will not be opened then.
+   */
+  void skip() noexcept
+  {
+    skip_requested = true;
+  }
+
+  /**
+   * @brief Returns the statistics of the entries walked so far.
+   */
+  const cwk_walk_result &get_result() const noexcept
+  {
+    return result;
+  }
+
+private:
+  T_IMPL impl;
+  std::string root;
+  cwk_walk_options options;
+  cwk_walk_result result = {};
+  bool skip_requested = false;
+  cwk_generator<cwk_walk_entry> generator;
+
+  cwk_generator<cwk_walk_entry> generate()
+  {
+    std::vector<std::unique_ptr<cwk_directory_reader>> readers;
+    std::vector<cwk_walk_filter::state> filters;
+    struct cwk_directory_entry dirent;
+    struct cwk_walk_entry entry;
+    cwk_walk_filter::state child;
+    cwk_directory_reader *reader;
+    std::string_view name;
+    size_t level;
+    bool descend, report;
+
+    // The path is built while we go up and down the tree. We always have one
+    // segment on the builder for every open directory below the root.
+    auto builder = impl.builder(root.c_str());
+    readers.push_back(std::make_unique<cwk_directory_reader>());
+    if (!readers[0]->open(AT_FDCWD, builder.c_str())) {
+      ++result.errors;
+      co_return;
+    }
+
+    // The filter keeps one state for every open directory, just like the
+    // readers.
+    ++result.directories;
+    filters.resize(1);
+    if (options.filter) {
+      filters[0] = options.filter->start();
+    }
+
+    level = 1;
+    while (level > 0) {
+      // Once a directory has no more entries, we go back up to the parent
+      // directory and remove the segment of this directory from the path.
+      reader = readers[level - 1].get();
+      if (!reader->next(&dirent)) {
+        if (reader->has_failed()) {
+          ++result.errors;
+        }
+
+        reader->close();
+        if (--level > 0) {
+          builder.pop();
+        }
+
+        continue;
+      }
+
+      descend = true;
+      report = true;
+      if (options.filter) {
+        descend = options.filter->check(filters[level - 1],
+          std::string_view(dirent.name, dirent.name_length),
+          dirent.type == DT_DIR, &child, &report);
+        if (!descend && !report) {
+          continue;
+        }
+      }
+
+      builder.push_name(std::string_view(dirent.name, dirent.name_length));
+      name = builder.basename();
+      entry.path = builder.c_str();
+      entry.path_length = builder.length();
+      entry.name = name.data();
+      entry.name_length = name.size();
+      entry.type = dirent.type;
+      entry.depth = level;
+
+      // This is where the consumer gets the entry. The walk continues only
+      // when the consumer asks for the next one.
+      skip_requested = false;
+      if (report) {
+        ++result.entries;
+        co_yield entry;
+      }
+
+      // Directories are opened relative to their parent, which is still open.
+      // The segment of the directory stays on the builder while we are in it.
+      if (dirent.type == DT_DIR && descend && !skip_requested &&
+          level < options.max_depth) {
+        if (readers.size() == level) {
+          readers.push_back(std::make_unique<cwk_directory_reader>());
+          filters.emplace_back();
+        }
+
+        if (options.filter) {
+          filters[level] = std::move(child);
+        }
+
+        if (readers[level]->open(reader->fd(), dirent.name)) {
+          ++result.directories;
+          ++level;
+          continue;
+        }
+
+        ++result.errors;
+      }
+
+      builder.pop();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,583 @@
+#include <atomic>
+#include <cwalk.h>
+#include <cwalk_open.h>
+#include <cwalk_stat.h>
+#include <cwalk_walk.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * The audit replaces malloc and the system calls of the file system features
+ * for the whole test program. The replacements forward to the C library and
+ * only count while an audit is running, so they don't change any other test.
+ * Allocations of the C++ library end up in malloc as well.
+ */
+enum audit_call
+{
+  AUDIT_OPENAT,
+  AUDIT_OPENAT2,
+  AUDIT_CLOSE,
+  AUDIT_GETDENTS,
+  AUDIT_FSTATAT,
+  AUDIT_STATX,
+  AUDIT_IO_URING,
+  AUDIT_OTHER,
+  AUDIT_CALLS
+};
+
+static std::atomic<bool> audit_active;
+static std::atomic<size_t> audit_allocations;
+static std::atomic<size_t> audit_counts[AUDIT_CALLS];
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+static void audit_allocation() noexcept
+{
+  if (audit_active.load(std::memory_order_relaxed)) {
+    audit_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+static void audit_call(audit_call call) noexcept
+{
+  if (audit_active.load(std::memory_order_relaxed)) {
+    audit_counts[call].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Returns the function of the C library which is replaced here. It is looked
+ * up before an audit starts, so the lookup itself is never counted.
+ */
+template <typename T_FN> static T_FN audit_next(T_FN *fn, const char *name)
+{
+  if (*fn == NULL) {
+    *fn = (T_FN)dlsym(RTLD_NEXT, name);
+  }
+
+  return *fn;
+}
+
+static int (*next_openat)(int, const char *, int, ...);
+static int (*next_close)(int);
+static int (*next_fstatat)(int, const char *, struct stat *, int);
+static int (*next_statx)(int, const char *, int, unsigned, struct statx *);
+static long (*next_syscall)(long, ...);
+
+static void audit_start()
+{
+  size_t i;
+
+  audit_next(&next_openat, "openat");
+  audit_next(&next_close, "close");
+  audit_next(&next_fstatat, "fstatat");
+  audit_next(&next_statx, "statx");
+  audit_next(&next_syscall, "syscall");
+  audit_allocations = 0;
+  for (i = 0; i < AUDIT_CALLS; ++i) {
+    audit_counts[i] = 0;
+  }
+
+  audit_active = true;
+}
+
+static size_t audit_stop()
+{
+  audit_active = false;
+  return audit_allocations;
+}
+
+static size_t audit_syscalls()
+{
+  size_t i, total;
+
+  total = 0;
+  for (i = 0; i < AUDIT_CALLS; ++i) {
+    total += audit_counts[i];
+  }
+
+  return total;
+}
+
+extern "C" void *malloc(size_t size) noexcept
+{
+  audit_allocation();
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+  audit_allocation();
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+  audit_allocation();
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+  audit_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(
+  void **ptr, size_t alignment, size_t size) noexcept
+{
+  audit_allocation();
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+
+extern "C" int openat(int dirfd, const char *path, int flags, ...)
+{
+  va_list args;
+  mode_t mode;
+
+  mode = 0;
+  if (flags & (O_CREAT | O_TMPFILE)) {
+    va_start(args, flags);
+    mode = (mode_t)va_arg(args, int);
+    va_end(args);
+  }
+
+  audit_call(AUDIT_OPENAT);
+  return audit_next(&next_openat, "openat")(dirfd, path, flags, mode);
+}
+
+extern "C" int close(int fd)
+{
+  audit_call(AUDIT_CLOSE);
+  return audit_next(&next_close, "close")(fd);
+}
+
+extern "C" int fstatat(
+  int dirfd, const char *path, struct stat *st, int flags) noexcept
+{
+  audit_call(AUDIT_FSTATAT);
+  return audit_next(&next_fstatat, "fstatat")(dirfd, path, st, flags);
+}
+
+extern "C" int statx(int dirfd, const char *path, int flags, unsigned mask,
+  struct statx *st) noexcept
+{
+  audit_call(AUDIT_STATX);
+  return audit_next(&next_statx, "statx")(dirfd, path, flags, mask, st);
+}
+
+extern "C" long syscall(long number, ...) noexcept
+{
+  va_list args;
+  long a[6];
+  size_t i;
+
+  // The system calls of the library take at most six arguments, which are
+  // all passed like longs.
+  va_start(args, number);
+  for (i = 0; i < 6; ++i) {
+    a[i] = va_arg(args, long);
+  }
+  va_end(args);
+
+  if (number == SYS_getdents64) {
+    audit_call(AUDIT_GETDENTS);
+  } else if (number == SYS_openat2) {
+    audit_call(AUDIT_OPENAT2);
+  } else if (number == __NR_io_uring_enter || number == __NR_io_uring_setup) {
+    audit_call(AUDIT_IO_URING);
+  } else {
+    audit_call(AUDIT_OTHER);
+  }
+
+  return audit_next(&next_syscall, "syscall")(
+    number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static const char *audit_paths[] = {"/var/log/../tmp/./file.txt",
+  "relative/./path/../name.tar.gz", "C:\\Windows\\..\\System32\\x.dll",
+  "\\\\server\\share\\dir\\..\\file", "a/b/c/d/e/f/g/../../../h", "", "/",
+  "../../up/../and/down/"};
+
+static std::string create_audit_tree(size_t directories, size_t files)
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::string path;
+  size_t i, j;
+  FILE *file;
+
+  if (!mkdtemp(root)) {
+    return "";
+  }
+
+  for (i = 0; i < directories; ++i) {
+    path = std::string(root) + "/d" + std::to_string(i);
+    mkdir(path.c_str(), 0755);
+    for (j = 0; j < files; ++j) {
+      file = fopen((path + "/f" + std::to_string(j)).c_str(), "w");
+      if (file) {
+        fclose(file);
+      }
+    }
+  }
+
+  return root;
+}
+
+static void remove_audit_tree(
+  const std::string &root, size_t directories, size_t files)
+{
+  std::string path;
+  size_t i, j;
+
+  for (i = 0; i < directories; ++i) {
+    path = root + "/d" + std::to_string(i);
+    for (j = 0; j < files; ++j) {
+      unlink((path + "/f" + std::to_string(j)).c_str());
+    }
+
+    rmdir(path.c_str());
+  }
+
+  rmdir(root.c_str());
+}
+
+int audit_stat()
+{
+  const size_t directories = 2, files = 10;
+  std::vector<const char *> paths;
+  std::vector<std::string> storage;
+  cwk_stat_table table;
+  std::string root;
+  size_t i, j;
+
+  root = create_audit_tree(directories, files);
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  for (i = 0; i < directories; ++i) {
+    for (j = 0; j < files; ++j) {
+      storage.push_back(
+        root + "/d" + std::to_string(i) + "/f" + std::to_string(j));
+    }
+  }
+
+  for (const std::string &path : storage) {
+    paths.push_back(path.c_str());
+  }
+
+  // The synchronous fallback makes exactly one statx per path.
+  cwk_stat_batch sync(0);
+  audit_start();
+  sync.fetch(paths.data(), paths.size(), &table);
+  audit_stop();
+  if (audit_counts[AUDIT_STATX] != paths.size() ||
+      audit_syscalls() != paths.size()) {
+    remove_audit_tree(root, directories, files);
+    return EXIT_FAILURE;
+  }
+
+  // With io_uring, a whole batch must cost less system calls than paths. The
+  // ring might not be available, in which case there is nothing to check.
+  cwk_stat_batch batch;
+  audit_start();
+  batch.fetch(paths.data(), paths.size(), &table);
+  audit_stop();
+  remove_audit_tree(root, directories, files);
+  if (batch.uses_io_uring() && (audit_counts[AUDIT_STATX] != 0 ||
+                                 audit_syscalls() >= paths.size())) {
+    return EXIT_FAILURE;
+  }
+
+  for (i = 0; i < table.count(); ++i) {
+    if (table.error[i] != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int audit_open()
+{
+  const cwk_unix cwk_path;
+  const size_t directories = 3, files = 5;
+  std::vector<std::string> paths;
+  std::string root;
+  size_t i, j, allocations;
+  bool valid;
+  int fd;
+
+  root = create_audit_tree(directories, files);
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  for (i = 0; i < directories; ++i) {
+    for (j = 0; j < files; ++j) {
+      paths.push_back(
+        root + "/d" + std::to_string(i) + "/f" + std::to_string(j));
+    }
+  }
+
+  // Every directory is opened once, and every file with a single openat
+  // relative to it. Once the directories are cached, only the files are
+  // opened and the cache must not allocate anything.
+  cwk_opener opener(cwk_path);
+  valid = true;
+  for (i = 0; i < 2; ++i) {
+    audit_start();
+    for (const std::string &path : paths) {
+      fd = opener.open(path.c_str(), O_RDONLY);
+      valid = valid && fd >= 0;
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+
+    allocations = audit_stop();
+    if (audit_counts[AUDIT_OPENAT] !=
+          paths.size() + (i == 0 ? directories : 0) ||
+        audit_counts[AUDIT_CLOSE] != paths.size() ||
+        audit_syscalls() != audit_counts[AUDIT_OPENAT] + paths.size() ||
+        (i > 0 && allocations != 0)) {
+      valid = false;
+    }
+  }
+
+  opener.clear();
+  remove_audit_tree(root, directories, files);
+  return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int audit_walk()
+{
+  const cwk_unix cwk_path;
+  const size_t directories = 4, files = 25;
+  cwk_walk_result result;
+  std::string root;
+  size_t dirs;
+
+  root = create_audit_tree(directories, files);
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Every directory is opened, read until getdents64 reports the end and
+  // closed again. The types come from getdents64, so entries only cost a
+  // fstatat on file systems which don't report them. Only the root has
+  // subdirectories, which are opened relative to one O_PATH descriptor.
+  audit_start();
+  result = cwk_walker(cwk_path, {1}).walk(
+    root.c_str(), [](const cwk_walk_entry &) { return true; });
+  audit_stop();
+  remove_audit_tree(root, directories, files);
+
+  dirs = directories + 1;
+  if (result.entries != directories * (files + 1) ||
+      result.directories != dirs || audit_counts[AUDIT_OPENAT] != dirs + 1 ||
+      audit_counts[AUDIT_CLOSE] != dirs + 1 ||
+      audit_counts[AUDIT_GETDENTS] != 2 * dirs ||
+      audit_counts[AUDIT_FSTATAT] > result.entries ||
+      audit_syscalls() != 4 * dirs + 2 + audit_counts[AUDIT_FSTATAT]) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int audit_builder()
+{
+  const char *names[] = {"src", "module", "../other", "./deep/er/", "file.c"};
+  const cwk_unix cwk_path;
+  cwk_path_builder builder = cwk_path.builder("/home/user/project");
+  size_t i, j, checksum;
+
+  // Once enough space is reserved, building paths must not allocate at all.
+  builder.reserve(4096, 256);
+  audit_start();
+  checksum = 0;
+  for (i = 0; i < 100; ++i) {
+    builder.assign("/home/user/project");
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      checksum += builder.push(names[j]);
+      checksum += builder.push_name("name.txt");
+      builder.pop();
+    }
+
+    while (builder.pop()) {
+    }
+
+    builder.clear();
+  }
+
+  if (audit_stop() != 0 || audit_syscalls() != 0 || checksum == 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int audit_expressions()
+{
+  struct cwk_segment_index_entry entries[32];
+  struct cwk_segment_index index;
+  struct cwk_segment segment;
+  char buffer[FILENAME_MAX];
+  size_t i, checksum;
+
+  // The expressions and views keep the paths they were created with and
+  // compute everything from them, and the segment index only uses the
+  // entries of the caller.
+  const cwk_unix cwk_path;
+  audit_start();
+  checksum = 0;
+  for (const char *path : audit_paths) {
+    checksum += cwk_path.absolute_expression("/base/dir", path)
+                  .with_extension("o")
+                  .write(buffer, sizeof(buffer));
+    checksum += cwk_path.expression("/base", path, "name")
+                  .with_root("/mnt/")
+                  .with_basename("other")
+                  .write(buffer, 8);
+    for (std::string_view s : cwk_path.normalized_view("/base", path)) {
+      checksum += s.size();
+    }
+
+    for (std::string_view s : cwk_path.segments(path)) {
+      checksum += s.size();
+    }
+
+    index.entries = entries;
+    index.capacity = sizeof(entries) / sizeof(entries[0]);
+    cwk_path.get_segment_index(path, &index);
+    for (i = 0; i < index.count; ++i) {
+      if (cwk_path.get_indexed_segment(&index, i, &segment)) {
+        checksum += segment.size;
+      }
+    }
+  }
+
+  if (audit_stop() != 0 || audit_syscalls() != 0 || checksum == 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int audit_deep()
+{
+  static char buffer[1 << 16];
+  const size_t depths[] = {70, 100, 1000, CWK_VISIBILITY_SEGMENTS};
+  std::string paths[sizeof(depths) / sizeof(depths[0])];
+  size_t i, j, checksum;
+
+  // Paths with more than 64 segments take the same route as the short ones,
+  // up to CWK_VISIBILITY_SEGMENTS and beyond it. They are generated before
+  // the audit starts.
+  const cwk_unix cwk_path;
+  for (i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i) {
+    paths[i] = "/";
+    for (j = 0; j < depths[i]; ++j) {
+      paths[i] += j % 3 == 2 ? "../" : "a/";
+    }
+  }
+
+  audit_start();
+  checksum = 0;
+  for (const std::string &a : paths) {
+    for (const std::string &b : paths) {
+      checksum += cwk_path.get_relative(a.c_str(), b.c_str(), buffer,
+        sizeof(buffer));
+      checksum += cwk_path.get_intersection(a.c_str(), b.c_str());
+      checksum += cwk_path.expression(a.c_str(), b.c_str(), "name")
+                    .with_extension("o")
+                    .write(buffer, sizeof(buffer));
+    }
+
+    for (std::string_view s : cwk_path.normalized_view(a.c_str())) {
+      checksum += s.size();
+    }
+  }
+
+  if (audit_stop() != 0 || audit_syscalls() != 0 || checksum == 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int audit_buffers()
+{
+  const cwk_path_style styles[] = {CWK_STYLE_UNIX, CWK_STYLE_WINDOWS};
+  const char *basename, *extension;
+  struct cwk_segment segment;
+  char buffer[FILENAME_MAX], small[4];
+  size_t length, checksum;
+
+  // Every function which writes to a buffer, with buffers which are large
+  // enough and ones which truncate the result.
+  audit_start();
+  checksum = 0;
+  for (cwk_path_style style : styles) {
+    const cwk cwk_path(style);
+    for (const char *a : audit_paths) {
+      for (const char *b : audit_paths) {
+        const char *paths[] = {a, b, a, NULL};
+        checksum += cwk_path.get_absolute(a, b, buffer, sizeof(buffer));
+        checksum += cwk_path.get_relative(a, b, buffer, sizeof(buffer));
+        checksum += cwk_path.join(a, b, small, sizeof(small));
+        checksum += cwk_path.join_multiple(paths, buffer, sizeof(buffer));
+        checksum += cwk_path.get_intersection(a, b);
+        checksum += cwk_path.change_root(a, b, small, sizeof(small));
+        checksum += cwk_path.change_basename(a, b, buffer, sizeof(buffer));
+        checksum += cwk_path.change_extension(a, b, small, sizeof(small));
+      }
+
+      checksum += cwk_path.normalize(a, buffer, sizeof(buffer));
+      checksum += cwk_path.normalize(a, small, sizeof(small));
+      cwk_path.get_root(a, &length);
+      checksum += length;
+      checksum += cwk_path.is_absolute(a) + cwk_path.is_relative(a);
+      cwk_path.get_basename(a, &basename, &length);
+      checksum += length;
+      cwk_path.get_dirname(a, &length);
+      checksum += length;
+      checksum += cwk_path.get_extension(a, &extension, &length);
+      checksum += cwk_path.has_extension(a);
+      checksum += cwk_path.guess_style(a);
+      if (cwk_path.get_last_segment(a, &segment)) {
+        do {
+          checksum += cwk_path.get_segment_type(&segment);
+        } while (cwk_path.get_previous_segment(&segment));
+      }
+
+      strcpy(buffer, a);
+      if (cwk_path.get_first_segment(buffer, &segment)) {
+        checksum += cwk_path.change_segment(&segment, "other", buffer,
+          sizeof(buffer));
+      }
+    }
+  }
+
+  if (audit_stop() != 0 || audit_syscalls() != 0 || checksum == 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#include <cwalk.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cwk cwk_path;
+
+int builder_push()
+{
+  char buffer[FILENAME_MAX];
+  size_t i, j, length;
+  const char *bases[] = {"/var/log", "relative/dir/", "", "/", "../up",
+    "a/..", "//double//sep/"};
+  const char *names[] = {"file", "dir/", "/abs", "a/b/c", "..", "../..",
+    "./x/./", "", "../../../../y"};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  for (i = 0; i < sizeof(bases) / sizeof(bases[0]); ++i) {
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      auto builder = cwk_path.builder(bases[i]);
+      length = cwk_path.join(bases[i], names[j], buffer, sizeof(buffer));
+      if (builder.push(names[j]) != length ||
+          strcmp(builder.c_str(), buffer) != 0) {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int builder_pop()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  auto builder = cwk_path.builder("/home/user");
+  if (builder.depth() != 2) {
+    return EXIT_FAILURE;
+  }
+
+  builder.push("projects/");
+  builder.push("cwalk");
+  if (builder.view() != "/home/user/projects/cwalk" ||
+      builder.basename() != "cwalk") {
+    return EXIT_FAILURE;
+  }
+
+  if (!builder.pop() || builder.view() != "/home/user/projects") {
+    return EXIT_FAILURE;
+  }
+
+  builder.pop();
+  builder.pop();
+  builder.pop();
+  if (builder.view() != "/" || builder.pop() || builder.basename() != "") {
+    return EXIT_FAILURE;
+  }
+
+  builder.push("etc");
+  if (strcmp(builder.c_str(), "/etc") != 0 || builder.basename() != "etc") {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int builder_current()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  // Segments which remove each other leave the current directory, just like
+  // the normalization does.
+  auto builder = cwk_path.builder("a/..");
+  if (builder.view() != "." || builder.length() != 1 || builder.depth() != 0) {
+    return EXIT_FAILURE;
+  }
+
+  builder.assign("a");
+  if (builder.push("..") != 1 || strcmp(builder.c_str(), ".") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  builder.push("b");
+  if (builder.view() != "b" || !builder.pop() || builder.view() != ".") {
+    return EXIT_FAILURE;
+  }
+
+  builder.assign("");
+  if (builder.view() != "" || builder.push("") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int builder_windows()
+{
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  auto builder = cwk_path.builder("C:\\Users/me\\");
+  builder.push("Documents/");
+  builder.push("\\file.txt");
+  if (builder.view() != "C:\\Users\\me\\Documents\\file.txt") {
+    return EXIT_FAILURE;
+  }
+
+  builder.clear();
+  if (builder.view() != "C:\\" || builder.depth() != 0) {
+    return EXIT_FAILURE;
+  }
+
+  auto relative = cwk_path.builder("C:");
+  relative.push("dir");
+  if (relative.view() != "C:dir") {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,336 @@
+#include <cwalk.h>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+/**
+ * Every input is measured in a small and a large version, the large one being
+ * this many times longer. The small one is run as many times more, so both
+ * measurements do the same amount of work if the work grows linearly.
+ */
+#define COMPLEXITY_FACTOR 8
+
+#ifdef CWK_STATS
+/**
+ * With the operation counters, the work is what the library counted. This
+ * does not depend on the machine, so the limit can be tight. Quadratic work
+ * would be COMPLEXITY_FACTOR times more.
+ */
+#define COMPLEXITY_LIMIT 1.5
+#else
+/**
+ * Otherwise the work is the processor time of the best of a few samples, which
+ * is not affected by other processes much. The limit is still generous, since
+ * the large inputs don't fit into the caches as well as the small ones.
+ */
+#define COMPLEXITY_LIMIT 4.0
+#define COMPLEXITY_SAMPLES 7
+
+/**
+ * Small inputs take too little time to be measured on their own, so every
+ * sample runs them often enough to cover at least this many bytes.
+ */
+#define COMPLEXITY_BYTES (1 << 18)
+#endif
+
+/**
+ * The visibility of segments is only determined in a single pass for the first
+ * CWK_VISIBILITY_SEGMENTS of them, so the large inputs of the functions which
+ * need it are kept within that. This is the amount of repetitions for a
+ * generator which adds the given amount of segments with each of them.
+ */
+#define VISIBLE_SIZE(segments)                                                 \
+  (CWK_VISIBILITY_SEGMENTS / COMPLEXITY_FACTOR / (segments) - 1)
+
+static const cwk_unix cwk_path;
+static char buffer[1 << 20];
+
+static std::string repeat(const char *part, size_t count)
+{
+  std::string result;
+
+  while (count-- > 0) {
+    result += part;
+  }
+
+  return result;
+}
+
+#ifdef CWK_STATS
+
+template <typename T_RUN>
+static double measure(T_RUN run, const std::string &input, size_t repeats)
+{
+  cwk_stats stats;
+  size_t i;
+
+  cwk_stats_reset();
+  for (i = 0; i < repeats; ++i) {
+    run(input);
+  }
+
+  stats = cwk_stats_snapshot();
+  return (double)(stats.segments + stats.bytes_scanned + stats.removal_scans);
+}
+
+template <typename T_GENERATE, typename T_RUN>
+static bool scales_linearly(
+  const char *name, size_t size, T_GENERATE generate, T_RUN run)
+{
+  double small, large;
+
+  small = measure(run, generate(size), COMPLEXITY_FACTOR);
+  large = measure(run, generate(size * COMPLEXITY_FACTOR), 1);
+  if (large > small * COMPLEXITY_LIMIT) {
+    fprintf(stderr, "%s: %zu times the input took %.1f times the work\n", name,
+      (size_t)COMPLEXITY_FACTOR, large * COMPLEXITY_FACTOR / small);
+    return false;
+  }
+
+  return true;
+}
+
+#else
+
+template <typename T_RUN>
+static double measure(T_RUN run, const std::string &input, size_t repeats)
+{
+  clock_t start;
+  size_t i;
+
+  start = clock();
+  for (i = 0; i < repeats; ++i) {
+    run(input);
+  }
+
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+template <typename T_GENERATE, typename T_RUN>
+static bool scales_linearly(
+  const char *name, size_t size, T_GENERATE generate, T_RUN run)
+{
+  std::string small_input, large_input;
+  double small, large, sample;
+  size_t i, rounds;
+
+  // The samples of both sizes take turns, so a busy machine slows down both of
+  // them. Only the best sample of each size is compared.
+  small_input = generate(size);
+  large_input = generate(size * COMPLEXITY_FACTOR);
+  rounds = 1 + COMPLEXITY_BYTES / large_input.size();
+  small = large = 0;
+  for (i = 0; i < COMPLEXITY_SAMPLES; ++i) {
+    sample = measure(run, small_input, COMPLEXITY_FACTOR * rounds);
+    if (i == 0 || sample < small) {
+      small = sample;
+    }
+
+    sample = measure(run, large_input, rounds);
+    if (i == 0 || sample < large) {
+      large = sample;
+    }
+  }
+
+  if (large > small * COMPLEXITY_LIMIT) {
+    fprintf(stderr, "%s: %zu times the input took %.1f times as long\n", name,
+      (size_t)COMPLEXITY_FACTOR, large * COMPLEXITY_FACTOR / small);
+    return false;
+  }
+
+  return true;
+}
+
+#endif
+
+static void normalize(const std::string &input)
+{
+  cwk_path.normalize(input.c_str(), buffer, sizeof(buffer));
+}
+
+static void relative(const std::string &input)
+{
+  cwk_path.get_relative(input.c_str(), "/x/y", buffer, sizeof(buffer));
+  cwk_path.get_relative("/x/y", input.c_str(), buffer, sizeof(buffer));
+}
+
+static void intersection(const std::string &input)
+{
+  cwk_path.get_intersection(input.c_str(), "/x/y");
+  cwk_path.get_intersection(input.c_str(), input.c_str());
+}
+
+static void visible(const std::string &input)
+{
+  auto range = cwk_path.visible_segments(input.c_str());
+  auto begin = range.begin();
+  auto it = std::ranges::next(begin, range.end());
+
+  while (it != begin) {
+    --it;
+  }
+}
+
+int complexity_pairs()
+{
+  size_t size = VISIBLE_SIZE(2);
+
+  auto generate = [](size_t n) { return "/" + repeat("a/../", n); };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, generate, relative) &&
+             scales_linearly("intersection", size, generate, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_backs()
+{
+  size_t size = VISIBLE_SIZE(1);
+
+  auto generate = [](size_t n) { return repeat("../", n) + "a"; };
+  auto absolute = [](size_t n) { return "/" + repeat("../", n) + "a"; };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, absolute, relative) &&
+             scales_linearly("intersection", size, absolute, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_nested()
+{
+  size_t size = VISIBLE_SIZE(2);
+
+  auto generate = [](size_t n) {
+    return "/" + repeat("a/", n) + repeat("../", n) + "b";
+  };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, generate, relative) &&
+             scales_linearly("intersection", size, generate, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_deep()
+{
+  size_t size = VISIBLE_SIZE(1);
+
+  // A deep path with a single back segment at the very end keeps almost all
+  // segments, but every one of them has to be checked against that one.
+  auto generate = [](size_t n) { return "/" + repeat("a/", n) + "b/.."; };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, generate, relative) &&
+             scales_linearly("intersection", size, generate, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_interleaved()
+{
+  size_t size = VISIBLE_SIZE(3);
+
+  // Every block keeps one segment and removes another one, so the segments
+  // which are kept and removed alternate all over the path.
+  auto generate = [](size_t n) { return "/" + repeat("a/b/../", n); };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, generate, relative) &&
+             scales_linearly("intersection", size, generate, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_interleaved_nested()
+{
+  size_t size = VISIBLE_SIZE(5);
+
+  auto generate = [](size_t n) { return "/" + repeat("a/b/c/../../", n); };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("relative", size, generate, relative) &&
+             scales_linearly("intersection", size, generate, intersection) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_interleaved_relative()
+{
+  size_t size = VISIBLE_SIZE(4);
+
+  // A relative path keeps the back segments at its beginning, and every other
+  // one removes the normal segment in front of it.
+  auto generate = [](size_t n) {
+    return repeat("../", n) + repeat("a/b/../", n);
+  };
+
+  return scales_linearly("normalize", 2000, generate, normalize) &&
+             scales_linearly("visible", size, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_segment()
+{
+  auto generate = [](size_t n) { return "/" + std::string(n, 'a'); };
+
+  return scales_linearly("normalize", 8192, generate, normalize) &&
+             scales_linearly("relative", 8192, generate, relative) &&
+             scales_linearly("intersection", 8192, generate, intersection) &&
+             scales_linearly("visible", 8192, generate, visible)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
+
+int complexity_join()
+{
+  std::vector<const char *> paths;
+
+  // The input is only used for its length here, every character is another
+  // fragment which is joined.
+  auto generate = [](size_t n) { return std::string(n, 'x'); };
+  auto join = [&paths](const std::string &input) {
+    static const char *fragments[] = {"a/", "b/../", "../", "./c", ""};
+
+    paths.clear();
+    paths.push_back("/");
+    for (size_t i = 0; i < input.size(); ++i) {
+      paths.push_back(fragments[i % 5]);
+    }
+
+    paths.push_back(NULL);
+    cwk_path.join_multiple(paths.data(), buffer, sizeof(buffer));
+  };
+
+  return scales_linearly("join", 256, generate, join) ? EXIT_SUCCESS
+                                                      : EXIT_FAILURE;
+}
+
+int complexity_truncated()
+{
+  // Segments which do not fit into the buffer can't be read back from it once
+  // they are removed.
+  auto generate = [](size_t n) {
+    return repeat("a/", n) + repeat("b/../", n) + repeat("../", n / 2);
+  };
+  auto truncated = [](const std::string &input) {
+    char small[64];
+
+    cwk_path.normalize(input.c_str(), small, sizeof(small));
+  };
+
+  return scales_linearly("truncated", 2000, generate, truncated)
+           ? EXIT_SUCCESS
+           : EXIT_FAILURE;
+}
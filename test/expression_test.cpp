@@ -0,0 +1,135 @@
+#include <cwalk.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cwk cwk_path;
+
+static const char *bases[] = {"/var/log", "relative/dir/", "a/..", "", "/",
+  "x/y/../../..", "build/out.dir/"};
+static const char *names[] = {"file.txt", "../other/name", "./", "deep/er/",
+  "..", ".hidden", ""};
+static const char *values[] = {NULL, "new", "with.dot", "/trim/me/", "", ".o",
+  "o", "a/b.c"};
+
+int expression_join()
+{
+  char expected[FILENAME_MAX], result[FILENAME_MAX];
+  size_t i, j, length;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  for (i = 0; i < sizeof(bases) / sizeof(bases[0]); ++i) {
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      length = cwk_path.join(bases[i], names[j], expected, sizeof(expected));
+      if (cwk_path.expression(bases[i], names[j])
+              .write(result, sizeof(result)) != length ||
+          strcmp(expected, result) != 0) {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int expression_chain()
+{
+  char expected[FILENAME_MAX], result[FILENAME_MAX];
+  size_t i, j, k, l, length;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  for (i = 0; i < sizeof(bases) / sizeof(bases[0]); ++i) {
+    for (j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      for (k = 0; k < sizeof(values) / sizeof(values[0]); ++k) {
+        for (l = 0; l < sizeof(values) / sizeof(values[0]); ++l) {
+          auto expression = cwk_path.expression(bases[i], names[j]);
+          length = cwk_path.join(
+            bases[i], names[j], expected, sizeof(expected));
+          if (values[k]) {
+            expression = expression.with_basename(values[k]);
+            length = cwk_path.change_basename(
+              expected, values[k], expected, sizeof(expected));
+          }
+
+          if (values[l]) {
+            expression = expression.with_extension(values[l]);
+            length = cwk_path.change_extension(
+              expected, values[l], expected, sizeof(expected));
+          }
+
+          if (expression.length() != length ||
+              expression.write(result, sizeof(result)) != length ||
+              strcmp(expected, result) != 0) {
+            return EXIT_FAILURE;
+          }
+        }
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int expression_absolute()
+{
+  char expected[FILENAME_MAX], result[FILENAME_MAX];
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  length = cwk_path.get_absolute(
+    "C:\\base\\dir", "..\\file.cpp", expected, sizeof(expected));
+  length = cwk_path.change_root(expected, "D:\\", expected, sizeof(expected));
+  length = cwk_path.change_extension(
+    expected, "obj", expected, sizeof(expected));
+
+  if (cwk_path.absolute_expression("C:\\base\\dir", "..\\file.cpp")
+        .with_root("D:\\")
+        .with_extension("obj")
+        .write(result, sizeof(result)) != length) {
+    return EXIT_FAILURE;
+  }
+
+  if (strcmp(result, "D:\\base\\file.obj") != 0 ||
+      strcmp(expected, result) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  length = cwk_path.get_absolute(
+    "relative", "\\\\server\\share\\x", expected, sizeof(expected));
+  if (cwk_path.absolute_expression("relative", "\\\\server\\share\\x")
+          .write(result, sizeof(result)) != length ||
+      strcmp(expected, result) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  length = cwk_path.get_absolute(
+    "relative", "other", expected, sizeof(expected));
+  if (cwk_path.absolute_expression("relative", "other")
+          .write(result, sizeof(result)) != length ||
+      strcmp(expected, result) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int expression_truncated()
+{
+  char result[8];
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  length = cwk_path.expression("/some/long/dir", "name")
+             .with_extension("txt")
+             .write(result, sizeof(result));
+  if (length != 23 || strcmp(result, "/some/l") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
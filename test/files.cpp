@@ -0,0 +1,19 @@
+#include "files.h"
+#include <ftw.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static int remove_entry(const char *path, const struct stat *, int type,
+  struct FTW *)
+{
+  // With FTW_DEPTH the contents of a directory are visited first, so it is
+  // already empty once it is removed.
+  return type == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+void remove_tree(const std::string &root)
+{
+  if (nftw(root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS) != 0) {
+    fprintf(stderr, "could not remove %s\n", root.c_str());
+  }
+}
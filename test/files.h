@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Removes a directory of a test with everything in it. Symbolic links are
+ * removed without being followed. A failure is only reported, since it doesn't
+ * affect the result of the test.
+ */
+void remove_tree(const std::string &root);
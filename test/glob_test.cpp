@@ -0,0 +1,301 @@
+#include <atomic>
+#include <cwalk_glob.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static cwk cwk_path;
+
+struct glob_case
+{
+  const char *pattern;
+  const char *path;
+  bool expected;
+};
+
+static bool check_cases(const struct glob_case *cases, size_t count)
+{
+  size_t i;
+
+  for (i = 0; i < count; ++i) {
+    if (cwk_glob(cwk_path, cases[i].pattern).match(cases[i].path) !=
+        cases[i].expected) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int glob_literal()
+{
+  const struct glob_case cases[] = {{"a/b", "a/b", true},
+    {"a/b", "a/b/", true}, {"a/b", "a//b", true}, {"a/b", "a/c", false},
+    {"a/b", "a", false}, {"a/b", "a/b/c", false}, {"b", "a/b", true},
+    {"b", "b", true}, {"b", "ab", false}, {"/a", "a", true},
+    {"/a", "b/a", false}, {"a", "", false}};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (!check_cases(cases, sizeof(cases) / sizeof(cases[0]))) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_wildcard()
+{
+  const struct glob_case cases[] = {{"*.o", "main.o", true},
+    {"*.o", "src/main.o", true}, {"*.o", "main.c", false},
+    {"*.o", ".o", true}, {"a*b*c", "abc", true}, {"a*b*c", "aXbYbZc", true},
+    {"a*b*c", "aXbYc_", false}, {"a**b", "ab", true}, {"?", "a", true},
+    {"?", "", false}, {"?", "ab", false}, {"bazel-*", "bazel-out", true},
+    {"bazel-*", "x/bazel-bin", true}, {"bazel-*", "bazel", false},
+    {"src/*", "src/a", true}, {"src/*", "src/a/b", false},
+    {"*/b", "a/b", true}, {"*/b", "b", false}, {"[abc]", "b", true},
+    {"[abc]", "d", false}, {"[a-c]x", "cx", true}, {"[!a-c]", "c", false},
+    {"[!a-c]", "d", true}, {"[^a]", "b", true}, {"[]]", "]", true},
+    {"[ab", "[ab", true}, {"[ab", "a", false}};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (!check_cases(cases, sizeof(cases) / sizeof(cases[0]))) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_globstar()
+{
+  const struct glob_case cases[] = {{"**/x", "x", true},
+    {"**/x", "a/b/x", true}, {"**/x", "a/b/x/y", false},
+    {"a/**", "a/b", true}, {"a/**", "a/b/c", true}, {"a/**", "a", true},
+    {"a/**/b", "a/b", true}, {"a/**/b", "a/x/y/b", true},
+    {"a/**/b", "a/x/y/c", false}, {"a/**/**/b", "a/b", true},
+    {"**", "a/b/c", true}, {"a/**/*.c", "a/x/y.c", true},
+    {"a/**/*.c", "b/x/y.c", false}};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (!check_cases(cases, sizeof(cases) / sizeof(cases[0]))) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_windows()
+{
+  const struct glob_case cases[] = {{"src\\*.C", "SRC/main.c", true},
+    {"src/*.c", "src\\Main.C", true}, {"*.TXT", "dir\\file.txt", true},
+    {"[A-C]", "b", true}, {"[!A-C]", "b", false}, {"a\\b", "a\\c", false}};
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  if (!check_cases(cases, sizeof(cases) / sizeof(cases[0]))) {
+    return EXIT_FAILURE;
+  }
+
+  // The unix style is case sensitive and only knows the slash.
+  cwk_path.set_style(CWK_STYLE_UNIX);
+  if (cwk_glob(cwk_path, "*.TXT").match("file.txt") ||
+      cwk_glob(cwk_path, "a\\b").match("a/b")) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_set_equivalence()
+{
+  std::vector<size_t> matches, expected;
+  size_t i, j;
+  const char *patterns[] = {"a/b", "b", "/a", "*.o", "a*b*c", "?", "bazel-*",
+    "src/*", "*/b", "[a-c]x", "[!a-c]", "**/x", "a/**", "a/**/b",
+    "a/**/**/b", "**", "a/**/*.c", "[ab", "a/**/**", "**/a/**"};
+  const char *paths[] = {"a/b", "a//b/", "/a/b", "b", "a", "ab", "main.o",
+    "src/main.o", ".o", "aXbYbZc", "aXbYc_", "bazel-out", "x/bazel-bin",
+    "src/a", "src/a/b", "cx", "d", "x", "a/b/x", "a/b/x/y", "a/x/y/b",
+    "a/x/y.c", "[ab", "", "/", "x/a/y"};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  // The set must report exactly the patterns which match one by one.
+  cwk_glob_set set(cwk_path);
+  for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i) {
+    if (set.add(patterns[i]) != i) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (j = 0; j < sizeof(paths) / sizeof(paths[0]); ++j) {
+    expected.clear();
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); ++i) {
+      if (cwk_glob(cwk_path, patterns[i]).match(paths[j])) {
+        expected.push_back(i);
+      }
+    }
+
+    if (set.match(paths[j], &matches) != expected.size() ||
+        matches != expected || set.match(paths[j]) != !expected.empty()) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_set_braces()
+{
+  std::vector<size_t> matches;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_glob_set set(cwk_path);
+  set.add("*.{c,cpp}");
+  set.add("{src,include}/**/*.h");
+  set.add("a{b,c{d,e}}f");
+  set.add("{x");
+
+  if (!set.match("main.c") || !set.match("a/b/main.cpp") ||
+      set.match("main.h") || !set.match("src/main.h") ||
+      !set.match("include/a/b/main.h") || set.match("lib/main.h") ||
+      !set.match("abf") || !set.match("acdf") || !set.match("acef") ||
+      set.match("acf") || !set.match("{x") || set.match("x")) {
+    return EXIT_FAILURE;
+  }
+
+  // All alternatives of a pattern report the same index.
+  if (set.match("src/x.h", &matches) != 1 || matches[0] != 1) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_set_many()
+{
+  std::vector<size_t> matches;
+  std::string pattern, path;
+  size_t i, j;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  // Lots of patterns which all share prefixes, the automaton has to keep
+  // them apart.
+  cwk_glob_set set(cwk_path);
+  for (i = 0; i < 2000; ++i) {
+    pattern = "src/module" + std::to_string(i) + "/**/*." +
+              std::to_string(i % 7);
+    set.add(pattern.c_str());
+  }
+
+  for (j = 0; j < 3; ++j) {
+    for (i = 0; i < 2000; i += 13) {
+      path = "src/module" + std::to_string(i) + "/a/b/file." +
+             std::to_string(i % 7);
+      if (set.match(path.c_str(), &matches) != 1 || matches[0] != i) {
+        return EXIT_FAILURE;
+      }
+
+      path = "src/module" + std::to_string(i) + "/file." +
+             std::to_string((i + 1) % 7);
+      if (set.match(path.c_str())) {
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_set_windows()
+{
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  cwk_glob_set set(cwk_path);
+  set.add("src\\**\\*.{C,H}");
+  if (!set.match("C:\\SRC\\a\\Main.c") || !set.match("src/main.h") ||
+      set.match("src\\main.cpp")) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_empty()
+{
+  std::vector<size_t> matches;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (cwk_glob(cwk_path, "").match("a") || cwk_glob(cwk_path, "/").match("a")) {
+    return EXIT_FAILURE;
+  }
+
+  // An empty pattern takes an index, but never reports it.
+  cwk_glob_set set(cwk_path);
+  set.add("");
+  set.add("b");
+  if (set.match("a") || set.match("a/b", &matches) != 1 || matches[0] != 1) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int glob_set_segments()
+{
+  std::vector<std::thread> threads;
+  std::string pattern;
+  std::atomic<bool> success;
+  uint32_t position, next;
+  size_t i;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_glob_set set(cwk_path);
+  for (i = 0; i < 2000; ++i) {
+    pattern = "src/module" + std::to_string(i) + "/**/*.c";
+    set.add(pattern.c_str());
+  }
+
+  if (set.step(set.start(), "src", &position) || !set.is_alive(position) ||
+      set.step(set.start(), "module7", &next) || set.is_alive(next)) {
+    return EXIT_FAILURE;
+  }
+
+  // The threads build lots of states at the same time, more than the cache
+  // keeps for whole paths. None of them may be dropped, since the position
+  // of the first segment is still in use.
+  success = true;
+  for (i = 0; i < 4; ++i) {
+    threads.emplace_back([&set, &success, position, i]() {
+      uint32_t directory, file;
+      std::string name;
+      size_t j;
+
+      for (j = i; j < 2000; j += 2) {
+        name = "module" + std::to_string(j);
+        if (set.step(position, name, &directory) ||
+            !set.is_alive(directory) ||
+            set.step(directory, "file" + std::to_string(j) + ".h", &file) ||
+            !set.step(directory, "file" + std::to_string(j) + ".c", &file)) {
+          success = false;
+        }
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
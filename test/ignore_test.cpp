@@ -0,0 +1,174 @@
+#include <cwalk_ignore.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cwk cwk_path;
+
+int ignore_simple()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("# build output\n"
+                   "\n"
+                   "*.o\n"
+                   "node_modules\n"
+                   "!keep.o\n"
+                   "bazel-*   \n");
+
+  if (!ignore.is_ignored("main.o", false) ||
+      ignore.is_ignored("keep.o", false) ||
+      ignore.is_ignored("main.c", false) ||
+      !ignore.is_ignored("node_modules", true) ||
+      !ignore.is_ignored("bazel-out", true) ||
+      ignore.is_ignored("# build output", false)) {
+    return EXIT_FAILURE;
+  }
+
+  // Patterns without separators match at any depth.
+  ignore.push("src");
+  ignore.push("lib");
+  if (!ignore.is_ignored("util.o", false) ||
+      !ignore.is_ignored("node_modules", true) ||
+      ignore.is_ignored("keep.o", false)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ignore_anchored()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("/config\ndoc/*.txt\n**/generated/*.h\n");
+
+  if (!ignore.is_ignored("config", false)) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.push("doc");
+  if (!ignore.is_ignored("readme.txt", false) ||
+      ignore.is_ignored("readme.md", false) ||
+      ignore.is_ignored("config", false)) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.push("nested");
+  if (ignore.is_ignored("readme.txt", false)) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.pop();
+  ignore.pop();
+  ignore.push("src");
+  ignore.push("generated");
+  if (!ignore.is_ignored("parser.h", false) ||
+      ignore.is_ignored("parser.c", false)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ignore_directory_only()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("build/\nout/\n!out\n");
+
+  // The negation has no trailing separator, so it applies to both.
+  if (!ignore.is_ignored("build", true) ||
+      ignore.is_ignored("build", false) || ignore.is_ignored("out", true) ||
+      ignore.is_ignored("out", false)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ignore_nested()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("*.log\n/tmp\n");
+
+  // The rules of a nested file override the parent, and are anchored to the
+  // nested directory.
+  ignore.push("service");
+  ignore.add_rules("!important.log\n/tmp\n");
+  if (ignore.is_ignored("important.log", false) ||
+      !ignore.is_ignored("debug.log", false) ||
+      !ignore.is_ignored("tmp", true) || ignore.depth() != 1) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.push("api");
+  if (ignore.is_ignored("important.log", false) ||
+      ignore.is_ignored("tmp", true)) {
+    return EXIT_FAILURE;
+  }
+
+  // Leaving the directory drops its rules again.
+  ignore.pop();
+  ignore.pop();
+  if (!ignore.is_ignored("important.log", false) || ignore.depth() != 0) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.pop();
+  if (ignore.depth() != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ignore_escape()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("\\#notes\r\n\\!bang\ntrailing\\ \n{a,b}\n");
+
+  if (!ignore.is_ignored("#notes", false) ||
+      !ignore.is_ignored("!bang", false) ||
+      !ignore.is_ignored("trailing ", false) ||
+      ignore.is_ignored("trailing", false) ||
+      !ignore.is_ignored("{a,b}", false) || ignore.is_ignored("a", false)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int ignore_contents()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  cwk_ignore ignore(cwk_path);
+  ignore.add_rules("abc/**\n!abc/keep\n");
+
+  // A trailing globstar only matches what is inside the directory, so the
+  // directory is walked and its entries can be included again.
+  if (ignore.is_ignored("abc", true)) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.push("abc");
+  if (ignore.is_ignored("keep", true) || !ignore.is_ignored("other", false)) {
+    return EXIT_FAILURE;
+  }
+
+  ignore.push("keep");
+  if (!ignore.is_ignored("file", false)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+#include <cwalk.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cwk cwk_path;
+
+static size_t index_to_normalized(
+  const struct cwk_segment_index *index, char *buffer)
+{
+  size_t i, pos;
+  bool has_output;
+
+  pos = index->root_length;
+  memcpy(buffer, index->path, pos);
+  has_output = false;
+  for (i = 0; i < index->count; ++i) {
+    if (index->entries[i].removed) {
+      continue;
+    }
+
+    if (has_output) {
+      buffer[pos++] = cwk_path.get_style() == CWK_STYLE_WINDOWS ? '\\' : '/';
+    }
+
+    has_output = true;
+    memcpy(buffer + pos, index->path + index->entries[i].begin,
+      index->entries[i].size);
+    pos += index->entries[i].size;
+  }
+
+  if (pos == 0) {
+    buffer[pos++] = '.';
+  }
+
+  buffer[pos] = '\0';
+  return pos;
+}
+
+int index_simple()
+{
+  struct cwk_segment_index_entry entries[8];
+  struct cwk_segment_index index;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  index.entries = entries;
+  index.capacity = 8;
+  if (cwk_path.get_segment_index("/var/log/../tmp/./", &index) != 5) {
+    return EXIT_FAILURE;
+  }
+
+  if (index.root_length != 1 || !index.absolute) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[0].begin != 1 || entries[0].size != 3 ||
+      entries[0].type != CWK_NORMAL || entries[0].removed) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[1].begin != 5 || entries[1].size != 3 || !entries[1].removed) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[2].type != CWK_BACK || !entries[2].removed) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[3].type != CWK_NORMAL || entries[3].removed ||
+      entries[3].depth != 2) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[4].type != CWK_CURRENT || !entries[4].removed) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int index_empty()
+{
+  struct cwk_segment_index_entry entries[1];
+  struct cwk_segment_index index;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  index.entries = entries;
+  index.capacity = 1;
+  if (cwk_path.get_segment_index("", &index) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (cwk_path.get_segment_index("///", &index) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int index_capacity()
+{
+  struct cwk_segment_index_entry entries[2];
+  struct cwk_segment_index index;
+  struct cwk_segment segment;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  index.entries = entries;
+  index.capacity = 2;
+  if (cwk_path.get_segment_index("a/b/c/d", &index) != 4) {
+    return EXIT_FAILURE;
+  }
+
+  if (entries[1].begin != 2 || entries[1].size != 1) {
+    return EXIT_FAILURE;
+  }
+
+  if (cwk_path.get_indexed_segment(&index, 2, &segment)) {
+    return EXIT_FAILURE;
+  }
+
+  if (!cwk_path.get_indexed_segment(&index, 1, &segment)) {
+    return EXIT_FAILURE;
+  }
+
+  if (strncmp(segment.begin, "b", segment.size) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int index_windows()
+{
+  struct cwk_segment_index_entry entries[8];
+  struct cwk_segment_index index;
+  struct cwk_segment segment;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  index.entries = entries;
+  index.capacity = 8;
+  if (cwk_path.get_segment_index("\\\\server\\share\\dir/file.txt", &index) !=
+      2) {
+    return EXIT_FAILURE;
+  }
+
+  if (index.root_length != 15 || !index.absolute) {
+    return EXIT_FAILURE;
+  }
+
+  if (!cwk_path.get_indexed_segment(&index, 1, &segment)) {
+    return EXIT_FAILURE;
+  }
+
+  if (segment.size != 8 || strncmp(segment.begin, "file.txt", 8) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int index_normalize()
+{
+  struct cwk_segment_index_entry entries[64];
+  struct cwk_segment_index index;
+  char expected[FILENAME_MAX], result[FILENAME_MAX];
+  size_t i;
+  const char *paths[] = {"/var/log/../tmp", "a/../..", "../a/b/../../c",
+    "/../../a/./b//c/", "a/b/c/../../../../d", "./././",
+    "this/is/a/very/long/path/which/does/not/fit/into/a/single/block/of/"
+    "sixty/four/characters/../../at/all/and/contains/..",
+    "x/y/../../../z/../w", "a/./b/././c/..", "/"};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  index.entries = entries;
+  index.capacity = 64;
+  for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    cwk_path.normalize(paths[i], expected, sizeof(expected));
+    cwk_path.get_segment_index(paths[i], &index);
+    index_to_normalized(&index, result);
+    if (strcmp(expected, result) != 0) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -3,6 +3,21 @@
 
 static cwk cwk_path;
 
+int intersection_segment_prefix()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (cwk_path.get_intersection("/test/b/foo", "/test/bar/foo") != 5) {
+    return EXIT_FAILURE;
+  }
+
+  if (cwk_path.get_intersection("/test/bar/foo", "/test/b") != 5) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int intersection_skipped_end()
 {
   cwk_path.set_style(CWK_STYLE_UNIX);
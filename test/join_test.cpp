@@ -6,6 +6,32 @@
 
 static cwk cwk_path;
 
+int join_empty_first()
+{
+  char buffer[FILENAME_MAX];
+  const char *paths[4];
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  paths[0] = "";
+  paths[1] = "//:.?/\\.c";
+  paths[2] = "..";
+  paths[3] = NULL;
+
+  length = cwk_path.join_multiple(paths, buffer, sizeof(buffer));
+
+  if (length != 2) {
+    return EXIT_FAILURE;
+  }
+
+  if (strcmp(buffer, "..") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int join_multiple()
 {
   char buffer[FILENAME_MAX];
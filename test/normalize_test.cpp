@@ -8,6 +8,27 @@
 
 static cwk cwk_path;
 
+int normalize_in_place_back()
+{
+  size_t count;
+  char result[FILENAME_MAX];
+  const char *input, *expected;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  // The back segments are kept, so the output is written over the input while
+  // it is still read.
+  input = ".\\..\\..\\?";
+  strcpy(result, input);
+  expected = "..\\..\\?";
+  count = cwk_path.normalize(result, result, sizeof(result));
+  if (count != strlen(expected) || strcmp(result, expected) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int normalize_back_after_root()
 {
   size_t count;
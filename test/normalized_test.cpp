@@ -0,0 +1,85 @@
+#include <cwalk.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static cwk cwk_path;
+
+template <typename T_VIEW> static std::string view_to_string(const T_VIEW &view)
+{
+  std::string result;
+  bool has_segment_output;
+
+  result = view.root();
+  has_segment_output = false;
+  for (std::string_view segment : view) {
+    if (has_segment_output) {
+      result += cwk_path.get_style() == CWK_STYLE_WINDOWS ? '\\' : '/';
+    }
+
+    has_segment_output = true;
+    result += segment;
+  }
+
+  if (result.empty() && view.length() == 1) {
+    result = ".";
+  }
+
+  return result;
+}
+
+int normalized_single()
+{
+  char buffer[FILENAME_MAX];
+  size_t i, length;
+  const char *paths[] = {"/var/log/../tmp", "a/../..", "../a/b/../../c",
+    "/../../a/./b//c/", "a/b/c/../../../../d", "./././", "", "/", "a/..",
+    "hello/there/../world"};
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    auto view = cwk_path.normalized_view(paths[i]);
+    length = cwk_path.normalize(paths[i], buffer, sizeof(buffer));
+    if (view.length() != length || view_to_string(view) != buffer) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int normalized_joined()
+{
+  char buffer[FILENAME_MAX];
+  const char *paths[] = {"C:\\this\\", "..\\is", "a\\.\\test\\", NULL};
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  auto view = cwk_path.normalized_view(paths[0], paths[1], paths[2]);
+  length = cwk_path.join_multiple(paths, buffer, sizeof(buffer));
+  if (view.length() != length || view_to_string(view) != buffer) {
+    return EXIT_FAILURE;
+  }
+
+  if (view.root() != "C:\\") {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int normalized_no_output()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  auto view = cwk_path.normalized_view("/", "a/../");
+  if (!view.empty() || view.root() != "/" || view.length() != 1) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+#include "files.h"
+#include <cwalk_open.h>
+#include <errno.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+static cwk cwk_path;
+
+static std::string create_directories()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  const char *files[] = {"a/f1", "a/f2", "b/f3", "c/f4"};
+  std::string base;
+  FILE *file;
+
+  if (!mkdtemp(root)) {
+    return "";
+  }
+
+  base = root;
+  mkdir((base + "/a").c_str(), 0755);
+  mkdir((base + "/b").c_str(), 0755);
+  mkdir((base + "/c").c_str(), 0755);
+  for (const char *name : files) {
+    file = fopen((base + "/" + name).c_str(), "w");
+    if (file) {
+      fputs(name, file);
+      fclose(file);
+    }
+  }
+
+  if (symlink("/etc", (base + "/a/escape").c_str()) != 0 ||
+      symlink("../b/f3", (base + "/a/sibling").c_str()) != 0 ||
+      symlink("../../f5", (base + "/a/outside").c_str()) != 0) {
+    return "";
+  }
+
+  return base;
+}
+
+static bool check_file(int fd, const char *expected)
+{
+  char buffer[16];
+  ssize_t length;
+
+  if (fd < 0) {
+    return false;
+  }
+
+  length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length < 0) {
+    return false;
+  }
+
+  buffer[length] = '\0';
+  return strcmp(buffer, expected) == 0;
+}
+
+int open_cached()
+{
+  std::string base, path;
+  bool success;
+  int fd;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_directories();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // The paths are normalized, so both files of "a" share one directory.
+  cwk_opener opener(cwk_path);
+  path = base + "/a/f1";
+  success = check_file(opener.open(path.c_str(), O_RDONLY), "a/f1");
+  path = base + "//b/../a/./f2";
+  success = success && check_file(opener.open(path.c_str(), O_RDONLY), "a/f2");
+  success = success && opener.size() == 1;
+
+  path = base + "/a/missing";
+  success = success && opener.open(path.c_str(), O_RDONLY) == -1 &&
+            errno == ENOENT;
+  path = base + "/missing/f1";
+  success = success && opener.open(path.c_str(), O_RDONLY) == -1 &&
+            errno == ENOENT && opener.size() == 1;
+
+  path = base + "/a/new";
+  fd = opener.open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+  success = success && fd >= 0 && access(path.c_str(), F_OK) == 0;
+  close(fd);
+
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int open_eviction()
+{
+  std::string base, path;
+  bool success;
+  int fd;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_directories();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Only two directories fit, so "a" is evicted by "c" and opened again.
+  cwk_opener opener(cwk_path, 2);
+  path = base + "/a/f1";
+  success = check_file(opener.open(path.c_str(), O_RDONLY), "a/f1");
+  path = base + "/b/f3";
+  success = success && check_file(opener.open(path.c_str(), O_RDONLY), "b/f3");
+  path = base + "/c/f4";
+  success = success && check_file(opener.open(path.c_str(), O_RDONLY), "c/f4");
+  path = base + "/a/f2";
+  success = success && check_file(opener.open(path.c_str(), O_RDONLY), "a/f2");
+  success = success && opener.size() == 2;
+
+  // The descriptor of a directory can be used directly.
+  path = base + "/c";
+  fd = opener.get_directory(path);
+  success = success && fd >= 0 && check_file(openat(fd, "f4", O_RDONLY), "c/f4");
+
+  opener.clear();
+  success = success && opener.size() == 0;
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int open_beneath()
+{
+  std::string base;
+  bool success;
+  int fd;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_directories();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_opener opener(cwk_path, 4, base.c_str());
+  fd = opener.open("a/f1", O_RDONLY);
+  if (fd < 0 && errno == ENOSYS) {
+    // The kernel is too old for openat2, nothing else can be checked.
+    remove_tree(base);
+    return EXIT_SUCCESS;
+  }
+
+  // Neither going back nor a link to the outside may leave the root, even
+  // if the lexical normalization keeps the path inside.
+  success = check_file(fd, "a/f1") &&
+            check_file(opener.open("c/../b/f3", O_RDONLY), "b/f3") &&
+            opener.open("../etc/passwd", O_RDONLY) == -1 && errno == EXDEV &&
+            opener.open("a/escape/passwd", O_RDONLY) == -1 &&
+            errno == EXDEV && opener.open("/etc/passwd", O_RDONLY) == -1;
+
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int open_sibling()
+{
+  std::string base;
+  bool success;
+  int fd;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_directories();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_opener opener(cwk_path, 4, base.c_str());
+  fd = opener.open("a/f1", O_RDONLY);
+  if (fd < 0 && errno == ENOSYS) {
+    remove_tree(base);
+    return EXIT_SUCCESS;
+  }
+
+  // A link may leave the directory of the file, as long as it stays beneath
+  // the root.
+  success = check_file(fd, "a/f1") &&
+            check_file(opener.open("a/sibling", O_RDONLY), "b/f3") &&
+            check_file(opener.open("a/./sibling", O_RDONLY), "b/f3") &&
+            opener.open("a/outside", O_RDONLY) == -1 && errno == EXDEV;
+
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
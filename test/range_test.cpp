@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cwalk.h>
+#include <memory.h>
+#include <ranges>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cwk cwk_path;
+
+static_assert(std::ranges::bidirectional_range<cwk_segment_range<cwk>>);
+static_assert(std::ranges::view<cwk_segment_range<cwk>>);
+static_assert(std::ranges::borrowed_range<cwk_segment_range<cwk>>);
+static_assert(
+  std::ranges::bidirectional_range<cwk_joined_segment_range<cwk, true>>);
+static_assert(std::ranges::view<cwk_joined_segment_range<cwk, false>>);
+
+int range_segments()
+{
+  const char *expected[] = {"this", "is", "..", "a", "path"};
+  size_t i;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  i = 0;
+  for (std::string_view segment : cwk_path.segments("/this//is/../a/path/")) {
+    if (i >= 5 || segment != expected[i]) {
+      return EXIT_FAILURE;
+    }
+
+    ++i;
+  }
+
+  if (i != 5) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_empty()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (!cwk_path.segments("").empty()) {
+    return EXIT_FAILURE;
+  }
+
+  if (!cwk_path.segments("///").empty()) {
+    return EXIT_FAILURE;
+  }
+
+  if (!cwk_path.visible_segments("a/..").empty()) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_reverse()
+{
+  const char *expected[] = {"path", "a", "is", "this"};
+  size_t i;
+  auto range = cwk_unix().segments("/this/is/a/path");
+  auto empty = cwk_unix().segments("/");
+  auto it = range.end_iterator();
+
+  if (it != range.end() ||
+      it != std::ranges::next(range.begin(), range.end()) ||
+      empty.end_iterator() != empty.begin()) {
+    return EXIT_FAILURE;
+  }
+
+  i = 0;
+  while (it != range.begin()) {
+    --it;
+    if (i >= 4 || *it != expected[i]) {
+      return EXIT_FAILURE;
+    }
+
+    ++i;
+  }
+
+  if (i != 4) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_visible()
+{
+  const char *expected[] = {"is", "path"};
+  size_t i;
+
+  cwk_path.set_style(CWK_STYLE_WINDOWS);
+
+  i = 0;
+  for (auto segment :
+    cwk_path.visible_segments("C:\\this\\..\\is\\.\\a\\..\\path\\")) {
+    if (i >= 2 || segment != expected[i]) {
+      return EXIT_FAILURE;
+    }
+
+    ++i;
+  }
+
+  if (i != 2) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_visible_reverse()
+{
+  auto range = cwk_unix().visible_segments("../a/b/../c/./d/..");
+  auto it = std::ranges::next(range.begin(), range.end());
+
+  if (*--it != "c" || *--it != "a" || *--it != ".." || it != range.begin()) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_joined()
+{
+  const char *paths[] = {"/first/path", "../second", "third/", NULL};
+  const char *expected[] = {"first", "path", "..", "second", "third"};
+  size_t i;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  i = 0;
+  for (auto segment : cwk_path.joined_segments(paths)) {
+    if (i >= 5 || segment != expected[i]) {
+      return EXIT_FAILURE;
+    }
+
+    ++i;
+  }
+
+  if (i != 5) {
+    return EXIT_FAILURE;
+  }
+
+  if (std::ranges::distance(cwk_path.visible_segments(paths)) != 3) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int range_algorithms()
+{
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  if (std::ranges::count(cwk_path.segments("a/b/a/c/a"), "a") != 3) {
+    return EXIT_FAILURE;
+  }
+
+  auto it = std::ranges::find(cwk_path.segments("a/b/c"), "b");
+  if (it.get_segment().begin[0] != 'b' || *++it != "c") {
+    return EXIT_FAILURE;
+  }
+
+  if (!std::ranges::equal(cwk_path.visible_segments("x/./y/../z"),
+        cwk_path.segments("x/z"))) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -3,11 +3,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 static cwk cwk_path;
 
+int relative_beyond_visibility()
+{
+  static char result[1 << 16];
+  std::string path, expected;
+  size_t length, i;
+
+  // Paths with more segments than CWK_VISIBILITY_SEGMENTS are not determined
+  // in a single pass, which must still give the same result.
+  cwk_path.set_style(CWK_STYLE_UNIX);
+  path = "/";
+  for (i = 0; i < CWK_VISIBILITY_SEGMENTS; ++i) {
+    path += "a/b/../";
+    expected += "../";
+  }
+
+  expected += "x";
+  length = cwk_path.get_relative(path.c_str(), "/x", result, sizeof(result));
+  if (length != expected.size() || expected != result) {
+    return EXIT_FAILURE;
+  }
+
+  expected = "..";
+  for (i = 0; i < CWK_VISIBILITY_SEGMENTS; ++i) {
+    expected += "/a";
+  }
+
+  length = cwk_path.get_relative("/x", path.c_str(), result, sizeof(result));
+  if (length != expected.size() || expected != result) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int relative_segment_prefix()
+{
+  char result[FILENAME_MAX];
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  length = cwk_path.get_relative("/dir/b/file", "/dir/bf/file", result,
+    sizeof(result));
+  if (length != 13 || strcmp(result, "../../bf/file") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int relative_root_path_windows()
 {
   char result[FILENAME_MAX];
@@ -0,0 +1,179 @@
+#include "files.h"
+#include <cwalk_resolve.h>
+#include <errno.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+static cwk cwk_path;
+
+static std::string create_links()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::string base;
+  FILE *file;
+
+  if (!mkdtemp(root)) {
+    return "";
+  }
+
+  // The tree has relative, absolute, chained and looping links, and a link
+  // which goes back up.
+  base = root;
+  mkdir((base + "/real").c_str(), 0755);
+  mkdir((base + "/real/dir").c_str(), 0755);
+  file = fopen((base + "/real/dir/file").c_str(), "w");
+  if (file) {
+    fclose(file);
+  }
+
+  if (symlink("real", (base + "/rel").c_str()) != 0 ||
+      symlink((base + "/real/dir").c_str(), (base + "/abs").c_str()) != 0 ||
+      symlink("rel/dir", (base + "/chain").c_str()) != 0 ||
+      symlink("../..", (base + "/real/dir/up").c_str()) != 0 ||
+      symlink("loop2", (base + "/loop1").c_str()) != 0 ||
+      symlink("loop1", (base + "/loop2").c_str()) != 0 ||
+      symlink("/", (base + "/top").c_str()) != 0) {
+    return "";
+  }
+
+  return base;
+}
+
+static bool check_path(const cwk_resolver<cwk> &resolver, const char *path)
+{
+  char expected[PATH_MAX], buffer[PATH_MAX];
+  int expected_error;
+  size_t length;
+
+  errno = 0;
+  if (!realpath(path, expected)) {
+    expected_error = errno;
+    errno = 0;
+    return resolver.resolve_real(path, buffer, sizeof(buffer)) == 0 &&
+           errno == expected_error;
+  }
+
+  length = resolver.resolve_real(path, buffer, sizeof(buffer));
+  return length == strlen(expected) && strcmp(buffer, expected) == 0;
+}
+
+int resolve_links()
+{
+  const char *paths[] = {"/real/dir/file", "/rel/dir/file", "/abs/file",
+    "/chain/file", "/chain/up/rel/dir", "/chain/../dir", "/abs/up/chain/..",
+    "//rel/./dir//file", "/rel/dir/file/..", "/missing", "/rel/missing/file",
+    "/loop1", "/loop1/file", "/top/tmp", "/real/dir/file/x", "", "/.."};
+  std::string base, path;
+  size_t i, pass;
+  bool success;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_links();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // The first pass fills the cache and the second one uses it, both must be
+  // the same as realpath.
+  cwk_resolver resolver(cwk_path);
+  success = true;
+  for (pass = 0; pass < 2; ++pass) {
+    for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+      path = base + paths[i];
+      success = success && check_path(resolver, path.c_str());
+    }
+  }
+
+  success = success && check_path(resolver, "/");
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int resolve_directories()
+{
+  const char *paths[] = {"/real/dir/file/", "/real/dir/file//",
+    "/real/dir/file/.", "/real/dir/", "/abs/", "/chain//", "/abs/file/",
+    "/missing/", "/top/"};
+  std::string base, path;
+  size_t i, pass;
+  bool success;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_links();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // A trailing separator means that the path has to be a directory, so a
+  // file fails with ENOTDIR just like with realpath. An empty path is not
+  // the current directory, it does not exist.
+  cwk_resolver resolver(cwk_path);
+  success = true;
+  for (pass = 0; pass < 2; ++pass) {
+    for (i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+      path = base + paths[i];
+      success = success && check_path(resolver, path.c_str());
+    }
+  }
+
+  success = success && check_path(resolver, "");
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int resolve_relative()
+{
+  char cwd[PATH_MAX];
+  std::string base;
+  bool success;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_links();
+  if (base.empty() || !getcwd(cwd, sizeof(cwd))) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_resolver resolver(cwk_path);
+  success = chdir((base + "/chain").c_str()) == 0 &&
+            check_path(resolver, "file") && check_path(resolver, "up/abs") &&
+            check_path(resolver, ".") && check_path(resolver, "..");
+  success = chdir(cwd) == 0 && success;
+
+  remove_tree(base);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int resolve_truncated()
+{
+  char buffer[8];
+  std::string base, path, expected;
+  size_t length;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  base = create_links();
+  if (base.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_resolver resolver(cwk_path);
+  path = base + "/abs/file";
+  length = resolver.resolve_real(path.c_str(), buffer, sizeof(buffer));
+  expected = base + "/real/dir/file";
+
+  remove_tree(base);
+  if (length != expected.size() ||
+      strncmp(buffer, expected.c_str(), sizeof(buffer) - 1) != 0 ||
+      buffer[sizeof(buffer) - 1] != '\0') {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+#include "files.h"
+#include <cwalk_snapshot.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+static void write_file(const std::string &path, const char *content)
+{
+  FILE *file;
+
+  file = fopen(path.c_str(), "w");
+  if (file) {
+    fputs(content, file);
+    fclose(file);
+  }
+}
+
+static void move_back(const std::string &path)
+{
+  struct timespec times[2];
+
+  // An entry which is moved back in time always gets a new time if it is
+  // changed right after a scan, and it can't have been changed during one.
+  times[0].tv_sec = times[1].tv_sec = 1000000000;
+  times[0].tv_nsec = times[1].tv_nsec = 0;
+  utimensat(AT_FDCWD, path.c_str(), times, AT_SYMLINK_NOFOLLOW);
+}
+
+static void create_tree(const std::string &root)
+{
+  mkdir((root + "/a").c_str(), 0755);
+  mkdir((root + "/a/b").c_str(), 0755);
+  mkdir((root + "/a/c").c_str(), 0755);
+  mkdir((root + "/d").c_str(), 0755);
+  mkdir((root + "/e").c_str(), 0755);
+  write_file(root + "/f1", "one");
+  write_file(root + "/a/f2", "two");
+  write_file(root + "/a/b/f3", "three");
+  write_file(root + "/a/c/f4", "four");
+  write_file(root + "/d/f5", "five");
+  symlink("f1", (root + "/link").c_str());
+
+  for (const char *path : {"/f1", "/a/f2", "/a/b/f3", "/a/c/f4", "/d/f5",
+         "/link", "", "/a", "/a/b", "/a/c", "/d", "/e"}) {
+    move_back(root + path);
+  }
+}
+
+static bool equal(const std::vector<std::string> &a,
+  const std::vector<std::string> &b)
+{
+  return a == b;
+}
+
+int snapshot_scan()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  const cwk_snapshot_entry *e;
+  cwk_snapshot snapshot;
+  std::vector<std::string> paths;
+  struct stat st;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  create_tree(root);
+  success = snapshot.scan(root);
+  for (const cwk_snapshot_entry &entry : snapshot.get_entries()) {
+    paths.push_back(entry.path);
+  }
+
+  success = success && equal(paths, {"a", "a/b", "a/b/f3", "a/c", "a/c/f4",
+                                      "a/f2", "d", "d/f5", "e", "f1", "link"});
+
+  e = snapshot.find("a/b/f3");
+  success = success && e && lstat((std::string(root) + "/a/b/f3").c_str(),
+                               &st) == 0;
+  success = success && e->type == DT_REG && e->size == 5 &&
+            e->inode == st.st_ino &&
+            e->mtime == (int64_t)st.st_mtim.tv_sec * 1000000000 +
+                          st.st_mtim.tv_nsec;
+  success = success && snapshot.find("link") &&
+            snapshot.find("link")->type == DT_LNK && snapshot.find("a") &&
+            snapshot.find("a")->type == DT_DIR && !snapshot.find("a/b/f") &&
+            !snapshot.find("missing");
+  success = success && !snapshot.scan((std::string(root) + "/f1").c_str());
+
+  remove_tree(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int snapshot_file()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  cwk_snapshot snapshot, loaded;
+  std::string file;
+  bool success;
+  size_t i;
+  int fd;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  create_tree(root);
+  file = std::string(root) + "/snapshot";
+  success = snapshot.scan(root) && snapshot.save(file.c_str()) &&
+            loaded.load(file.c_str());
+  success = success &&
+            loaded.get_entries().size() == snapshot.get_entries().size();
+  for (i = 0; success && i < snapshot.get_entries().size(); ++i) {
+    const cwk_snapshot_entry &a = snapshot.get_entries()[i];
+    const cwk_snapshot_entry &b = loaded.get_entries()[i];
+    success = a.path == b.path && a.type == b.type && a.mtime == b.mtime &&
+              a.size == b.size && a.inode == b.inode;
+  }
+
+  // A truncated file is rejected and leaves the snapshot empty.
+  fd = open(file.c_str(), O_WRONLY);
+  success = success && fd >= 0 && ftruncate(fd, 20) == 0;
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  success = success && !loaded.load(file.c_str()) &&
+            loaded.get_entries().empty();
+  write_file(file, "not a snapshot");
+  success = success && !loaded.load(file.c_str());
+  success = success && !loaded.load((std::string(root) + "/missing").c_str());
+
+  remove_tree(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int snapshot_delta()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  cwk_snapshot snapshot, loaded;
+  cwk_snapshot_delta delta;
+  std::string r, file;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  r = root;
+  create_tree(r);
+  file = r + ".snapshot";
+  success = snapshot.scan(root) && snapshot.save(file.c_str());
+
+  // A new file in a/b, a removed file in d, a modified f1 which does not touch
+  // its directory, and a new directory in the root. Neither a nor a/c nor e
+  // have to be read again.
+  write_file(r + "/a/b/new", "new");
+  unlink((r + "/d/f5").c_str());
+  write_file(r + "/f1", "modified");
+  mkdir((r + "/x").c_str(), 0755);
+  mkdir((r + "/x/y").c_str(), 0755);
+  write_file(r + "/x/y/f6", "six");
+  for (const char *path : {"/a/b/new", "/f1", "/x/y/f6"}) {
+    move_back(r + path);
+  }
+
+  success = success && loaded.load(file.c_str()) &&
+            loaded.rescan(root, &delta);
+  success = success && equal(delta.added, {"a/b/new", "x", "x/y", "x/y/f6"});
+  success = success && equal(delta.removed, {"d/f5"});
+  success = success && equal(delta.modified, {"f1"});
+  success = success && delta.directories_read == 5;
+
+  // The updated snapshot is the same as a new scan.
+  success = success && snapshot.scan(root) &&
+            snapshot.get_entries().size() == loaded.get_entries().size();
+  for (size_t i = 0; success && i < snapshot.get_entries().size(); ++i) {
+    const cwk_snapshot_entry &a = snapshot.get_entries()[i];
+    const cwk_snapshot_entry &b = loaded.get_entries()[i];
+    success = a.path == b.path && a.type == b.type && a.size == b.size &&
+              a.inode == b.inode && (a.type == DT_DIR || a.mtime == b.mtime);
+  }
+
+  // A directory which is replaced by a file is removed with all its entries.
+  remove_tree(r + "/a");
+  write_file(r + "/a", "file");
+  success = success && loaded.rescan(root, &delta);
+  success = success && equal(delta.added, {"a"});
+  success = success && equal(delta.removed, {"a", "a/b", "a/b/f3", "a/b/new",
+                                              "a/c", "a/c/f4", "a/f2"});
+  success = success && delta.modified.empty();
+
+  unlink(file.c_str());
+  remove_tree(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int snapshot_racy()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  struct timespec times[2];
+  cwk_snapshot snapshot;
+  cwk_snapshot_delta delta;
+  std::string r;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  r = root;
+  create_tree(r);
+
+  // A file which was written in the same clock tick as the scan could be
+  // written again without getting a new time or size. A time in the future
+  // looks just like that, so the file is reported until the scans catch up.
+  clock_gettime(CLOCK_REALTIME, &times[0]);
+  times[0].tv_sec += 3600;
+  times[1] = times[0];
+  utimensat(AT_FDCWD, (r + "/a/f2").c_str(), times, 0);
+
+  success = snapshot.scan(root) && snapshot.rescan(root, &delta);
+  success = success && delta.added.empty() && delta.removed.empty();
+  success = success && equal(delta.modified, {"a/f2"});
+
+  move_back(r + "/a/f2");
+  success = success && snapshot.rescan(root, &delta);
+  success = success && equal(delta.modified, {"a/f2"});
+  success = success && snapshot.rescan(root, &delta);
+  success = success && delta.modified.empty();
+
+  remove_tree(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
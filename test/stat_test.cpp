@@ -0,0 +1,131 @@
+#include <cwalk_stat.h>
+#include <errno.h>
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> create_files(const std::string &root,
+  size_t count)
+{
+  static const char contents[100] = {0};
+  std::vector<std::string> paths;
+  std::string path;
+  size_t i;
+  FILE *file;
+
+  // Every file gets a different size, so we can tell them apart.
+  for (i = 0; i < count; ++i) {
+    path = root + "/file_" + std::to_string(i);
+    file = fopen(path.c_str(), "w");
+    if (file) {
+      fwrite(contents, 1, i % sizeof(contents), file);
+      fclose(file);
+    }
+
+    paths.push_back(path);
+  }
+
+  return paths;
+}
+
+static bool check_table(const std::vector<const char *> &paths,
+  const cwk_stat_table &table)
+{
+  struct stat st;
+  size_t i;
+
+  if (table.count() != paths.size()) {
+    return false;
+  }
+
+  for (i = 0; i < paths.size(); ++i) {
+    if (lstat(paths[i], &st) != 0) {
+      if (table.error[i] != errno) {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (table.error[i] != 0 || table.size[i] != (uint64_t)st.st_size ||
+        table.inode[i] != st.st_ino || table.mode[i] != st.st_mode ||
+        table.mtime[i] != (int64_t)st.st_mtim.tv_sec * 1000000000 +
+                            st.st_mtim.tv_nsec) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int stat_batch()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::vector<const char *> paths;
+  std::vector<std::string> files;
+  cwk_stat_table table;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  // More paths than fit into the ring at once, and a missing one in between.
+  files = create_files(root, 1000);
+  files.insert(files.begin() + 500, std::string(root) + "/missing");
+  for (const std::string &file : files) {
+    paths.push_back(file.c_str());
+  }
+
+  cwk_stat_batch batch(64);
+  batch.fetch(paths.data(), paths.size(), &table);
+  success = check_table(paths, table) && table.error[500] == ENOENT;
+
+  for (const std::string &file : files) {
+    unlink(file.c_str());
+  }
+
+  rmdir(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int stat_fallback()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::vector<const char *> paths;
+  std::vector<std::string> files;
+  cwk_stat_table table;
+  bool success;
+  int dirfd;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  files = create_files(root, 10);
+  for (const std::string &file : files) {
+    paths.push_back(file.c_str() + strlen(root) + 1);
+  }
+
+  // Relative paths are resolved relative to the directory descriptor.
+  cwk_stat_batch batch(0);
+  dirfd = open(root, O_RDONLY | O_DIRECTORY);
+  batch.fetch(paths.data(), paths.size(), &table, dirfd);
+  close(dirfd);
+
+  success = !batch.uses_io_uring();
+  for (size_t i = 0; i < files.size(); ++i) {
+    paths[i] = files[i].c_str();
+  }
+
+  success = success && check_table(paths, table);
+  for (const std::string &file : files) {
+    unlink(file.c_str());
+  }
+
+  rmdir(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
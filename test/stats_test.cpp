@@ -0,0 +1,122 @@
+#include <cwalk.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#ifdef CWK_STATS
+
+int stats_threads()
+{
+  const cwk cwk_path(CWK_STYLE_UNIX);
+  cwk_stats other, stats;
+  char buffer[FILENAME_MAX];
+
+  // The counters of another thread must not show up in the ones of this
+  // thread, and the other way around.
+  cwk_stats_reset();
+  cwk_path.normalize("/a/b", buffer, sizeof(buffer));
+  std::thread thread([&]() {
+    cwk_path.normalize("/a/b/c/d", buffer, sizeof(buffer));
+    other = cwk_stats_snapshot();
+  });
+  thread.join();
+
+  stats = cwk_stats_snapshot();
+  if (stats.segments == 0 || other.segments <= stats.segments) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_stats_reset();
+  stats = cwk_stats_snapshot();
+  if (stats.segments != 0 || stats.bytes_scanned != 0 ||
+      stats.bytes_written != 0 || stats.root_parses != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int stats_removal()
+{
+  const cwk cwk_path(CWK_STYLE_UNIX);
+  char buffer[FILENAME_MAX];
+  cwk_stats stats;
+
+  // The removed segments of each path are determined in a single pass, no
+  // matter how many back segments there are.
+  cwk_stats_reset();
+  cwk_path.get_relative("/a/b/c/d/e/f", "/a/b/c/d/e/g", buffer,
+    sizeof(buffer));
+  stats = cwk_stats_snapshot();
+  if (stats.removal_scans != 2 || strcmp(buffer, "../g") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  cwk_stats_reset();
+  cwk_path.get_relative("/a/b/../c/d/../e", "/a/c/x", buffer, sizeof(buffer));
+  stats = cwk_stats_snapshot();
+  if (stats.removal_scans != 2 || strcmp(buffer, "../x") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int stats_output()
+{
+  const cwk cwk_path(CWK_STYLE_UNIX);
+  char buffer[FILENAME_MAX];
+  cwk_stats stats;
+
+  cwk_stats_reset();
+  cwk_path.join("/a", "bc", buffer, sizeof(buffer));
+  stats = cwk_stats_snapshot();
+  if (stats.bytes_written != 5 || stats.truncations != 0) {
+    return EXIT_FAILURE;
+  }
+
+  // The last segment does not fit at all anymore.
+  cwk_stats_reset();
+  cwk_path.join("/a", "bc", buffer, 3);
+  stats = cwk_stats_snapshot();
+  if (stats.bytes_written != 3 || stats.truncations != 1) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int stats_segments()
+{
+  const cwk cwk_path(CWK_STYLE_UNIX);
+  struct cwk_segment segment;
+  cwk_stats stats;
+
+  cwk_stats_reset();
+  if (!cwk_path.get_first_segment("/a/bb/ccc", &segment)) {
+    return EXIT_FAILURE;
+  }
+
+  while (cwk_path.get_next_segment(&segment)) {
+  }
+
+  stats = cwk_stats_snapshot();
+  if (stats.segments != 3 || stats.bytes_scanned != 8 ||
+      stats.root_parses != 1 || stats.bytes_written != 0) {
+    return EXIT_FAILURE;
+  }
+
+  // Moving back looks at the same characters again.
+  cwk_stats_reset();
+  while (cwk_path.get_previous_segment(&segment)) {
+  }
+
+  stats = cwk_stats_snapshot();
+  if (stats.segments != 2 || stats.bytes_scanned != 5) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+#endif
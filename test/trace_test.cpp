@@ -0,0 +1,206 @@
+#include <cwalk.h>
+#include <cwalk_trace.h>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static std::string get_trace_file()
+{
+  return (std::filesystem::temp_directory_path() / "cwalktest_trace").string();
+}
+
+static bool write_trace_file(const std::string &file, const std::string &data)
+{
+  FILE *f;
+  bool result;
+
+  f = fopen(file.c_str(), "wb");
+  if (f == NULL) {
+    return false;
+  }
+
+  result = fwrite(data.data(), 1, data.size(), f) == data.size();
+  return fclose(f) == 0 && result;
+}
+
+static bool load_fails(const std::string &data)
+{
+  std::string file;
+  cwk_trace trace;
+  bool result;
+
+  file = get_trace_file();
+  if (!write_trace_file(file, data)) {
+    return false;
+  }
+
+  result = !trace.load(file.c_str()) && trace.get_records().empty();
+  remove(file.c_str());
+  return result;
+}
+
+#ifdef CWK_TRACE
+
+int trace_capture()
+{
+  const char *paths[] = {"/a", "b/../c", "d", NULL};
+  std::string file;
+  cwk_trace trace;
+  const cwk cwk_path(CWK_STYLE_UNIX);
+  char buffer[FILENAME_MAX], result[FILENAME_MAX];
+  size_t absolute, joined;
+  const char *basename;
+  size_t length;
+  bool valid;
+
+  // The calls which get_absolute and join_multiple make internally must not
+  // show up in the trace, only the three calls of the test.
+  file = get_trace_file();
+  if (!cwk_trace_open(file.c_str())) {
+    return EXIT_FAILURE;
+  }
+
+  absolute = cwk_path.get_absolute("/base", "x/./y", result, sizeof(result));
+  joined = cwk_path.join_multiple(paths, buffer, 4);
+  cwk_path.get_basename("/var/log.txt", &basename, &length);
+  if (!cwk_trace_close()) {
+    return EXIT_FAILURE;
+  }
+
+  valid = trace.load(file.c_str());
+  remove(file.c_str());
+  if (!valid || trace.get_records().size() != 3) {
+    return EXIT_FAILURE;
+  }
+
+  const cwk_trace_record &first = trace.get_records()[0];
+  const cwk_trace_record &second = trace.get_records()[1];
+  const cwk_trace_record &third = trace.get_records()[2];
+  if (first.operation != CWK_TRACE_GET_ABSOLUTE ||
+      first.style != CWK_STYLE_UNIX || first.buffer_size != sizeof(result) ||
+      first.paths.size() != 2 || first.paths[0] != "/base" ||
+      first.paths[1] != "x/./y") {
+    return EXIT_FAILURE;
+  }
+
+  if (second.operation != CWK_TRACE_JOIN_MULTIPLE ||
+      second.buffer_size != 4 || second.paths.size() != 3 ||
+      second.paths[1] != "b/../c") {
+    return EXIT_FAILURE;
+  }
+
+  if (third.operation != CWK_TRACE_GET_BASENAME || third.buffer_size != 0 ||
+      third.paths.size() != 1 || third.paths[0] != "/var/log.txt") {
+    return EXIT_FAILURE;
+  }
+
+  // The replay gives the same results, including the truncation of the join.
+  if (cwk_trace::replay(first, buffer, sizeof(buffer)) != absolute ||
+      strcmp(buffer, result) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (cwk_trace::replay(second, buffer, sizeof(buffer)) != joined ||
+      strcmp(buffer, "/a/") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  if (cwk_trace::replay(third, buffer, sizeof(buffer)) != length) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+#endif
+
+int trace_replay()
+{
+  cwk_trace_record record;
+  char buffer[FILENAME_MAX];
+
+  record = {CWK_TRACE_NORMALIZE, CWK_STYLE_UNIX, 5, {"/var/./log/../tmp"}};
+  if (cwk_trace::replay(record, buffer, sizeof(buffer)) != 8 ||
+      strcmp(buffer, "/var") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  record = {CWK_TRACE_JOIN_MULTIPLE, CWK_STYLE_WINDOWS, sizeof(buffer),
+    {"C:\\a", "b", "c", "d", "e", "f", "g", "h", "i", "..", "j"}};
+  if (cwk_trace::replay(record, buffer, sizeof(buffer)) != 20 ||
+      strcmp(buffer, "C:\\a\\b\\c\\d\\e\\f\\g\\h\\j") != 0) {
+    return EXIT_FAILURE;
+  }
+
+  record = {CWK_TRACE_IS_ABSOLUTE, CWK_STYLE_WINDOWS, 0, {"C:\\a"}};
+  if (cwk_trace::replay(record, buffer, sizeof(buffer)) != 1) {
+    return EXIT_FAILURE;
+  }
+
+  record = {CWK_TRACE_GET_EXTENSION, CWK_STYLE_UNIX, 0, {"/a/b.txt"}};
+  if (cwk_trace::replay(record, buffer, sizeof(buffer)) != 4) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int trace_invalid()
+{
+  cwk_trace trace;
+  std::string header;
+
+  header = "CWKTRAC1";
+  if (trace.load("/this/file/does/not/exist") || !load_fails("CWKTRAC2") ||
+      !load_fails(header + std::string("\x0e\x01\x00\x01\x05/a/b", 9)) ||
+      !load_fails(header + std::string("\x0e\x01\x00\x02\x01/\x01/", 8)) ||
+      !load_fails(header + std::string("\x7f\x01\x00\x01\x01/", 6)) ||
+      !load_fails(header + std::string("\x0e\x05\x00\x01\x01/", 6)) ||
+      !load_fails(header + std::string("\x0e\x01\x80", 3))) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int trace_load()
+{
+  std::string file, data;
+  cwk_trace trace;
+  bool valid;
+
+  // A normalize with a buffer of 200 bytes, followed by a join of three paths
+  // in the windows style.
+  file = get_trace_file();
+  data = "CWKTRAC1";
+  data += std::string("\x0e\x01\xc8\x01\x01\x07/a/../b", 13);
+  data += std::string("\x03\x00\x10\x03\x02\x43:\x01\x61\x00", 10);
+  if (!write_trace_file(file, data)) {
+    return EXIT_FAILURE;
+  }
+
+  valid = trace.load(file.c_str());
+  remove(file.c_str());
+  if (!valid || trace.get_records().size() != 2) {
+    return EXIT_FAILURE;
+  }
+
+  const cwk_trace_record &first = trace.get_records()[0];
+  const cwk_trace_record &second = trace.get_records()[1];
+  if (first.operation != CWK_TRACE_NORMALIZE ||
+      first.style != CWK_STYLE_UNIX || first.buffer_size != 200 ||
+      first.paths.size() != 1 || first.paths[0] != "/a/../b") {
+    return EXIT_FAILURE;
+  }
+
+  if (second.operation != CWK_TRACE_JOIN_MULTIPLE ||
+      second.style != CWK_STYLE_WINDOWS || second.buffer_size != 16 ||
+      second.paths.size() != 3 || second.paths[0] != "C:" ||
+      second.paths[1] != "a" || !second.paths[2].empty()) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
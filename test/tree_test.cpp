@@ -0,0 +1,177 @@
+#include "files.h"
+#include <cwalk_tree.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static void write_file(const std::string &path)
+{
+  FILE *file;
+
+  file = fopen(path.c_str(), "w");
+  if (file) {
+    fclose(file);
+  }
+}
+
+static std::vector<std::string> list(cwk_tree_index<cwk_unix> *index,
+  const std::string &prefix, size_t skip)
+{
+  std::vector<std::string> paths;
+
+  // The paths are compared without the root, which is different every time.
+  index->list(prefix.c_str(), [&](std::string_view path, unsigned char) {
+    paths.emplace_back(path.substr(skip));
+  });
+
+  return paths;
+}
+
+int tree_initial()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::vector<std::string> expected;
+  cwk_tree_index<cwk_unix> index(cwk_unix{});
+  std::string r;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  r = root;
+  mkdir((r + "/a").c_str(), 0755);
+  mkdir((r + "/a/b").c_str(), 0755);
+  mkdir((r + "/ab").c_str(), 0755);
+  write_file(r + "/a/f1");
+  write_file(r + "/a/b/f2");
+  write_file(r + "/ab/f3");
+  write_file(r + "/a-f4");
+  symlink("a", (r + "/link").c_str());
+
+  success = index.open((r + "/").c_str()) && index.size() == 9;
+  success = success && index.exists(root) &&
+            index.exists((r + "/a/f1").c_str());
+  success = success && index.exists((r + "//a/./b/../b/f2").c_str());
+  success = success && !index.exists((r + "/a/f3").c_str()) &&
+            !index.exists((r + "/link/f1").c_str());
+  success = success && index.get_type((r + "/link").c_str()) == DT_LNK &&
+            index.get_type((r + "/a/b").c_str()) == DT_DIR &&
+            index.get_type((r + "/a-f4").c_str()) == DT_REG;
+
+  // Neither ab nor a-f4 belong to a, even though they share the prefix.
+  expected = {"/a/b", "/a/b/f2", "/a/f1"};
+  success = success && list(&index, r + "/a/", r.size()) == expected;
+  expected = {"/a", "/a-f4", "/a/b", "/a/b/f2", "/a/f1", "/ab", "/ab/f3",
+    "/link"};
+  success = success && list(&index, root, r.size()) == expected;
+  success = success && list(&index, r + "/a/f1", r.size()).empty();
+  success = success && !index.open((r + "/a/f1").c_str());
+
+  remove_tree(root);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int tree_current()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::vector<std::string> expected;
+  cwk_tree_index<cwk_unix> index(cwk_unix{});
+  std::string r;
+  bool success;
+
+  if (!mkdtemp(root) || chdir(root) != 0) {
+    return EXIT_FAILURE;
+  }
+
+  // The root normalizes to the current directory, so the paths of its
+  // entries have no prefix at all.
+  r = root;
+  mkdir("a", 0755);
+  write_file("a/f1");
+  write_file("-f2");
+
+  success = index.open("a/..") && index.size() == 4;
+  success = success && index.get_type(".") == DT_DIR &&
+            index.get_type("./a/f1") == DT_REG;
+  expected = {"-f2", "a", "a/f1"};
+  success = success && list(&index, ".", 0) == expected;
+  expected = {"a/f1"};
+  success = success && list(&index, "a", 0) == expected;
+
+  success = chdir("/") == 0 && success;
+  remove_tree(r);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int tree_events()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  std::vector<std::string> expected;
+  cwk_tree_index<cwk_unix> index(cwk_unix{});
+  std::string r;
+  bool success;
+
+  if (!mkdtemp(root)) {
+    return EXIT_FAILURE;
+  }
+
+  r = root;
+  mkdir((r + "/a").c_str(), 0755);
+  write_file(r + "/a/f1");
+  write_file(r + "/f2");
+  success = index.open(root) && index.update(0) == 0;
+
+  // A whole new tree appears at once, which is read when its top directory
+  // is checked. Its entries are reported as well, but they are skipped.
+  mkdir((r + "/x").c_str(), 0755);
+  mkdir((r + "/x/y").c_str(), 0755);
+  write_file(r + "/x/y/f3");
+  write_file(r + "/a/f4");
+  unlink((r + "/f2").c_str());
+  success = success && index.update(1000) == 3;
+  expected = {"/a", "/a/f1", "/a/f4", "/x", "/x/y", "/x/y/f3"};
+  success = success && list(&index, root, r.size()) == expected;
+
+  // The new directories are watched as well.
+  write_file(r + "/x/y/f5");
+  success = success && index.update(1000) == 1 &&
+            index.exists((r + "/x/y/f5").c_str());
+
+  // A moved directory takes its entries with it, and its watches follow the
+  // new path.
+  rename((r + "/x").c_str(), (r + "/z").c_str());
+  success = success && index.update(1000) == 2;
+  expected = {"/a", "/a/f1", "/a/f4", "/z", "/z/y", "/z/y/f3", "/z/y/f5"};
+  success = success && list(&index, root, r.size()) == expected;
+  write_file(r + "/z/y/f6");
+  success = success && index.update(1000) == 1 &&
+            index.exists((r + "/z/y/f6").c_str());
+
+  // The old path sorts after the new one here, so it is handled last and
+  // must not take the watches of the new path away.
+  rename((r + "/z").c_str(), (r + "/b").c_str());
+  success = success && index.update(1000) == 2;
+  expected = {"/a", "/a/f1", "/a/f4", "/b", "/b/y", "/b/y/f3", "/b/y/f5",
+    "/b/y/f6"};
+  success = success && list(&index, root, r.size()) == expected;
+  write_file(r + "/b/f7");
+  write_file(r + "/b/y/f8");
+  success = success && index.update(1000) == 2 &&
+            index.exists((r + "/b/f7").c_str()) &&
+            index.exists((r + "/b/y/f8").c_str());
+
+  // A directory which is replaced by a file loses all its entries.
+  remove_tree(r + "/a");
+  write_file(r + "/a");
+  success = success && index.update(1000) > 0 &&
+            index.get_type((r + "/a").c_str()) == DT_REG &&
+            !index.exists((r + "/a/f1").c_str());
+
+  remove_tree(root);
+  success = success && index.update(1000) > 0 && index.size() == 0;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
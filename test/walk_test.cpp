@@ -0,0 +1,485 @@
+#include "files.h"
+#include <algorithm>
+#include <cwalk_ignore.h>
+#include <cwalk_walk.h>
+#include <memory.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static cwk cwk_path;
+
+static std::string create_tree()
+{
+  char root[] = "/tmp/cwalktest_XXXXXX";
+  const char *directories[] = {"a", "a/b", "a/b/c", "d", "e"};
+  const char *files[] = {"f1", "a/f2", "a/b/f3", "a/b/c/f4", "d/f5", "d/f6"};
+  std::string path;
+  FILE *file;
+
+  if (!mkdtemp(root)) {
+    return "";
+  }
+
+  for (const char *directory : directories) {
+    path = std::string(root) + "/" + directory;
+    mkdir(path.c_str(), 0755);
+  }
+
+  for (const char *name : files) {
+    path = std::string(root) + "/" + name;
+    file = fopen(path.c_str(), "w");
+    if (file) {
+      fclose(file);
+    }
+  }
+
+  path = std::string(root) + "/link";
+  if (symlink("a", path.c_str()) != 0) {
+    return "";
+  }
+
+  return root;
+}
+
+static std::vector<std::string> walk_paths(const std::string &root,
+  const cwk_walk_options &options, cwk_walk_result *result)
+{
+  std::vector<std::string> paths;
+  std::mutex mutex;
+
+  *result = cwk_walker(cwk_path, options)
+              .walk(root.c_str(), [&](const cwk_walk_entry &entry) {
+                std::lock_guard<std::mutex> lock(mutex);
+                paths.push_back(std::string(entry.path + root.size() + 1) +
+                                ":" + std::to_string(entry.depth));
+                return true;
+              });
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+int walk_single_thread()
+{
+  cwk_walk_result result;
+  std::vector<std::string> expected = {"a/b/c/f4:4", "a/b/c:3", "a/b/f3:3",
+    "a/b:2", "a/f2:2", "a:1", "d/f5:2", "d/f6:2", "d:1", "e:1", "f1:1",
+    "link:1"};
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  std::sort(expected.begin(), expected.end());
+  if (walk_paths(root, {1}, &result) != expected || result.entries != 12 ||
+      result.directories != 6 || result.errors != 0) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_parallel()
+{
+  cwk_walk_result single, parallel;
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  if (walk_paths(root, {1}, &single) != walk_paths(root, {8}, &parallel) ||
+      single.entries != parallel.entries) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_normalized_root()
+{
+  cwk_walk_result result;
+  std::string root, path;
+  bool normalized;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // The root is not normalized, but the paths of the entries will be.
+  normalized = true;
+  path = root + "//a/./../d/";
+  result = cwk_walker(cwk_path, {2}).walk(
+    path.c_str(), [&](const cwk_walk_entry &entry) {
+      if (strncmp(entry.path, (root + "/d/").c_str(), root.size() + 3) != 0) {
+        normalized = false;
+      }
+      return true;
+    });
+
+  remove_tree(root);
+  if (!normalized || result.entries != 2) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int walk_prune()
+{
+  cwk_walk_result result;
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Skipping "a" must skip everything below it as well.
+  result = cwk_walker(cwk_path).walk(
+    root.c_str(), [](const cwk_walk_entry &entry) {
+      return strcmp(entry.name, "a") != 0;
+    });
+  if (result.entries != 7 || result.directories != 3) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  // The maximum depth prunes as well.
+  result = cwk_walker(cwk_path, {1, 2}).walk(
+    root.c_str(), [](const cwk_walk_entry &) { return true; });
+  if (result.entries != 9) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_missing()
+{
+  cwk_walk_result result;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  result = cwk_walker(cwk_path).walk("/this/does/not/exist",
+    [](const cwk_walk_entry &) { return true; });
+  if (result.entries != 0 || result.errors != 1) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+int walk_lazy()
+{
+  cwk_walk_result result;
+  std::vector<std::string> paths;
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  auto walk = cwk_walker(cwk_path).lazy_walk(root.c_str());
+  for (const cwk_walk_entry &entry : walk) {
+    paths.push_back(std::string(entry.path + root.size() + 1) + ":" +
+                    std::to_string(entry.depth));
+  }
+
+  std::sort(paths.begin(), paths.end());
+  if (paths != walk_paths(root, {1}, &result) ||
+      walk.get_result().entries != result.entries ||
+      walk.get_result().directories != result.directories) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_lazy_skip()
+{
+  std::string root;
+  size_t count;
+  bool found;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Skipping "a" means it is never opened, so it doesn't count as directory.
+  count = 0;
+  auto walk = cwk_walker(cwk_path).lazy_walk(root.c_str());
+  for (const cwk_walk_entry &entry : walk) {
+    if (strcmp(entry.name, "a") == 0) {
+      walk.skip();
+    }
+    ++count;
+  }
+
+  if (count != 7 || walk.get_result().directories != 3) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  // Stopping early leaves everything else unread.
+  found = false;
+  auto early = cwk_walker(cwk_path).lazy_walk(root.c_str());
+  for (const cwk_walk_entry &entry : early) {
+    if (entry.type == DT_REG) {
+      found = true;
+      break;
+    }
+  }
+
+  if (!found || early.get_result().entries > 7) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_filter_exclude()
+{
+  cwk_walk_result result;
+  cwk_walk_filter filter(cwk_path);
+  cwk_walk_options options;
+  std::vector<std::string> expected = {"d/f6:2", "d:1", "e:1", "f1:1",
+    "link:1"};
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Excluding "a" by name means it is never opened, and anchored patterns
+  // only match relative to the root.
+  filter.exclude("a");
+  filter.exclude("/d/f5");
+  filter.exclude("f5/f6");
+  options.threads = 2;
+  options.filter = &filter;
+  if (walk_paths(root, options, &result) != expected ||
+      result.entries != 5 || result.directories != 3) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_filter_include()
+{
+  cwk_walk_result result;
+  cwk_walk_filter filter(cwk_path);
+  cwk_walk_options options;
+  std::vector<std::string> expected = {"a/b/c/f4:4", "a/b/f3:3"};
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Only "a" can contain a match, so "d" and "e" are never opened.
+  filter.include("a/b/**/f?");
+  options.threads = 1;
+  options.filter = &filter;
+  if (walk_paths(root, options, &result) != expected ||
+      result.entries != 2 || result.directories != 4) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_filter_braces()
+{
+  cwk_walk_result result;
+  cwk_walk_filter filter(cwk_path), literal(cwk_path);
+  cwk_walk_options options;
+  std::vector<std::string> expected = {"a/b/f3:3", "d/f5:2"};
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // Braces are expanded unless they are turned off, in which case they only
+  // match entries with braces in their names.
+  filter.include("{a/b,d}/f{3,5}");
+  filter.exclude("{c,e}");
+  options.filter = &filter;
+  if (walk_paths(root, options, &result) != expected ||
+      result.entries != 2 || result.directories != 4) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  literal.include("{a/b,d}/f{3,5}", false);
+  options.filter = &literal;
+  if (!walk_paths(root, options, &result).empty() || result.entries != 0) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+int walk_filter_lazy()
+{
+  cwk_walk_result result;
+  cwk_walk_filter filter(cwk_path);
+  cwk_walk_options options;
+  std::vector<std::string> paths;
+  std::string root;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  filter.include("f*");
+  filter.exclude("c");
+  options.filter = &filter;
+  auto walk = cwk_walker(cwk_path, options).lazy_walk(root.c_str());
+  for (const cwk_walk_entry &entry : walk) {
+    paths.push_back(std::string(entry.path + root.size() + 1) + ":" +
+                    std::to_string(entry.depth));
+  }
+
+  std::sort(paths.begin(), paths.end());
+  if (paths != walk_paths(root, options, &result) ||
+      walk.get_result().entries != 5 ||
+      walk.get_result().directories != result.directories) {
+    remove_tree(root);
+    return EXIT_FAILURE;
+  }
+
+  remove_tree(root);
+  return EXIT_SUCCESS;
+}
+
+static void load_ignore_file(cwk_ignore &ignore, const std::string &directory)
+{
+  std::string path, content;
+  char buffer[256];
+  size_t size;
+  FILE *file;
+
+  path = directory + "/.gitignore";
+  file = fopen(path.c_str(), "r");
+  if (!file) {
+    return;
+  }
+
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    content.append(buffer, size);
+  }
+
+  fclose(file);
+  ignore.add_rules(content);
+}
+
+int walk_ignore()
+{
+  std::vector<std::string> paths, expected = {"a/b/f3", "a/b", "a/f2", "a",
+    "d/f6", "d", "e", "link"};
+  cwk_ignore ignore(cwk_path);
+  std::string root, path;
+  FILE *file;
+
+  cwk_path.set_style(CWK_STYLE_UNIX);
+
+  root = create_tree();
+  if (root.empty()) {
+    return EXIT_FAILURE;
+  }
+
+  // The root ignores "c" and everything ending with a "5", while "a" ignores
+  // its own "f*" files except for "f2".
+  path = root + "/.gitignore";
+  file = fopen(path.c_str(), "w");
+  fputs("c/\n*5\n.gitignore\n/f1\n", file);
+  fclose(file);
+  path = root + "/a/.gitignore";
+  file = fopen(path.c_str(), "w");
+  fputs("/f*\n!f2\n.gitignore\n", file);
+  fclose(file);
+
+  // The ignore stack follows the lazy walk. Ignored directories are skipped,
+  // and the rules of a directory are loaded when it is entered.
+  load_ignore_file(ignore, root);
+  auto walk = cwk_walker(cwk_path).lazy_walk(root.c_str());
+  for (const cwk_walk_entry &entry : walk) {
+    while (ignore.depth() >= entry.depth) {
+      ignore.pop();
+    }
+
+    if (ignore.is_ignored(std::string_view(entry.name, entry.name_length),
+          entry.type == DT_DIR)) {
+      walk.skip();
+      continue;
+    }
+
+    paths.push_back(entry.path + root.size() + 1);
+    if (entry.type == DT_DIR) {
+      ignore.push(std::string_view(entry.name, entry.name_length));
+      load_ignore_file(ignore, entry.path);
+    }
+  }
+
+  std::sort(paths.begin(), paths.end());
+  std::sort(expected.begin(), expected.end());
+  remove_tree(root);
+  if (paths != expected) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}